@@ -0,0 +1,248 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_ASYNC_KINETIC_CONNECTION_H_
+#define KINETIC_CPP_CLIENT_ASYNC_KINETIC_CONNECTION_H_
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kinetic/common.h"
+#include "kinetic/nonblocking_kinetic_connection_interface.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::string;
+using std::vector;
+
+/// The outcome of a Get, GetNext or GetPrevious: the status and, if it's ok,
+/// the key found and its record
+struct GetResult {
+    explicit GetResult(const KineticStatus &status) : status(status), key(), record() {}
+    KineticStatus status;
+    string key;
+    unique_ptr<KineticRecord> record;
+};
+
+/// The outcome of a GetKeyRange: the status and, if it's ok, the keys
+struct KeyRangeResult {
+    explicit KeyRangeResult(const KineticStatus &status) : status(status), keys() {}
+    KineticStatus status;
+    unique_ptr<vector<string>> keys;
+};
+
+/// The outcome of a GetLog: the status and, if it's ok, the log
+struct GetLogResult {
+    explicit GetLogResult(const KineticStatus &status) : status(status), drive_log() {}
+    KineticStatus status;
+    unique_ptr<DriveLog> drive_log;
+};
+
+/// The outcome of a P2PPush: the status of the push as a whole and, if that's
+/// ok, the status of each of its operations
+struct P2PPushResult {
+    explicit P2PPushResult(const KineticStatus &status) : status(status), operation_statuses() {}
+    KineticStatus status;
+    unique_ptr<vector<KineticStatus>> operation_statuses;
+};
+
+/// Waits for each of futures in turn and returns their results in order
+template <typename T>
+vector<T> GetAll(vector<std::future<T>> futures) {
+    vector<T> results;
+    results.reserve(futures.size());
+    for (auto it = futures.begin(); it != futures.end(); ++it) {
+        results.push_back(it->get());
+    }
+    return results;
+}
+
+/// What AsyncKineticConnection::WhenAll leaves waiting on the connection's
+/// completions
+class AsyncJoinInterface {
+    public:
+    virtual ~AsyncJoinInterface() {}
+    /// Called whenever one of the connection's requests completes. Returns
+    /// true once the join is done with.
+    virtual bool Advance() = 0;
+};
+
+/// Joins futures into one promise, fulfilled by whichever completion finds
+/// the last of them ready
+template <typename T>
+class AsyncJoin : public AsyncJoinInterface {
+    public:
+    explicit AsyncJoin(vector<std::future<T>> futures) : futures_(std::move(futures)), next_(0), promise_() {}
+
+    std::future<vector<T>> get_future() { return promise_.get_future(); }
+
+    bool Advance() {
+        // Futures before next_ are known to be ready and stay that way, so
+        // each completion only looks at the first one that wasn't
+        while (next_ < futures_.size() &&
+                futures_[next_].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            next_++;
+        }
+        if (next_ < futures_.size()) {
+            return false;
+        }
+        try {
+            promise_.set_value(GetAll(std::move(futures_)));
+        } catch (...) {
+            promise_.set_exception(std::current_exception());
+        }
+        return true;
+    }
+
+    private:
+    vector<std::future<T>> futures_;
+    size_t next_;
+    std::promise<vector<T>> promise_;
+    DISALLOW_COPY_AND_ASSIGN(AsyncJoin);
+};
+
+/// Shared by an AsyncKineticConnection and the callbacks behind its futures,
+/// which report each completion so that pending joins can advance. Requests
+/// can complete on whichever thread runs the connection, so this is
+/// threadsafe.
+class AsyncCompletions {
+    public:
+    AsyncCompletions() : mutex_(), joins_() {}
+
+    void Add(shared_ptr<AsyncJoinInterface> join) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!join->Advance()) {
+            joins_.push_back(join);
+        }
+    }
+
+    void Completed() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto it = joins_.begin(); it != joins_.end();) {
+            if ((*it)->Advance()) {
+                it = joins_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    private:
+    std::mutex mutex_;
+    std::list<shared_ptr<AsyncJoinInterface>> joins_;
+    DISALLOW_COPY_AND_ASSIGN(AsyncCompletions);
+};
+
+/// Submits requests on a nonblocking connection and hands back a future for
+/// each one's result, instead of calling back a callback object. Nothing
+/// waits for a request to finish before the next can be submitted, so
+/// submitting several and then waiting on all of them keeps them all in
+/// flight together.
+///
+/// Futures only become ready as the connection is run. Either call Wait or
+/// WaitAll, which run it until the futures are ready, or have the connection
+/// run elsewhere, for example by a KineticReactor, in which case the futures
+/// can be waited on directly. A future whose request is removed from the
+/// connection without completing throws std::future_error from get().
+class AsyncKineticConnection {
+    public:
+    explicit AsyncKineticConnection(shared_ptr<NonblockingKineticConnectionInterface> connection);
+
+    std::future<KineticStatus> NoOp();
+    std::future<GetResult> Get(const string &key);
+    std::future<GetResult> Get(const shared_ptr<const string> key);
+    std::future<GetResult> GetNext(const string &key);
+    std::future<GetResult> GetPrevious(const string &key);
+    std::future<KineticStatus> Put(const string &key, const string &current_version, WriteMode mode,
+        const shared_ptr<const KineticRecord> record, PersistMode persist_mode = PersistMode::WRITE_BACK);
+    std::future<KineticStatus> Put(const shared_ptr<const string> key,
+        const shared_ptr<const string> current_version, WriteMode mode,
+        const shared_ptr<const KineticRecord> record, PersistMode persist_mode = PersistMode::WRITE_BACK);
+    std::future<KineticStatus> Delete(const string &key, const string &version, WriteMode mode,
+        PersistMode persist_mode = PersistMode::WRITE_BACK);
+    std::future<KineticStatus> Delete(const shared_ptr<const string> key,
+        const shared_ptr<const string> version, WriteMode mode,
+        PersistMode persist_mode = PersistMode::WRITE_BACK);
+    std::future<KeyRangeResult> GetKeyRange(const string &start_key, bool start_key_inclusive,
+        const string &end_key, bool end_key_inclusive, bool reverse_results, int32_t max_results);
+    std::future<GetLogResult> GetLog();
+    std::future<GetLogResult> GetLog(const vector<Command_GetLog_Type> &types);
+    std::future<P2PPushResult> P2PPush(const P2PPushRequest &push_request);
+
+    /// Runs the connection until future is ready, waiting up to timeout_ms
+    /// milliseconds (-1 waits indefinitely). Returns false if it isn't ready
+    /// by then. Requests fail if the connection does, so their futures become
+    /// ready then too.
+    template <typename T>
+    bool Wait(const std::future<T> &future, int timeout_ms = -1) {
+        return RunUntil([&future]() { return IsReady(future); }, timeout_ms);
+    }
+
+    /// Like Wait, for every future in futures
+    template <typename T>
+    bool WaitAll(const vector<std::future<T>> &futures, int timeout_ms = -1) {
+        return RunUntil([&futures]() {
+            for (auto it = futures.begin(); it != futures.end(); ++it) {
+                if (!IsReady(*it)) {
+                    return false;
+                }
+            }
+            return true;
+        }, timeout_ms);
+    }
+
+    /// Combines futures returned by this connection into one for all of their
+    /// results, in the same order. The combined future becomes ready as soon
+    /// as the last of them does, however the connection is being run, so it
+    /// can be passed to Wait as well as waited on directly. If any of them
+    /// holds an exception, getting the combined result throws the first.
+    template <typename T>
+    std::future<vector<T>> WhenAll(vector<std::future<T>> futures) {
+        auto join = std::make_shared<AsyncJoin<T>>(std::move(futures));
+        std::future<vector<T>> combined = join->get_future();
+        completions_->Add(join);
+        return combined;
+    }
+
+    shared_ptr<NonblockingKineticConnectionInterface> connection() const { return connection_; }
+
+    private:
+    template <typename T>
+    static bool IsReady(const std::future<T> &future) {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    bool RunUntil(const std::function<bool()> &done, int timeout_ms);
+
+    shared_ptr<NonblockingKineticConnectionInterface> connection_;
+    shared_ptr<AsyncCompletions> completions_;
+    DISALLOW_COPY_AND_ASSIGN(AsyncKineticConnection);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_ASYNC_KINETIC_CONNECTION_H_
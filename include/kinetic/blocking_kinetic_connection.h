@@ -18,11 +18,20 @@
 #ifndef KINETIC_CPP_CLIENT_BLOCKING_KINETIC_CONNECTION_H_
 #define KINETIC_CPP_CLIENT_BLOCKING_KINETIC_CONNECTION_H_
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #include "kinetic/blocking_kinetic_connection_interface.h"
 #include "kinetic/nonblocking_kinetic_connection.h"
 
 namespace kinetic {
 
+/// Calls on a BlockingKineticConnection may be made from several threads at
+/// once, and are pipelined on the one connection rather than taking turns.
+/// Each call submits its request and waits for its own response. Whichever
+/// waiting thread gets there first drives the connection's I/O for everyone
+/// until its own call is done, then hands that job to another waiter.
 class BlockingKineticConnection : public BlockingKineticConnectionInterface {
 
     public:
@@ -44,6 +53,19 @@ class BlockingKineticConnection : public BlockingKineticConnectionInterface {
 
     KineticStatus Get(const string& key, unique_ptr<KineticRecord>& record);
 
+    KineticStatus GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+            size_t *value_size);
+
+    KineticStatus GetInto(const string& key, char *buffer, size_t capacity, size_t *value_size);
+
+    KineticStatus GetInto(const shared_ptr<const string> key, string *value);
+
+    KineticStatus GetInto(const string& key, string *value);
+
+    KineticStatus GetToFile(const shared_ptr<const string> key, int fd, off_t offset, size_t *value_size);
+
+    KineticStatus GetToFile(const string& key, int fd, off_t offset, size_t *value_size);
+
     KineticStatus GetNext(
             const shared_ptr<const string> key,
             unique_ptr<string>& actual_key,
@@ -156,12 +178,25 @@ class BlockingKineticConnection : public BlockingKineticConnectionInterface {
 
     private:
     KineticStatus RunOperation(shared_ptr<BlockingCallbackState> callback, HandlerKey handler_key);
+    void Wake();
 
     /// Helper method for translating a StatusCode from the drive into an API client KineticStatus
     /// object
     KineticStatus GetKineticStatus(StatusCode code);
     unique_ptr<NonblockingKineticConnection> nonblocking_connection_;
     const unsigned int network_timeout_seconds_;
+    // Held while running the nonblocking connection or removing handlers
+    // from it, and guards the callbacks' completion state along with driving_
+    std::mutex mutex_;
+    // Signalled each time the thread driving I/O has run the connection
+    std::condition_variable progress_;
+    // Set while some thread is driving I/O
+    bool driving_;
+    // When the driving thread last found the socket ready
+    std::chrono::steady_clock::time_point last_io_;
+    // A pipe the driving thread polls along with the socket, so that a
+    // request submitted meanwhile by another thread gets sent right away
+    int wake_fds_[2];
     DISALLOW_COPY_AND_ASSIGN(BlockingKineticConnection);
     };
 
@@ -49,6 +49,27 @@ class BlockingKineticConnectionInterface {
             const shared_ptr<const string> key,
             unique_ptr<KineticRecord>& record) = 0;
     virtual KineticStatus Get(const string& key, unique_ptr<KineticRecord>& record) = 0;
+    /// Receives the value straight into buffer, which must be able to hold it. The
+    /// number of bytes written is stored in value_size. The value arrives before the
+    /// response's HMAC can be checked, so if the call fails the buffer may hold
+    /// unverified bytes.
+    virtual KineticStatus GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+            size_t *value_size) = 0;
+    virtual KineticStatus GetInto(const string& key, char *buffer, size_t capacity,
+            size_t *value_size) = 0;
+    /// Receives the value straight into value, which is resized to fit. Reusing the
+    /// same string across calls avoids allocating for each value. As above, its
+    /// contents are unverified if the call fails.
+    virtual KineticStatus GetInto(const shared_ptr<const string> key, string *value) = 0;
+    virtual KineticStatus GetInto(const string& key, string *value) = 0;
+    /// Writes the value to the file open on fd starting at offset. The number of
+    /// bytes written is stored in value_size. The file is written before the
+    /// response's HMAC can be checked, so if the call fails it may hold unverified
+    /// bytes; write to a scratch file and rename it into place after success where
+    /// that matters.
+    virtual KineticStatus GetToFile(const shared_ptr<const string> key, int fd, off_t offset,
+            size_t *value_size) = 0;
+    virtual KineticStatus GetToFile(const string& key, int fd, off_t offset, size_t *value_size) = 0;
     virtual KineticStatus GetNext(
             const shared_ptr<const string> key,
             unique_ptr<string>& actual_key,
@@ -18,27 +18,57 @@
 #ifndef KINETIC_CPP_CLIENT_CONNECTION_OPTIONS_H_
 #define KINETIC_CPP_CLIENT_CONNECTION_OPTIONS_H_
 
+#include <stddef.h>
+
 #include <string>
 
 namespace kinetic {
 
 /// Use this struct to pass all connection options to the KineticConnectionFactory.
 struct ConnectionOptions {
-  /// The host name or IP address of the kinetic server.
+  ConnectionOptions() : port(0), use_ssl(false), kernel_tls(false), user_id(0),
+      zerocopy_send(false), zerocopy_threshold(64 * 1024) {}
+
+  /// The host name or IP address of the kinetic server, or "unix:" followed
+  /// by the path of a Unix domain socket for a server on the same machine,
+  /// such as a simulator. Requests to such a server skip the TCP stack
+  /// altogether. MSG_ZEROCOPY is not available over Unix domain sockets.
   std::string host;
 
-  /// The port the kinetic server is running on.
+  /// The port the kinetic server is running on. Ignored for Unix domain
+  /// sockets.
   int port;
 
   /// If true secure all TCP traffic to the server using TLSv1. Otherwise
   /// all trafic will be plain-text TCP.
   bool use_ssl;
 
+  /// If true along with use_ssl, encryption of outgoing data is handed to the
+  /// kernel (kTLS) once the TLS handshake is done, and requests are written
+  /// to the socket as on a plain connection: whole packets with one vectored
+  /// write, and file values with sendfile. Incoming data is decrypted by the
+  /// kernel too where it supports that. The kernel only takes TLS 1.2 with
+  /// AES-GCM, so connections quietly stay with OpenSSL's own encryption if
+  /// the drive negotiates anything else or the kernel doesn't support kTLS.
+  bool kernel_tls;
+
   /// The ID of the user to connect as.
   int user_id;
 
   /// The HMAC key of the user specified in user_id.
   std::string hmac_key;
+
+  /// If true, values of at least zerocopy_threshold bytes are sent with
+  /// MSG_ZEROCOPY on plain TCP connections, so the kernel sends them straight
+  /// from their memory instead of copying them first. Such a value is kept
+  /// alive until the kernel reports it has been sent, which can be after the
+  /// request's callback has run. Ignored with use_ssl, and where the platform
+  /// doesn't support it.
+  bool zerocopy_send;
+
+  /// The smallest value sent with MSG_ZEROCOPY. Pinning pages has a fixed
+  /// cost that only pays off for large values.
+  size_t zerocopy_threshold;
 };
 
 
@@ -18,22 +18,70 @@
 #ifndef KINETIC_CPP_CLIENT_HMAC_PROVIDER_H_
 #define KINETIC_CPP_CLIENT_HMAC_PROVIDER_H_
 
+#include <openssl/hmac.h>
+
+#include <memory>
+#include <string>
+
+#include "kinetic/common.h"
 #include "kinetic_client.pb.h"
 
 namespace kinetic {
 
 using com::seagate::kinetic::client::proto::Message;
 
-/// Wrapper class that handles computing HMACs. The supplied implementation uses openssl,
-/// but users can supply an alternate implementation that uses a different library (e. g. one
-/// providing specialized HW accelaration)
-class HmacProvider {
+/// Computes and checks the HMACs that authenticate messages. HmacProvider
+/// is the supplied implementation, using openssl; users can supply an
+/// alternate implementation that uses a different library (e. g. one
+/// providing specialized HW accelaration) and pass it to
+/// NewKineticConnectionFactory. An implementation is shared by every
+/// connection the factory opens, so it must be safe to call from any number
+/// of threads at once.
+class HmacProviderInterface {
     public:
-    HmacProvider();
+    virtual ~HmacProviderInterface() {}
     virtual std::string ComputeHmac(const Message& message,
-        const std::string& key) const;
+        const std::string& key) const = 0;
+    /// Computes the HMAC of a message whose commandBytes are the length bytes
+    /// at command_bytes, without needing them in a Message
+    virtual std::string ComputeCommandHmac(const char *command_bytes, size_t length,
+        const std::string& key) const = 0;
     virtual bool ValidateHmac(const Message& message,
+        const std::string& key) const = 0;
+    /// Returns a provider for a single connection to keep, which is only ever
+    /// called with key, or NULL to have the connection use this provider.
+    /// Lets an implementation set up per-key state once per connection
+    /// instead of looking it up, under a lock shared with every other
+    /// connection, for each message.
+    virtual std::shared_ptr<HmacProviderInterface> ForKey(const std::string& key) const {
+        return std::shared_ptr<HmacProviderInterface>();
+    }
+};
+
+/// Computes HMAC-SHA1s with openssl. Hashing the key into its inner and outer
+/// pads is a good part of the work for a short message, so providers made by
+/// ForKey do that once and copy the resulting state for each message.
+class HmacProvider : public HmacProviderInterface {
+    public:
+    HmacProvider();
+    ~HmacProvider();
+    std::string ComputeHmac(const Message& message,
+        const std::string& key) const;
+    std::string ComputeCommandHmac(const char *command_bytes, size_t length,
         const std::string& key) const;
+    bool ValidateHmac(const Message& message,
+        const std::string& key) const;
+    std::shared_ptr<HmacProviderInterface> ForKey(const std::string& key) const;
+
+    private:
+    explicit HmacProvider(const std::string& key);
+    /// The key key_context_ was initialized with, if it's set
+    const std::string key_;
+    /// Initialized with key_ and nothing more, and never changed after, so
+    /// any number of threads can copy from it at once. NULL unless the
+    /// provider was made by ForKey.
+    HMAC_CTX *key_context_;
+    DISALLOW_COPY_AND_ASSIGN(HmacProvider);
 };
 
 } // namespace kinetic
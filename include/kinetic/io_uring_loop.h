@@ -0,0 +1,125 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_IO_URING_LOOP_H_
+#define KINETIC_CPP_CLIENT_IO_URING_LOOP_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "kinetic/common.h"
+#include "kinetic/nonblocking_kinetic_connection_interface.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+class IoUring;
+class IoUringChannel;
+
+/// Drives nonblocking connections whose socket I/O goes through an io_uring
+/// instead of read and sendmsg calls. Create connections for a loop with
+/// KineticConnectionFactory::NewIoUringConnection; they're registered with
+/// the loop as they're made.
+///
+/// Running a connection only queues its sends and receives on the ring, so it
+/// costs no system calls. RunOnce then hands everything queued to the kernel
+/// and waits for completions in a single io_uring_enter, and runs the
+/// connections whose I/O completed. Received bytes land in a buffer
+/// registered with the ring where the kernel supports it. Requests, values
+/// included, are sent straight from their own memory with SENDMSG rather than
+/// from registered buffers; see IoUringPacketWriter for why.
+///
+/// Usage mirrors KineticReactor: call Flush after submitting requests on a
+/// connection, and RunOnce to get responses. A loop and its connections must
+/// only be used from one thread at a time.
+class IoUringLoop {
+    public:
+    /// entries bounds how many operations can be queued between calls to
+    /// RunOnce before the queue has to be flushed early
+    explicit IoUringLoop(unsigned int entries = 256);
+    /// Cancels any I/O still in progress and waits for it to finish. The
+    /// loop's connections fail from then on.
+    ~IoUringLoop();
+
+    /// False if io_uring isn't available, in which case connections can't be
+    /// created for the loop
+    bool available() const;
+
+    /// Stops driving connection and cancels its I/O. The connection fails from
+    /// then on. Returns false if it wasn't registered.
+    bool Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection);
+
+    /// Runs connection now, queueing whatever has been submitted on it.
+    /// Returns false if the connection has failed, in which case it's removed.
+    bool Flush(const shared_ptr<NonblockingKineticConnectionInterface>& connection);
+
+    /// Submits queued I/O and waits up to timeout_ms milliseconds (-1 waits
+    /// indefinitely) for some of it to complete, then runs the connections
+    /// whose I/O completed. Connections that fail are removed. Returns the
+    /// number of connections run, or -1 with errno set on failure.
+    int RunOnce(int timeout_ms);
+
+    /// A descriptor that becomes readable when completions are waiting, for
+    /// plugging the loop into another event loop
+    int fd() const;
+
+    /// Number of registered connections
+    size_t size() const { return registrations_.size(); }
+
+    private:
+    friend class KineticConnectionFactory;
+    friend class IoUringChannel;
+
+    struct Registration {
+        shared_ptr<NonblockingKineticConnectionInterface> connection;
+        shared_ptr<IoUringChannel> channel;
+    };
+
+    shared_ptr<IoUringChannel> NewChannel(int fd);
+    bool Add(shared_ptr<NonblockingKineticConnectionInterface> connection,
+        shared_ptr<IoUringChannel> channel);
+    bool Run(IoUringChannel *channel);
+    void Unregister(unordered_map<IoUringChannel *, Registration>::iterator it);
+    bool Drain(IoUringChannel *channel);
+    void ReleaseBufferSlot(IoUringChannel *channel);
+    void ReleaseParked();
+    void ReapCompletions();
+
+    unique_ptr<IoUring> ring_;
+    bool available_;
+    // Registered buffer slots not in use by any channel
+    vector<int> free_buffer_slots_;
+    unordered_map<IoUringChannel *, Registration> registrations_;
+    // Channels with completions whose connections haven't been run since
+    vector<IoUringChannel *> ready_;
+    // Removed connections whose cancelled I/O hadn't finished when they were
+    // removed, kept until it has
+    vector<Registration> parked_;
+    DISALLOW_COPY_AND_ASSIGN(IoUringLoop);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_IO_URING_LOOP_H_
@@ -21,6 +21,11 @@
 /// Applications should only include this file
 
 #include "kinetic/kinetic_connection_factory.h"
+#include "kinetic/async_kinetic_connection.h"
+#include "kinetic/kinetic_coroutines.h"
+#include "kinetic/kinetic_client_runtime.h"
+#include "kinetic/kinetic_reactor.h"
+#include "kinetic/io_uring_loop.h"
 #include "kinetic/key_range_iterator.h"
 #include "kinetic/kinetic_status.h"
 
@@ -0,0 +1,82 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_KINETIC_CLIENT_RUNTIME_H_
+#define KINETIC_CPP_CLIENT_KINETIC_CLIENT_RUNTIME_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "kinetic/common.h"
+#include "kinetic/nonblocking_kinetic_connection_interface.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+/// Runs nonblocking connections on I/O threads of its own, so that nothing
+/// else has to call Run or wait on their sockets. Each thread drives its share
+/// of the connections with a KineticReactor and sleeps until one of their
+/// sockets becomes ready. Submitting a request on an added connection, from
+/// any thread, wakes the connection's I/O thread to send it right away.
+///
+/// Callbacks are called on the connection's I/O thread unless the runtime is
+/// given an executor, in which case they're handed to that. Either way they
+/// may submit more requests. To remove handlers from threads other than the
+/// runtime's own, add ThreadsafeNonblockingKineticConnections.
+class KineticClientRuntime {
+    public:
+    /// Starts io_threads I/O threads. executor, if given, is what callbacks
+    /// are run by.
+    explicit KineticClientRuntime(int io_threads = 1,
+        shared_ptr<ExecutorInterface> executor = shared_ptr<ExecutorInterface>());
+
+    /// Stops the I/O threads. Connections still added are let go of, and fail
+    /// whatever they have outstanding once nothing else holds them.
+    ~KineticClientRuntime();
+
+    /// Hands connection to one of the I/O threads. Must be called before
+    /// anything is submitted on connection. Returns false if the connection
+    /// has failed.
+    bool Add(shared_ptr<NonblockingKineticConnectionInterface> connection);
+
+    /// Stops driving connection. Once this returns connection is no longer run,
+    /// but its requests are left outstanding. Returns false if it wasn't
+    /// added, or has failed since.
+    bool Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection);
+
+    /// Number of connections being driven. Connections that fail are let go
+    /// of, like removed ones.
+    size_t size() const;
+
+    private:
+    class IoThread;
+
+    shared_ptr<ExecutorInterface> executor_;
+    vector<unique_ptr<IoThread>> threads_;
+    // Connections are handed out to the threads in turn
+    std::atomic<size_t> next_thread_;
+    DISALLOW_COPY_AND_ASSIGN(KineticClientRuntime);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_KINETIC_CLIENT_RUNTIME_H_
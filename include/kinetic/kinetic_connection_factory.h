@@ -20,22 +20,39 @@
 
 #include "kinetic/connection_options.h"
 #include "kinetic/hmac_provider.h"
+#include "kinetic/io_uring_loop.h"
 #include "kinetic/blocking_kinetic_connection.h"
 #include "kinetic/nonblocking_kinetic_connection.h"
 #include "kinetic/threadsafe_nonblocking_connection.h"
 #include "kinetic/threadsafe_blocking_kinetic_connection.h"
 #include "kinetic/status.h"
 #include <memory>
+#include <vector>
 
 namespace kinetic {
 
 using std::unique_ptr;
+using std::vector;
+
+class PendingConnection;
+class PendingKineticConnection;
+class TlsContext;
+
+/// Told how each connection opened by
+/// KineticConnectionFactory::NewNonblockingConnections turned out. index is
+/// the position of the connection's options in the list passed in.
+class ConnectCallbackInterface {
+    public:
+    virtual ~ConnectCallbackInterface() {}
+    virtual void Success(size_t index, shared_ptr<NonblockingKineticConnection> connection) = 0;
+    virtual void Failure(size_t index, Status status) = 0;
+};
 
 /// Factory class that builds KineticConnection instances. Rather than use the constructor
 /// developers should use NewKineticConnectionFactory.
 class KineticConnectionFactory {
     public:
-    explicit KineticConnectionFactory(HmacProvider hmac_provider);
+    explicit KineticConnectionFactory(shared_ptr<HmacProviderInterface> hmac_provider);
     virtual ~KineticConnectionFactory(){};
 
     /// Creates and opens a new nonblocking connection using the given options. If the returned
@@ -57,6 +74,35 @@ class KineticConnectionFactory {
             const ConnectionOptions& options,
             shared_ptr <NonblockingKineticConnection>& connection);
 
+    /// Starts opening a nonblocking connection without blocking at any point,
+    /// for driving from an event loop. See PendingKineticConnection. Fails
+    /// straight away only if the connection can't even be started, for
+    /// example because SSL can't be set up.
+    ///
+    /// @param[in] options                  Specifies host, port, user id, etc
+    /// @param[out] pending                 Populated with the connection being opened if the
+    ///                                     request succeeds
+    virtual Status StartNonblockingConnection(
+            const ConnectionOptions& options,
+            unique_ptr<PendingKineticConnection>& pending);
+
+    /// Opens a nonblocking connection for each entry of options, all at once.
+    /// Connecting, TLS handshakes and waiting for each drive's handshake
+    /// overlap across connections, so opening many takes about as long as
+    /// opening the slowest. Each connection is reported to callback as soon as
+    /// it's open or has failed; connections not open within timeout_seconds
+    /// fail. Returns once every connection has been reported. This waits on
+    /// the connections itself; to open them from an event loop instead, use
+    /// StartNonblockingConnection.
+    ///
+    /// @param[in] options                  Specifies host, port, user id, etc for each connection
+    /// @param[in] timeout_seconds          How long to give all the connections to open
+    /// @param[in] callback                 Told about each connection, on the calling thread
+    virtual void NewNonblockingConnections(
+            const vector<ConnectionOptions>& options,
+            unsigned int timeout_seconds,
+            ConnectCallbackInterface& callback);
+
     /// Like NewNonblockingConnection, except the connection is safe for use by multiple threads.
     virtual Status NewThreadsafeNonblockingConnection(
             const ConnectionOptions& options,
@@ -98,18 +144,86 @@ class KineticConnectionFactory {
             shared_ptr <ThreadsafeBlockingKineticConnection>& connection,
             unsigned int network_timeout_seconds);
 
+    /// Creates and opens a new nonblocking connection whose socket I/O goes
+    /// through loop's io_uring. The connection is registered with loop, which
+    /// runs it from then on; see IoUringLoop. SSL connections aren't
+    /// supported, and neither is a loop that isn't available().
+    ///
+    /// @param[in] options                  Specifies host, port, user id, etc
+    /// @param[in] loop                     Drives the connection. It must outlive
+    ///                                     the connection's use.
+    /// @param[out] connection              Populated with a NonblockingKineticConnection if the request
+    ///                                     succeeds
+    virtual Status NewIoUringConnection(
+            const ConnectionOptions& options,
+            IoUringLoop& loop,
+            shared_ptr <NonblockingKineticConnection>& connection);
 
     private:
-    HmacProvider hmac_provider_;
+    friend class PendingKineticConnection;
+
+    shared_ptr<HmacProviderInterface> hmac_provider_;
+    // Shared by every TLS connection the factory and its copies open, so
+    // reconnecting to a drive can resume the last session with it
+    shared_ptr<TlsContext> tls_context_;
     Status doNewConnection(
             ConnectionOptions const& options,
-            unique_ptr <NonblockingKineticConnection>& connection);
+            unique_ptr <NonblockingKineticConnection>& connection,
+            IoUringLoop *io_uring_loop = NULL,
+            shared_ptr<IoUringChannel> *io_uring_channel = NULL);
+    Status doFinishConnection(
+            ConnectionOptions const& options,
+            PendingConnection& pending,
+            unique_ptr <NonblockingKineticConnection>& connection,
+            IoUringLoop *io_uring_loop = NULL,
+            shared_ptr<IoUringChannel> *io_uring_channel = NULL);
+};
+
+/// A nonblocking connection on its way to being opened: the TCP connect, the
+/// TLS handshake if the options ask for one, and the drive's unsolicited
+/// status. Nothing about it blocks, so any number can be opened from one
+/// event loop. Call Continue to start, and again whenever the descriptor it
+/// names is ready as asked, until it returns false. The caller decides how
+/// long to wait; dropping the pending connection abandons it.
+class PendingKineticConnection {
+    public:
+    ~PendingKineticConnection();
+
+    /// Carries on opening the connection as far as possible without blocking.
+    /// Returns true while it's still being opened, with interest set to what
+    /// to wait for on interest->fd before calling again. Returns false once
+    /// it's finished, after which status() says whether it opened.
+    bool Continue(IoInterest *interest);
+
+    /// Whether the connection opened. Not ok until Continue returns false.
+    Status status() const { return status_; }
+
+    /// The opened connection, handed over to the caller. NULL unless the
+    /// connection opened, and after the first call.
+    shared_ptr<NonblockingKineticConnection> connection();
+
+    private:
+    friend class KineticConnectionFactory;
+
+    PendingKineticConnection(const KineticConnectionFactory &factory, const ConnectionOptions &options,
+        unique_ptr<PendingConnection> pending);
+
+    KineticConnectionFactory factory_;
+    const ConnectionOptions options_;
+    unique_ptr<PendingConnection> pending_;
+    Status status_;
+    shared_ptr<NonblockingKineticConnection> connection_;
+    DISALLOW_COPY_AND_ASSIGN(PendingKineticConnection);
 };
 
 /// Helper method that creates a new KineticConnectionFactory with
 /// reasonable defaults
 KineticConnectionFactory NewKineticConnectionFactory();
 
+/// Creates a KineticConnectionFactory whose connections compute and check
+/// HMACs with hmac_provider
+KineticConnectionFactory NewKineticConnectionFactory(shared_ptr<HmacProviderInterface> hmac_provider);
+
 } // namespace kinetic
 
 #endif  // KINETIC_CPP_CLIENT_KINETIC_CONNECTION_FACTORY_H_
@@ -0,0 +1,401 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_KINETIC_COROUTINES_H_
+#define KINETIC_CPP_CLIENT_KINETIC_COROUTINES_H_
+
+// Everything here needs C++20 coroutines. On older compilers, or when building
+// as C++11, the header is empty and KINETIC_HAVE_COROUTINES is left undefined.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define KINETIC_HAVE_COROUTINES 1
+#endif
+#endif
+
+#ifdef KINETIC_HAVE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kinetic/async_kinetic_connection.h"
+#include "kinetic/kinetic_reactor.h"
+#include "kinetic/nonblocking_kinetic_connection_interface.h"
+
+namespace kinetic {
+namespace coro {
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+/// Where an Operation's result ends up. It's also the callback the request was
+/// submitted with, so the coroutine waiting on the operation is resumed
+/// straight from the handler's Handle or Error, on the thread running the
+/// connection.
+template <typename Result>
+class OperationState {
+    public:
+    OperationState() : result_(), waiter_() {}
+    virtual ~OperationState() {}
+    bool done() const { return result_.has_value(); }
+    void set_waiter(std::coroutine_handle<> waiter) { waiter_ = waiter; }
+    Result Take() { return std::move(*result_); }
+
+    protected:
+    void Complete(Result result) {
+        result_.emplace(std::move(result));
+        std::coroutine_handle<> waiter = waiter_;
+        waiter_ = nullptr;
+        if (waiter) {
+            waiter.resume();
+        }
+    }
+
+    private:
+    std::optional<Result> result_;
+    std::coroutine_handle<> waiter_;
+    DISALLOW_COPY_AND_ASSIGN(OperationState);
+};
+
+/// A request that has been submitted on a connection, which a coroutine can
+/// co_await for its result. Requests are submitted as soon as the operation
+/// is created, so creating several before awaiting any of them keeps them all
+/// in flight together:
+///
+///     vector<Operation<GetResult>> gets;
+///     for (auto it = keys.begin(); it != keys.end(); ++it) {
+///         gets.push_back(scheduler.Get(connection, *it));
+///     }
+///     for (auto it = gets.begin(); it != gets.end(); ++it) {
+///         GetResult result = co_await *it;
+///     }
+///
+/// An operation can only be awaited once. If the coroutine is destroyed while
+/// waiting, the request still completes but nothing is resumed.
+template <typename Result>
+class Operation {
+    public:
+    explicit Operation(shared_ptr<OperationState<Result>> state) : state_(std::move(state)) {}
+    Operation(Operation &&other) : state_(std::move(other.state_)) {}
+    ~Operation() {
+        if (state_) {
+            state_->set_waiter(nullptr);
+        }
+    }
+
+    class Awaiter {
+        public:
+        explicit Awaiter(OperationState<Result> *state) : state_(state) {}
+        bool await_ready() const { return state_->done(); }
+        void await_suspend(std::coroutine_handle<> waiter) { state_->set_waiter(waiter); }
+        Result await_resume() { return state_->Take(); }
+
+        private:
+        OperationState<Result> *state_;
+    };
+
+    Awaiter operator co_await() { return Awaiter(state_.get()); }
+
+    private:
+    shared_ptr<OperationState<Result>> state_;
+    DISALLOW_COPY_AND_ASSIGN(Operation);
+};
+
+namespace internal {
+
+class StatusState : public OperationState<KineticStatus>, public SimpleCallbackInterface,
+        public PutCallbackInterface {
+    public:
+    void Success() {
+        Complete(KineticStatus(StatusCode::OK, ""));
+    }
+    void Failure(KineticStatus error) {
+        Complete(error);
+    }
+};
+
+class GetState : public OperationState<GetResult>, public GetCallbackInterface {
+    public:
+    void Success(const string &key, std::unique_ptr<KineticRecord> record) {
+        GetResult result(KineticStatus(StatusCode::OK, ""));
+        result.key = key;
+        result.record = std::move(record);
+        Complete(std::move(result));
+    }
+    void Failure(KineticStatus error) {
+        Complete(GetResult(error));
+    }
+};
+
+class GetKeyRangeState : public OperationState<KeyRangeResult>, public GetKeyRangeCallbackInterface {
+    public:
+    void Success(std::unique_ptr<vector<string>> keys) {
+        KeyRangeResult result(KineticStatus(StatusCode::OK, ""));
+        result.keys = std::move(keys);
+        Complete(std::move(result));
+    }
+    void Failure(KineticStatus error) {
+        Complete(KeyRangeResult(error));
+    }
+};
+
+class GetLogState : public OperationState<GetLogResult>, public GetLogCallbackInterface {
+    public:
+    void Success(std::unique_ptr<DriveLog> drive_log) {
+        GetLogResult result(KineticStatus(StatusCode::OK, ""));
+        result.drive_log = std::move(drive_log);
+        Complete(std::move(result));
+    }
+    void Failure(KineticStatus error) {
+        Complete(GetLogResult(error));
+    }
+};
+
+class P2PPushState : public OperationState<P2PPushResult>, public P2PPushCallbackInterface {
+    public:
+    void Success(std::unique_ptr<vector<KineticStatus>> operation_statuses, const Command &response) {
+        P2PPushResult result(KineticStatus(StatusCode::OK, ""));
+        result.operation_statuses = std::move(operation_statuses);
+        Complete(std::move(result));
+    }
+    void Failure(KineticStatus error, Command const * const response) {
+        Complete(P2PPushResult(error));
+    }
+};
+
+} // namespace internal
+
+/// Submit requests on a connection and return an Operation for each. The
+/// connection isn't touched again until it's run, whether by hand, by an
+/// AsyncKineticConnection or by a Scheduler.
+inline Operation<KineticStatus> NoOp(NonblockingKineticConnectionInterface &connection) {
+    auto state = make_shared<internal::StatusState>();
+    connection.NoOp(state);
+    return Operation<KineticStatus>(state);
+}
+
+inline Operation<GetResult> Get(NonblockingKineticConnectionInterface &connection,
+        const shared_ptr<const string> key) {
+    auto state = make_shared<internal::GetState>();
+    connection.Get(key, state);
+    return Operation<GetResult>(state);
+}
+
+inline Operation<GetResult> Get(NonblockingKineticConnectionInterface &connection, const string &key) {
+    return Get(connection, make_shared<string>(key));
+}
+
+inline Operation<GetResult> GetNext(NonblockingKineticConnectionInterface &connection, const string &key) {
+    auto state = make_shared<internal::GetState>();
+    connection.GetNext(key, state);
+    return Operation<GetResult>(state);
+}
+
+inline Operation<GetResult> GetPrevious(NonblockingKineticConnectionInterface &connection,
+        const string &key) {
+    auto state = make_shared<internal::GetState>();
+    connection.GetPrevious(key, state);
+    return Operation<GetResult>(state);
+}
+
+inline Operation<KineticStatus> Put(NonblockingKineticConnectionInterface &connection,
+        const shared_ptr<const string> key, const shared_ptr<const string> current_version, WriteMode mode,
+        const shared_ptr<const KineticRecord> record, PersistMode persist_mode = PersistMode::WRITE_BACK) {
+    auto state = make_shared<internal::StatusState>();
+    connection.Put(key, current_version, mode, record, state, persist_mode);
+    return Operation<KineticStatus>(state);
+}
+
+inline Operation<KineticStatus> Put(NonblockingKineticConnectionInterface &connection, const string &key,
+        const string &current_version, WriteMode mode, const shared_ptr<const KineticRecord> record,
+        PersistMode persist_mode = PersistMode::WRITE_BACK) {
+    return Put(connection, make_shared<string>(key), make_shared<string>(current_version), mode, record,
+        persist_mode);
+}
+
+inline Operation<KineticStatus> Delete(NonblockingKineticConnectionInterface &connection,
+        const shared_ptr<const string> key, const shared_ptr<const string> version, WriteMode mode,
+        PersistMode persist_mode = PersistMode::WRITE_BACK) {
+    auto state = make_shared<internal::StatusState>();
+    connection.Delete(key, version, mode, state, persist_mode);
+    return Operation<KineticStatus>(state);
+}
+
+inline Operation<KineticStatus> Delete(NonblockingKineticConnectionInterface &connection, const string &key,
+        const string &version, WriteMode mode, PersistMode persist_mode = PersistMode::WRITE_BACK) {
+    return Delete(connection, make_shared<string>(key), make_shared<string>(version), mode, persist_mode);
+}
+
+inline Operation<KeyRangeResult> GetKeyRange(NonblockingKineticConnectionInterface &connection,
+        const string &start_key, bool start_key_inclusive, const string &end_key, bool end_key_inclusive,
+        bool reverse_results, int32_t max_results) {
+    auto state = make_shared<internal::GetKeyRangeState>();
+    connection.GetKeyRange(start_key, start_key_inclusive, end_key, end_key_inclusive, reverse_results,
+        max_results, state);
+    return Operation<KeyRangeResult>(state);
+}
+
+inline Operation<GetLogResult> GetLog(NonblockingKineticConnectionInterface &connection) {
+    auto state = make_shared<internal::GetLogState>();
+    connection.GetLog(state);
+    return Operation<GetLogResult>(state);
+}
+
+inline Operation<GetLogResult> GetLog(NonblockingKineticConnectionInterface &connection,
+        const vector<Command_GetLog_Type> &types) {
+    auto state = make_shared<internal::GetLogState>();
+    connection.GetLog(types, state);
+    return Operation<GetLogResult>(state);
+}
+
+inline Operation<P2PPushResult> P2PPush(NonblockingKineticConnectionInterface &connection,
+        const P2PPushRequest &push_request) {
+    auto state = make_shared<internal::P2PPushState>();
+    connection.P2PPush(push_request, state);
+    return Operation<P2PPushResult>(state);
+}
+
+/// The return type for coroutines that await operations. A Task starts
+/// running as soon as it's called and carries on by itself whenever the
+/// operation it's waiting on completes; there's nothing to wait on or destroy.
+/// An exception escaping the coroutine terminates the program, since there's
+/// nowhere for it to go.
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/// Drives coroutines' operations on connections registered with a
+/// KineticReactor. A request submitted through the scheduler is sent the next
+/// time the scheduler runs, even when it was submitted on one connection by a
+/// coroutine resumed from inside another connection's Run, which the reactor
+/// on its own would leave until that connection was next flushed.
+///
+/// Like the reactor, a scheduler must only be used from one thread, and every
+/// coroutine awaiting its operations is resumed on that thread.
+class Scheduler {
+    public:
+    explicit Scheduler(KineticReactor *reactor) : reactor_(reactor), pending_() {}
+
+    Operation<KineticStatus> NoOp(const shared_ptr<NonblockingKineticConnectionInterface> &connection) {
+        Submitted(connection);
+        return coro::NoOp(*connection);
+    }
+    Operation<GetResult> Get(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &key) {
+        Submitted(connection);
+        return coro::Get(*connection, key);
+    }
+    Operation<GetResult> GetNext(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &key) {
+        Submitted(connection);
+        return coro::GetNext(*connection, key);
+    }
+    Operation<GetResult> GetPrevious(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &key) {
+        Submitted(connection);
+        return coro::GetPrevious(*connection, key);
+    }
+    Operation<KineticStatus> Put(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &key, const string &current_version, WriteMode mode,
+            const shared_ptr<const KineticRecord> record, PersistMode persist_mode = PersistMode::WRITE_BACK) {
+        Submitted(connection);
+        return coro::Put(*connection, key, current_version, mode, record, persist_mode);
+    }
+    Operation<KineticStatus> Delete(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &key, const string &version, WriteMode mode,
+            PersistMode persist_mode = PersistMode::WRITE_BACK) {
+        Submitted(connection);
+        return coro::Delete(*connection, key, version, mode, persist_mode);
+    }
+    Operation<KeyRangeResult> GetKeyRange(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const string &start_key, bool start_key_inclusive, const string &end_key, bool end_key_inclusive,
+            bool reverse_results, int32_t max_results) {
+        Submitted(connection);
+        return coro::GetKeyRange(*connection, start_key, start_key_inclusive, end_key, end_key_inclusive,
+            reverse_results, max_results);
+    }
+    Operation<GetLogResult> GetLog(const shared_ptr<NonblockingKineticConnectionInterface> &connection) {
+        Submitted(connection);
+        return coro::GetLog(*connection);
+    }
+    Operation<P2PPushResult> P2PPush(const shared_ptr<NonblockingKineticConnectionInterface> &connection,
+            const P2PPushRequest &push_request) {
+        Submitted(connection);
+        return coro::P2PPush(*connection, push_request);
+    }
+
+    /// Sends everything submitted since the last run, then runs the reactor
+    /// once, waiting up to timeout_ms milliseconds (-1 waits indefinitely).
+    /// Coroutines resumed along the way may submit more, which is sent before
+    /// returning. Returns what KineticReactor::RunOnce does.
+    int RunOnce(int timeout_ms) {
+        FlushPending();
+        int run = reactor_->RunOnce(timeout_ms);
+        if (run < 0) {
+            return run;
+        }
+        FlushPending();
+        return run;
+    }
+
+    private:
+    void Submitted(const shared_ptr<NonblockingKineticConnectionInterface> &connection) {
+        for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+            if (*it == connection) {
+                return;
+            }
+        }
+        pending_.push_back(connection);
+    }
+
+    void FlushPending() {
+        // Flushing runs the connection, which can resume coroutines that
+        // submit yet more
+        while (!pending_.empty()) {
+            vector<shared_ptr<NonblockingKineticConnectionInterface>> pending;
+            pending.swap(pending_);
+            for (auto it = pending.begin(); it != pending.end(); ++it) {
+                reactor_->Flush(*it);
+            }
+        }
+    }
+
+    KineticReactor *const reactor_;
+    // Connections with requests submitted since they were last flushed
+    vector<shared_ptr<NonblockingKineticConnectionInterface>> pending_;
+    DISALLOW_COPY_AND_ASSIGN(Scheduler);
+};
+
+} // namespace coro
+} // namespace kinetic
+
+#endif  // KINETIC_HAVE_COROUTINES
+
+#endif  // KINETIC_CPP_CLIENT_KINETIC_COROUTINES_H_
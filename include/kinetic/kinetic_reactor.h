@@ -0,0 +1,102 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_KINETIC_REACTOR_H_
+#define KINETIC_CPP_CLIENT_KINETIC_REACTOR_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "kinetic/common.h"
+#include "kinetic/nonblocking_kinetic_connection_interface.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::unordered_map;
+
+/// Drives many nonblocking connections from one thread. Instead of building
+/// fd_sets for every connection on every pass, the reactor registers each
+/// connection's socket once with epoll (edge-triggered) and only runs a
+/// connection when its socket has become ready. Where epoll isn't available
+/// it falls back to poll, which is still free of the FD_SETSIZE limit.
+///
+/// Requests submitted on a registered connection aren't sent until the
+/// connection runs, so call Flush after submitting. Responses are then
+/// picked up by RunOnce.
+///
+/// Like the connections it drives, a reactor must only be used from one
+/// thread at a time. Callbacks run on the thread calling RunOnce or Flush and
+/// may submit more requests, and add or remove connections. Requests a
+/// callback submits on the connection it was called for are sent before that
+/// connection's run ends; ones submitted on other connections need a Flush.
+class KineticReactor {
+    public:
+    KineticReactor();
+    ~KineticReactor();
+
+    /// Starts driving connection, which is run once to learn its socket.
+    /// Returns false if the connection has failed, is already registered, or
+    /// the reactor couldn't be set up.
+    bool Add(shared_ptr<NonblockingKineticConnectionInterface> connection);
+
+    /// Stops driving connection. Returns false if it wasn't registered.
+    bool Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection);
+
+    /// Runs connection now, sending whatever has been submitted on it as far
+    /// as its socket allows. Returns false if the connection has failed, in
+    /// which case it's removed.
+    bool Flush(const shared_ptr<NonblockingKineticConnectionInterface>& connection);
+
+    /// Waits up to timeout_ms milliseconds (-1 waits indefinitely) for
+    /// registered sockets to become ready, then runs their connections.
+    /// Connections that fail are removed. Returns the number of connections
+    /// run, or -1 with errno set if waiting failed.
+    int RunOnce(int timeout_ms);
+
+    /// A descriptor that becomes readable whenever RunOnce(0) has something to
+    /// do, for plugging the reactor into another event loop. -1 where epoll
+    /// isn't available.
+    int fd() const;
+
+    /// Number of registered connections
+    size_t size() const { return registrations_.size(); }
+
+    private:
+    struct Registration {
+        shared_ptr<NonblockingKineticConnectionInterface> connection;
+        IoInterest interest;
+    };
+
+    bool Run(uint64_t id);
+    void Unregister(unordered_map<uint64_t, Registration>::iterator it);
+
+    int epoll_fd_;
+    uint64_t next_id_;
+    unordered_map<uint64_t, Registration> registrations_;
+    // Registration ids by connection, so that Flush and Remove don't have to
+    // search
+    unordered_map<const NonblockingKineticConnectionInterface *, uint64_t> ids_;
+    DISALLOW_COPY_AND_ASSIGN(KineticReactor);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_KINETIC_REACTOR_H_
@@ -20,6 +20,7 @@
 
 #include <memory>
 #include "kinetic/common.h"
+#include "kinetic/packet_value.h"
 #include "kinetic_client.pb.h"
 
 namespace kinetic {
@@ -36,23 +37,37 @@ class KineticRecord {
     public:
     KineticRecord(const shared_ptr<const string> value, const shared_ptr<const string> version,
             const shared_ptr<const string> tag, Command_Algorithm algorithm) :
-            value_(value), version_(version), tag_(tag), algorithm_(
+            value_(value), packet_value_(value), version_(version), tag_(tag), algorithm_(
                     algorithm) {
     }
     KineticRecord(const string value, const string version, const string tag,
             Command_Algorithm algorithm) :
-        value_(make_shared<string>(value)), version_(make_shared<string>(version)),
-        tag_(make_shared<string>(tag)), algorithm_(algorithm) {
+        value_(make_shared<string>(value)), packet_value_(value_),
+        version_(make_shared<string>(version)), tag_(make_shared<string>(tag)),
+        algorithm_(algorithm) {
+    }
+    /// A record for a PUT whose value may be a list of slices or a range of a
+    /// file, which the connection sends without first copying it into one string
+    KineticRecord(const PacketValue& value, const shared_ptr<const string> version,
+            const shared_ptr<const string> tag, Command_Algorithm algorithm) :
+        value_(value.string_value()), packet_value_(value), version_(version), tag_(tag),
+        algorithm_(algorithm) {
     }
     explicit KineticRecord(const KineticRecord& other) : value_(other.value_),
-        version_(other.version_), tag_(other.tag_), algorithm_(other.algorithm_) {
+        packet_value_(other.packet_value_), version_(other.version_), tag_(other.tag_),
+        algorithm_(other.algorithm_) {
     }
 
-    /// The value itself
+    /// The value itself. NULL if the record was built from a sliced or file value.
     const shared_ptr<const string> value() const {
         return value_;
     }
 
+    /// The value as it is sent in a PUT
+    const PacketValue& packet_value() const {
+        return packet_value_;
+    }
+
     /// The value's version
     const shared_ptr<const string> version() const {
         return version_;
@@ -71,6 +86,7 @@ class KineticRecord {
 
     private:
     const shared_ptr<const string> value_;
+    const PacketValue packet_value_;
     const shared_ptr<const string> version_;
     const shared_ptr<const string> tag_;
     const Command_Algorithm algorithm_;
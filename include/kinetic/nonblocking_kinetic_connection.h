@@ -18,21 +18,43 @@
 #ifndef KINETIC_CPP_CLIENT_NONBLOCKING_KINETIC_CONNECTION_H_
 #define KINETIC_CPP_CLIENT_NONBLOCKING_KINETIC_CONNECTION_H_
 
+#include <atomic>
+
 #include "nonblocking_kinetic_connection_interface.h"
 
 namespace kinetic {
 
+class RequestPools;
+
 class NonblockingKineticConnection : public NonblockingKineticConnectionInterface{
     public:
-    explicit NonblockingKineticConnection(NonblockingPacketServiceInterface *service);
+    /// Requests are built from messages taken from pools, which whatever
+    /// sends them should give them back to. Without pools of its own the
+    /// connection makes some that nothing gives back to.
+    explicit NonblockingKineticConnection(NonblockingPacketServiceInterface *service,
+        shared_ptr<RequestPools> pools = shared_ptr<RequestPools>());
     ~NonblockingKineticConnection();
     bool Run(fd_set *read_fds, fd_set *write_fds, int *nfds);
+    bool Run(IoInterest *interest);
     bool RemoveHandler(HandlerKey handler_key);
+    void SetSubmitListener(std::function<void()> listener);
+    void SetCompletionExecutor(shared_ptr<ExecutorInterface> executor);
     void SetClientClusterVersion(int64_t cluster_version);
 
     HandlerKey NoOp(const shared_ptr<SimpleCallbackInterface> callback);
     HandlerKey Get(const string key, const shared_ptr<GetCallbackInterface> callback);
     HandlerKey Get(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
+    HandlerKey GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback);
+    HandlerKey GetInto(const string key, char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback);
+    HandlerKey GetInto(const shared_ptr<const string> key, string *buffer,
+        const shared_ptr<GetIntoCallbackInterface> callback);
+    HandlerKey GetInto(const string key, string *buffer, const shared_ptr<GetIntoCallbackInterface> callback);
+    HandlerKey GetToFile(const shared_ptr<const string> key, int fd, off_t offset,
+        const shared_ptr<GetIntoCallbackInterface> callback);
+    HandlerKey GetToFile(const string key, int fd, off_t offset,
+        const shared_ptr<GetIntoCallbackInterface> callback);
     HandlerKey GetNext(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
     HandlerKey GetNext(const string key, const shared_ptr<GetCallbackInterface> callback);
     HandlerKey GetPrevious(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
@@ -95,15 +117,19 @@ class NonblockingKineticConnection : public NonblockingKineticConnectionInterfac
     private:
     HandlerKey GenericGet(const shared_ptr<const string> key,
         const shared_ptr<GetCallbackInterface> callback, Command_MessageType message_type);
+    HandlerKey SubmitGetInto(const shared_ptr<const string> key, unique_ptr<GetIntoHandler> handler);
     void PopulateP2PMessage(Command_P2POperation *mutable_p2pop,
         const shared_ptr<const P2PPushRequest> push_request);
+    unique_ptr<Message> NewMessage();
     unique_ptr<Command> NewCommand(Command_MessageType message_type);
     Command_Synchronization GetSynchronizationForPersistMode(PersistMode persistMode);
 
     NonblockingPacketServiceInterface *service_;
-    const shared_ptr<const string> empty_str_;
+    shared_ptr<RequestPools> pools_;
+    const PacketValue empty_value_;
 
-    int64_t cluster_version_;
+    // Read by every request, which may be built on any thread
+    std::atomic<int64_t> cluster_version_;
 
     DISALLOW_COPY_AND_ASSIGN(NonblockingKineticConnection);
 };
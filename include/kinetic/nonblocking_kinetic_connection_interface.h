@@ -26,6 +26,7 @@
 #include "kinetic/kinetic_connection.h"
 #include "kinetic/kinetic_status.h"
 #include "kinetic/nonblocking_packet_service_interface.h"
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -84,6 +85,41 @@ class GetHandler : public HandlerInterface {
     DISALLOW_COPY_AND_ASSIGN(GetHandler);
 };
 
+// GetIntoCallbackInterface is used by GetInto and GetToFile, which receive the
+// value into a buffer or file supplied by the caller instead of allocating a
+// KineticRecord
+class GetIntoCallbackInterface {
+    public:
+    virtual ~GetIntoCallbackInterface() {}
+    /// value_size bytes of value have been written to the buffer given to GetInto,
+    /// or to the file given to GetToFile
+    virtual void Success(const std::string &key, size_t value_size, const std::string &version,
+        const std::string &tag, Command_Algorithm algorithm) = 0;
+    virtual void Failure(KineticStatus error) = 0;
+};
+
+class GetIntoHandler : public HandlerInterface {
+    public:
+    GetIntoHandler(char *buffer, size_t capacity, const shared_ptr<GetIntoCallbackInterface> callback);
+    GetIntoHandler(string *buffer, const shared_ptr<GetIntoCallbackInterface> callback);
+    GetIntoHandler(int fd, off_t offset, const shared_ptr<GetIntoCallbackInterface> callback);
+    void Handle(const Command &response, unique_ptr<const string> value);
+    void Error(KineticStatus error, Command const * const response);
+    char* ValueDestination(size_t value_length);
+    int ValueFile(size_t value_length, off_t *offset);
+
+    private:
+    // Exactly one of buffer_, string_buffer_ and fd_ is used
+    char *const buffer_;
+    const size_t capacity_;
+    string *const string_buffer_;
+    const int fd_;
+    const off_t file_offset_;
+    size_t value_size_;
+    const shared_ptr<GetIntoCallbackInterface> callback_;
+    DISALLOW_COPY_AND_ASSIGN(GetIntoHandler);
+};
+
 class GetVersionCallbackInterface {
     public:
     virtual ~GetVersionCallbackInterface() {}
@@ -218,12 +254,49 @@ public:
     virtual ~NonblockingKineticConnectionInterface() {};
     virtual void SetClientClusterVersion(int64_t cluster_version) = 0;
     virtual bool Run(fd_set *read_fds, fd_set *write_fds, int *nfds) = 0;
+    /// Like the fd_set version, but reports what the connection is waiting on
+    /// in interest, so it isn't limited to descriptors below FD_SETSIZE
+    virtual bool Run(IoInterest *interest) = 0;
     virtual bool RemoveHandler(HandlerKey handler_key) = 0;
+    /// Has listener called on the submitting thread after each request is
+    /// submitted, so whatever runs the connection can be told there's
+    /// something to send. Must be set before requests are submitted from other
+    /// threads. Connections that can't report submissions ignore this.
+    virtual void SetSubmitListener(std::function<void()> listener) {}
+    /// Has callbacks called through executor rather than on the thread calling
+    /// Run. NULL, the default, calls them inline. Must be set before any
+    /// requests are submitted.
+    virtual void SetCompletionExecutor(shared_ptr<ExecutorInterface> executor) {}
 
     virtual HandlerKey NoOp(const shared_ptr<SimpleCallbackInterface> callback) = 0;
     virtual HandlerKey Get(const string key, const shared_ptr<GetCallbackInterface> callback) = 0;
     virtual HandlerKey Get(const shared_ptr<const string> key,
         const shared_ptr<GetCallbackInterface> callback) = 0;
+    /// Like Get, but the value is received straight into buffer, which must be able to
+    /// hold it and must stay valid until the callback runs or the handler is removed.
+    /// The value arrives before the response's HMAC can be checked, so after Failure
+    /// the buffer's contents are unverified and shouldn't be used.
+    virtual HandlerKey GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
+    virtual HandlerKey GetInto(const string key, char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
+    /// Like Get, but the value is received straight into buffer, which is resized to fit
+    /// and can be reused across requests to avoid allocating. As above, its contents are
+    /// unverified after Failure.
+    virtual HandlerKey GetInto(const shared_ptr<const string> key, string *buffer,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
+    virtual HandlerKey GetInto(const string key, string *buffer,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
+    /// Like Get, but the value is written to the file open on fd starting at offset,
+    /// without ever being held in memory as a whole. fd must stay open until the
+    /// callback runs or the handler is removed. The file is written before the
+    /// response's HMAC can be checked, so after Failure that range of it may hold
+    /// unverified bytes. To keep them out of a file that matters, receive into a
+    /// scratch file and rename it into place once the callback reports Success.
+    virtual HandlerKey GetToFile(const shared_ptr<const string> key, int fd, off_t offset,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
+    virtual HandlerKey GetToFile(const string key, int fd, off_t offset,
+        const shared_ptr<GetIntoCallbackInterface> callback) = 0;
     virtual HandlerKey GetNext(const shared_ptr<const string> key,
         const shared_ptr<GetCallbackInterface> callback) = 0;
     virtual HandlerKey GetNext(const string key,
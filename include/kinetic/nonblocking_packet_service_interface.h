@@ -19,9 +19,11 @@
 #define KINETIC_CPP_CLIENT_NONBLOCKING_PACKET_SERVICE_INTERFACE_H_
 
 #include <sys/select.h>
+#include <functional>
 #include <memory>
 
 #include "kinetic/kinetic_status.h"
+#include "kinetic/packet_value.h"
 #include "kinetic_client.pb.h"
 
 namespace kinetic {
@@ -35,6 +37,16 @@ using std::string;
 
 typedef uint64_t HandlerKey;
 
+/// What a connection is waiting on before it can make more progress: its
+/// socket becoming readable, writable or both. Unlike an fd_set this works
+/// for any descriptor, however large.
+struct IoInterest {
+    IoInterest() : fd(-1), read(false), write(false) {}
+    int fd;
+    bool read;
+    bool write;
+};
+
 // Instances of this cannot be re-used for multiple requests as they are deleted after processing.
 class HandlerInterface {
     public:
@@ -43,16 +55,51 @@ class HandlerInterface {
     // response is re-used, so make sure to copy everything you need out of it
     virtual void Handle(const Command &response, unique_ptr<const string> value) = 0;
     virtual void Error(KineticStatus error, Command const * const response) = 0;
+
+    // Called once the response has arrived but before its value has been read. Handlers
+    // that want the value read straight into their own memory return a pointer to
+    // value_length writable bytes, in which case Handle is passed a NULL value. Neither
+    // the memory nor the file given to ValueFile is touched after the handler is removed.
+    // The value is read into the memory before the response's HMAC is checked, so if
+    // Error is called instead of Handle the memory may hold bytes that didn't come from
+    // the drive. Don't point it at anything that must only ever hold verified data.
+    virtual char* ValueDestination(size_t value_length) {
+        return NULL;
+    }
+
+    // Like ValueDestination, but for handlers that want the value written to a
+    // file. Returns a file descriptor and sets offset to where in the file the
+    // value goes, or returns -1 to have the value read as usual. If the value
+    // can't be written Error is called instead of Handle. As with
+    // ValueDestination, the file is written before the HMAC is checked.
+    virtual int ValueFile(size_t value_length, off_t *offset) {
+        return -1;
+    }
+};
+
+/// Runs work handed to it, on whatever thread and whenever it sees fit
+class ExecutorInterface {
+    public:
+    virtual ~ExecutorInterface() {}
+    virtual void Execute(std::function<void()> task) = 0;
 };
 
 class NonblockingPacketServiceInterface {
     public:
     virtual ~NonblockingPacketServiceInterface() {}
     // message is modified in this call hierarchy
-    virtual HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    virtual HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
             unique_ptr<HandlerInterface> handler) = 0;
     virtual bool Run(fd_set *read_fds, fd_set *write_fds, int *nfds) = 0;
+    virtual bool Run(IoInterest *interest) = 0;
     virtual bool Remove(HandlerKey handler_key) = 0;
+    // Has listener called on the submitting thread after each request is
+    // submitted. Must be set before requests are submitted from other threads.
+    virtual void SetSubmitListener(std::function<void()> listener) {}
+    // Has handlers called through executor instead of on the thread running
+    // the service. NULL, the default, calls them inline. Must be set before
+    // any requests are submitted.
+    virtual void SetCompletionExecutor(shared_ptr<ExecutorInterface> executor) {}
 };
 
 } // namespace kinetic
@@ -0,0 +1,120 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+#ifndef KINETIC_CPP_CLIENT_PACKET_VALUE_H_
+#define KINETIC_CPP_CLIENT_PACKET_VALUE_H_
+
+#include <sys/types.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+/// One piece of a value made up of several buffers: length bytes at data,
+/// which owner keeps alive. Any shared_ptr can be the owner, so a slice can
+/// point into a string, a vector or memory the caller manages itself.
+struct ValueSlice {
+    ValueSlice(const shared_ptr<const void> owner, const char *data, size_t length) :
+        owner(owner), data(data), length(length) {}
+
+    /// The whole of a string
+    explicit ValueSlice(const shared_ptr<const string> value) :
+        owner(value), data(value->data()), length(value->size()) {}
+
+    shared_ptr<const void> owner;
+    const char *data;
+    size_t length;
+};
+
+/// The value sent along with a request. Usually this is a string, but it can
+/// also be a list of slices, which are sent one after another without being
+/// joined together first, or a range of an open file, in which case the value
+/// is sent straight from the file when the request goes out instead of being
+/// read into memory first. Copies are cheap and share the underlying value.
+class PacketValue {
+    public:
+    /// A value held in a string
+    explicit PacketValue(const shared_ptr<const string> value) :
+        string_(value), slices_(), fd_(-1), offset_(0), size_(value ? value->size() : 0) {}
+
+    /// A value made of the given slices in order. The slices' memory must not
+    /// change until the request's callback runs.
+    explicit PacketValue(const vector<ValueSlice>& slices) :
+        string_(), slices_(std::make_shared<const vector<ValueSlice>>(slices)), fd_(-1),
+        offset_(0), size_(0) {
+        for (auto it = slices.begin(); it != slices.end(); ++it) {
+            size_ += it->length;
+        }
+    }
+
+    /// length bytes of the file open on fd, starting at offset. The file is
+    /// read as the request is sent, so fd must stay open and the range must
+    /// not change until the request's callback runs.
+    PacketValue(int fd, off_t offset, size_t length) :
+        string_(), slices_(), fd_(fd), offset_(offset), size_(length) {}
+
+    size_t size() const {
+        return size_;
+    }
+
+    /// True if the value is a range of a file rather than a string
+    bool is_file() const {
+        return fd_ != -1;
+    }
+
+    /// True if the value is a list of slices
+    bool is_slices() const {
+        return slices_.get() != NULL;
+    }
+
+    /// The string holding the value, or NULL for sliced and file values
+    const shared_ptr<const string>& string_value() const {
+        return string_;
+    }
+
+    /// The slices making up the value. Only meaningful for sliced values.
+    const vector<ValueSlice>& slices() const {
+        return *slices_;
+    }
+
+    /// The file holding the value and where in it the value starts. Only
+    /// meaningful for file values.
+    int fd() const {
+        return fd_;
+    }
+
+    off_t offset() const {
+        return offset_;
+    }
+
+    private:
+    shared_ptr<const string> string_;
+    shared_ptr<const vector<ValueSlice>> slices_;
+    int fd_;
+    off_t offset_;
+    size_t size_;
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_PACKET_VALUE_H_
@@ -20,7 +20,6 @@
 
 
 #include "kinetic/blocking_kinetic_connection.h"
-#include <mutex>
 
 namespace kinetic {
 
@@ -28,6 +27,10 @@ using std::shared_ptr;
 using std::unique_ptr;
 using std::string;
 
+/// A blocking connection for use by several threads at once. Calls from
+/// different threads don't wait for each other: their requests are all in
+/// flight on the connection together, and each call returns as soon as its
+/// own response has arrived.
 class ThreadsafeBlockingKineticConnection : public BlockingKineticConnectionInterface {
     public:
     explicit ThreadsafeBlockingKineticConnection(
@@ -44,6 +47,19 @@ class ThreadsafeBlockingKineticConnection : public BlockingKineticConnectionInte
 
       KineticStatus Get(const string& key, unique_ptr<KineticRecord>& record);
 
+      KineticStatus GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+              size_t *value_size);
+
+      KineticStatus GetInto(const string& key, char *buffer, size_t capacity, size_t *value_size);
+
+      KineticStatus GetInto(const shared_ptr<const string> key, string *value);
+
+      KineticStatus GetInto(const string& key, string *value);
+
+      KineticStatus GetToFile(const shared_ptr<const string> key, int fd, off_t offset, size_t *value_size);
+
+      KineticStatus GetToFile(const string& key, int fd, off_t offset, size_t *value_size);
+
       KineticStatus GetNext(
               const shared_ptr<const string> key,
               unique_ptr<string>& actual_key,
@@ -155,7 +171,7 @@ class ThreadsafeBlockingKineticConnection : public BlockingKineticConnectionInte
 
 
     private:
-    std::recursive_mutex mutex_;
+    // Safe for concurrent calls itself, see BlockingKineticConnection
     unique_ptr<BlockingKineticConnection> connection_;
 };
 
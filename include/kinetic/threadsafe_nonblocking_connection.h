@@ -27,18 +27,36 @@ namespace kinetic {
 /// Kinetic connection class variant that synchronizes concurrent access and allows non-blocking
 /// IO. Instead of constructing this class directly users should harness the
 /// KineticConnectionFactory
+///
+/// Requests can be submitted from any number of threads at once without taking a lock: each
+/// is built, serialized and signed on the submitting thread and then handed over to whichever
+/// thread calls Run, which sends it. Only Run and RemoveHandler are serialized with a mutex.
 class ThreadsafeNonblockingKineticConnection : public NonblockingKineticConnectionInterface {
 
 public:
     explicit ThreadsafeNonblockingKineticConnection(unique_ptr<NonblockingKineticConnection> connection);
     ~ThreadsafeNonblockingKineticConnection();
     bool Run(fd_set *read_fds, fd_set *write_fds, int *nfds);
+    bool Run(IoInterest *interest);
     bool RemoveHandler(HandlerKey handler_key);
+    void SetSubmitListener(std::function<void()> listener);
+    void SetCompletionExecutor(shared_ptr<ExecutorInterface> executor);
     void SetClientClusterVersion(int64_t cluster_version);
 
     HandlerKey NoOp(const shared_ptr<SimpleCallbackInterface> callback);
       HandlerKey Get(const string key, const shared_ptr<GetCallbackInterface> callback);
       HandlerKey Get(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
+      HandlerKey GetInto(const shared_ptr<const string> key, char *buffer, size_t capacity,
+          const shared_ptr<GetIntoCallbackInterface> callback);
+      HandlerKey GetInto(const string key, char *buffer, size_t capacity,
+          const shared_ptr<GetIntoCallbackInterface> callback);
+      HandlerKey GetInto(const shared_ptr<const string> key, string *buffer,
+          const shared_ptr<GetIntoCallbackInterface> callback);
+      HandlerKey GetInto(const string key, string *buffer, const shared_ptr<GetIntoCallbackInterface> callback);
+      HandlerKey GetToFile(const shared_ptr<const string> key, int fd, off_t offset,
+          const shared_ptr<GetIntoCallbackInterface> callback);
+      HandlerKey GetToFile(const string key, int fd, off_t offset,
+          const shared_ptr<GetIntoCallbackInterface> callback);
       HandlerKey GetNext(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
       HandlerKey GetNext(const string key, const shared_ptr<GetCallbackInterface> callback);
       HandlerKey GetPrevious(const shared_ptr<const string> key, const shared_ptr<GetCallbackInterface> callback);
@@ -100,6 +118,8 @@ public:
 
 
     private:
+    // Held by Run and RemoveHandler. Recursive because callbacks run from Run
+    // may remove handlers.
     std::recursive_mutex mutex_;
     std::unique_ptr<NonblockingKineticConnection> connection_;
     DISALLOW_COPY_AND_ASSIGN(ThreadsafeNonblockingKineticConnection);
@@ -0,0 +1,268 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "kinetic/async_kinetic_connection.h"
+
+#include <errno.h>
+#include <poll.h>
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+using std::make_shared;
+using std::move;
+using std::promise;
+
+namespace {
+
+// Keeps the promise behind a future and tells the connection's joins each time
+// one is fulfilled. A callback dropped without being called, because its
+// request was removed, breaks its promise as a plain one would, but only after
+// the joins have been told.
+template <typename T>
+class AsyncCallback {
+    public:
+    explicit AsyncCallback(shared_ptr<AsyncCompletions> completions)
+        : promise_(), completions_(completions), fulfilled_(false) {}
+
+    virtual ~AsyncCallback() {
+        if (!fulfilled_) {
+            {
+                // Dropping the shared state with the promise breaks it
+                promise<T> broken(move(promise_));
+            }
+            completions_->Completed();
+        }
+    }
+
+    std::future<T> get_future() {
+        return promise_.get_future();
+    }
+
+    protected:
+    void Fulfil(T result) {
+        promise_.set_value(move(result));
+        fulfilled_ = true;
+        completions_->Completed();
+    }
+
+    private:
+    promise<T> promise_;
+    shared_ptr<AsyncCompletions> completions_;
+    bool fulfilled_;
+};
+
+class AsyncSimpleCallback : public AsyncCallback<KineticStatus>, public SimpleCallbackInterface,
+        public PutCallbackInterface {
+    public:
+    explicit AsyncSimpleCallback(shared_ptr<AsyncCompletions> completions) : AsyncCallback(completions) {}
+    void Success() {
+        Fulfil(KineticStatus(StatusCode::OK, ""));
+    }
+    void Failure(KineticStatus error) {
+        Fulfil(error);
+    }
+};
+
+class AsyncGetCallback : public AsyncCallback<GetResult>, public GetCallbackInterface {
+    public:
+    explicit AsyncGetCallback(shared_ptr<AsyncCompletions> completions) : AsyncCallback(completions) {}
+    void Success(const string &key, unique_ptr<KineticRecord> record) {
+        GetResult result(KineticStatus(StatusCode::OK, ""));
+        result.key = key;
+        result.record = move(record);
+        Fulfil(move(result));
+    }
+    void Failure(KineticStatus error) {
+        Fulfil(GetResult(error));
+    }
+};
+
+class AsyncGetKeyRangeCallback : public AsyncCallback<KeyRangeResult>, public GetKeyRangeCallbackInterface {
+    public:
+    explicit AsyncGetKeyRangeCallback(shared_ptr<AsyncCompletions> completions) : AsyncCallback(completions) {}
+    void Success(unique_ptr<vector<string>> keys) {
+        KeyRangeResult result(KineticStatus(StatusCode::OK, ""));
+        result.keys = move(keys);
+        Fulfil(move(result));
+    }
+    void Failure(KineticStatus error) {
+        Fulfil(KeyRangeResult(error));
+    }
+};
+
+class AsyncGetLogCallback : public AsyncCallback<GetLogResult>, public GetLogCallbackInterface {
+    public:
+    explicit AsyncGetLogCallback(shared_ptr<AsyncCompletions> completions) : AsyncCallback(completions) {}
+    void Success(unique_ptr<DriveLog> drive_log) {
+        GetLogResult result(KineticStatus(StatusCode::OK, ""));
+        result.drive_log = move(drive_log);
+        Fulfil(move(result));
+    }
+    void Failure(KineticStatus error) {
+        Fulfil(GetLogResult(error));
+    }
+};
+
+class AsyncP2PPushCallback : public AsyncCallback<P2PPushResult>, public P2PPushCallbackInterface {
+    public:
+    explicit AsyncP2PPushCallback(shared_ptr<AsyncCompletions> completions) : AsyncCallback(completions) {}
+    void Success(unique_ptr<vector<KineticStatus>> operation_statuses, const Command& response) {
+        P2PPushResult result(KineticStatus(StatusCode::OK, ""));
+        result.operation_statuses = move(operation_statuses);
+        Fulfil(move(result));
+    }
+    void Failure(KineticStatus error, Command const * const response) {
+        Fulfil(P2PPushResult(error));
+    }
+};
+
+} // namespace
+
+AsyncKineticConnection::AsyncKineticConnection(shared_ptr<NonblockingKineticConnectionInterface> connection)
+    : connection_(connection), completions_(make_shared<AsyncCompletions>()) {}
+
+std::future<KineticStatus> AsyncKineticConnection::NoOp() {
+    auto callback = make_shared<AsyncSimpleCallback>(completions_);
+    std::future<KineticStatus> future = callback->get_future();
+    connection_->NoOp(callback);
+    return future;
+}
+
+std::future<GetResult> AsyncKineticConnection::Get(const string &key) {
+    return Get(make_shared<string>(key));
+}
+
+std::future<GetResult> AsyncKineticConnection::Get(const shared_ptr<const string> key) {
+    auto callback = make_shared<AsyncGetCallback>(completions_);
+    std::future<GetResult> future = callback->get_future();
+    connection_->Get(key, callback);
+    return future;
+}
+
+std::future<GetResult> AsyncKineticConnection::GetNext(const string &key) {
+    auto callback = make_shared<AsyncGetCallback>(completions_);
+    std::future<GetResult> future = callback->get_future();
+    connection_->GetNext(key, callback);
+    return future;
+}
+
+std::future<GetResult> AsyncKineticConnection::GetPrevious(const string &key) {
+    auto callback = make_shared<AsyncGetCallback>(completions_);
+    std::future<GetResult> future = callback->get_future();
+    connection_->GetPrevious(key, callback);
+    return future;
+}
+
+std::future<KineticStatus> AsyncKineticConnection::Put(const string &key, const string &current_version,
+        WriteMode mode, const shared_ptr<const KineticRecord> record, PersistMode persist_mode) {
+    return Put(make_shared<string>(key), make_shared<string>(current_version), mode, record, persist_mode);
+}
+
+std::future<KineticStatus> AsyncKineticConnection::Put(const shared_ptr<const string> key,
+        const shared_ptr<const string> current_version, WriteMode mode,
+        const shared_ptr<const KineticRecord> record, PersistMode persist_mode) {
+    auto callback = make_shared<AsyncSimpleCallback>(completions_);
+    std::future<KineticStatus> future = callback->get_future();
+    connection_->Put(key, current_version, mode, record, callback, persist_mode);
+    return future;
+}
+
+std::future<KineticStatus> AsyncKineticConnection::Delete(const string &key, const string &version,
+        WriteMode mode, PersistMode persist_mode) {
+    return Delete(make_shared<string>(key), make_shared<string>(version), mode, persist_mode);
+}
+
+std::future<KineticStatus> AsyncKineticConnection::Delete(const shared_ptr<const string> key,
+        const shared_ptr<const string> version, WriteMode mode, PersistMode persist_mode) {
+    auto callback = make_shared<AsyncSimpleCallback>(completions_);
+    std::future<KineticStatus> future = callback->get_future();
+    connection_->Delete(key, version, mode, callback, persist_mode);
+    return future;
+}
+
+std::future<KeyRangeResult> AsyncKineticConnection::GetKeyRange(const string &start_key,
+        bool start_key_inclusive, const string &end_key, bool end_key_inclusive, bool reverse_results,
+        int32_t max_results) {
+    auto callback = make_shared<AsyncGetKeyRangeCallback>(completions_);
+    std::future<KeyRangeResult> future = callback->get_future();
+    connection_->GetKeyRange(start_key, start_key_inclusive, end_key, end_key_inclusive,
+        reverse_results, max_results, callback);
+    return future;
+}
+
+std::future<GetLogResult> AsyncKineticConnection::GetLog() {
+    auto callback = make_shared<AsyncGetLogCallback>(completions_);
+    std::future<GetLogResult> future = callback->get_future();
+    connection_->GetLog(callback);
+    return future;
+}
+
+std::future<GetLogResult> AsyncKineticConnection::GetLog(const vector<Command_GetLog_Type> &types) {
+    auto callback = make_shared<AsyncGetLogCallback>(completions_);
+    std::future<GetLogResult> future = callback->get_future();
+    connection_->GetLog(types, callback);
+    return future;
+}
+
+std::future<P2PPushResult> AsyncKineticConnection::P2PPush(const P2PPushRequest &push_request) {
+    auto callback = make_shared<AsyncP2PPushCallback>(completions_);
+    std::future<P2PPushResult> future = callback->get_future();
+    connection_->P2PPush(push_request, callback);
+    return future;
+}
+
+bool AsyncKineticConnection::RunUntil(const std::function<bool()> &done, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        // Running the connection sends what has been submitted and calls back
+        // for whatever has arrived, before there's any need to wait
+        IoInterest interest;
+        bool ok = connection_->Run(&interest);
+        if (done()) {
+            return true;
+        }
+        if (!ok) {
+            // Everything outstanding has failed by now, so only futures that
+            // aren't this connection's can still be waiting
+            return false;
+        }
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                return false;
+            }
+            wait_ms = static_cast<int>(remaining);
+        }
+        struct pollfd pfd;
+        pfd.fd = interest.fd;
+        pfd.events = (interest.read ? POLLIN : 0) | (interest.write ? POLLOUT : 0);
+        pfd.revents = 0;
+        if (poll(&pfd, 1, wait_ms) < 0 && errno != EINTR) {
+            PLOG(ERROR) << "Failed waiting on connection";
+            return false;
+        }
+    }
+}
+
+} // namespace kinetic
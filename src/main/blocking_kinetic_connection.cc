@@ -16,9 +16,14 @@
  */
 
 #include <memory>
-#include <sys/select.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
+#include "glog/logging.h"
 #include "kinetic/blocking_kinetic_connection.h"
 
 
@@ -32,11 +37,27 @@ using std::move;
 
 BlockingKineticConnection::BlockingKineticConnection( unique_ptr<NonblockingKineticConnection> nonblocking_connection,
         unsigned int network_timeout_seconds)
-    : network_timeout_seconds_(network_timeout_seconds) {
+    : network_timeout_seconds_(network_timeout_seconds), driving_(false), last_io_() {
     nonblocking_connection_ = std::move(nonblocking_connection);
+    if (pipe(wake_fds_) != 0) {
+        // Calls still work, but one submitted while another thread is
+        // waiting on the socket isn't sent until that wait ends
+        PLOG(WARNING) << "Failed to create wake pipe";
+        wake_fds_[0] = wake_fds_[1] = -1;
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(wake_fds_[i], F_SETFL, O_NONBLOCK);
+        fcntl(wake_fds_[i], F_SETFD, FD_CLOEXEC);
+    }
 }
 
-BlockingKineticConnection::~BlockingKineticConnection() {}
+BlockingKineticConnection::~BlockingKineticConnection() {
+    if (wake_fds_[0] != -1) {
+        close(wake_fds_[0]);
+        close(wake_fds_[1]);
+    }
+}
 
 class BlockingCallbackState {
     friend class BlockingKineticConnection;
@@ -173,6 +194,58 @@ KineticStatus BlockingKineticConnection::Get(const string& key, unique_ptr<Kinet
     return this->Get(make_shared<string>(key), record);
 }
 
+class BlockingGetIntoCallback : public GetIntoCallbackInterface, public BlockingCallbackState {
+    public:
+    explicit BlockingGetIntoCallback(size_t *value_size) : value_size_(value_size) {}
+
+    virtual void Success(const string &key, size_t value_size, const string &version,
+            const string &tag, Command_Algorithm algorithm) {
+        OnSuccess();
+
+        if (value_size_ != NULL) {
+            *value_size_ = value_size;
+        }
+    }
+
+    virtual void Failure(KineticStatus error) {
+        OnError(error);
+    }
+
+    private:
+    size_t *value_size_;
+};
+
+KineticStatus BlockingKineticConnection::GetInto(const shared_ptr<const string> key, char *buffer,
+    size_t capacity, size_t *value_size) {
+    auto handler = make_shared<BlockingGetIntoCallback>(value_size);
+    return RunOperation(handler, nonblocking_connection_->GetInto(key, buffer, capacity, handler));
+}
+
+KineticStatus BlockingKineticConnection::GetInto(const string& key, char *buffer, size_t capacity,
+    size_t *value_size) {
+    return this->GetInto(make_shared<string>(key), buffer, capacity, value_size);
+}
+
+KineticStatus BlockingKineticConnection::GetInto(const shared_ptr<const string> key, string *value) {
+    auto handler = make_shared<BlockingGetIntoCallback>(static_cast<size_t *>(NULL));
+    return RunOperation(handler, nonblocking_connection_->GetInto(key, value, handler));
+}
+
+KineticStatus BlockingKineticConnection::GetInto(const string& key, string *value) {
+    return this->GetInto(make_shared<string>(key), value);
+}
+
+KineticStatus BlockingKineticConnection::GetToFile(const shared_ptr<const string> key, int fd,
+    off_t offset, size_t *value_size) {
+    auto handler = make_shared<BlockingGetIntoCallback>(value_size);
+    return RunOperation(handler, nonblocking_connection_->GetToFile(key, fd, offset, handler));
+}
+
+KineticStatus BlockingKineticConnection::GetToFile(const string& key, int fd, off_t offset,
+    size_t *value_size) {
+    return this->GetToFile(make_shared<string>(key), fd, offset, value_size);
+}
+
 class BlockingPutCallback : public PutCallbackInterface, public BlockingCallbackState {
     public:
     virtual void Success() {
@@ -463,36 +536,88 @@ KineticStatus BlockingKineticConnection::P2PPush(
 KineticStatus BlockingKineticConnection::RunOperation(
         shared_ptr<BlockingCallbackState> callback,
         HandlerKey handler_key) {
-    fd_set read_fds, write_fds;
-    int nfds;
-
-    if (!nonblocking_connection_->Run(&read_fds, &write_fds, &nfds)) {
-        nonblocking_connection_->RemoveHandler(handler_key);
-        return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Connection failed");
-    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool woken = false;
+    // A call times out once the socket has been quiet for the network timeout
+    // since the call started. Wakeups for other calls don't count as hearing
+    // from the drive, or a steady stream of them would keep every call
+    // waiting forever on a drive that has gone silent.
+    const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    auto deadline = [this, started]() {
+        return std::max(started, last_io_) + std::chrono::seconds(network_timeout_seconds_);
+    };
 
     while (!(callback->done_)) {
-        struct timeval tv;
-        tv.tv_sec = network_timeout_seconds_;
-        tv.tv_usec = 0;
+        if (driving_) {
+            // Another call is driving I/O. Make sure it notices our request,
+            // then wait for it to run the connection.
+            if (!woken) {
+                Wake();
+                woken = true;
+            }
+            if (progress_.wait_until(lock, deadline()) == std::cv_status::timeout && driving_ &&
+                    !callback->done_ && std::chrono::steady_clock::now() >= deadline()) {
+                // The driving thread went all that time without hearing from the drive
+                nonblocking_connection_->RemoveHandler(handler_key);
+                return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Network timeout");
+            }
+            continue;
+        }
 
-        int number_ready_fds = select(nfds, &read_fds, &write_fds, NULL, &tv);
-        if (number_ready_fds < 0) {
-            // select() returned an error
-            nonblocking_connection_->RemoveHandler(handler_key);
-            return KineticStatus(StatusCode::CLIENT_IO_ERROR, strerror(errno));
-        } else if (number_ready_fds == 0) {
-            // select() returned before any sockets were ready meaning the connection timed out
+        driving_ = true;
+        // poll rather than select so that descriptors above FD_SETSIZE work
+        IoInterest interest;
+        bool ok = nonblocking_connection_->Run(&interest);
+        // Callbacks for other threads' calls may have run
+        progress_.notify_all();
+        if (!ok) {
+            driving_ = false;
             nonblocking_connection_->RemoveHandler(handler_key);
-            return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Network timeout");
+            return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Connection failed");
+        }
+        if (callback->done_) {
+            driving_ = false;
+            break;
+        }
+
+        struct pollfd pfds[2];
+        pfds[0].fd = interest.fd;
+        pfds[0].events = (interest.read ? POLLIN : 0) | (interest.write ? POLLOUT : 0);
+        pfds[0].revents = 0;
+        pfds[1].fd = wake_fds_[0];
+        pfds[1].events = POLLIN;
+        pfds[1].revents = 0;
+        int64_t timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline() - std::chrono::steady_clock::now()).count();
+
+        lock.unlock();
+        int number_ready_fds = timeout_ms <= 0 ? 0 :
+            poll(pfds, wake_fds_[0] == -1 ? 1 : 2, static_cast<int>(timeout_ms));
+        int poll_errno = errno;
+        if (pfds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(wake_fds_[0], buf, sizeof(buf)) > 0) {}
+        }
+        lock.lock();
+        driving_ = false;
+        if (pfds[0].revents != 0) {
+            last_io_ = std::chrono::steady_clock::now();
         }
 
-        // At least one FD was ready meaning that the connection is ready
-        // to make some progress
-        if (!nonblocking_connection_->Run(&read_fds, &write_fds, &nfds)) {
+        if (number_ready_fds < 0) {
+            // poll() returned an error
+            progress_.notify_all();
             nonblocking_connection_->RemoveHandler(handler_key);
-            return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Connection failed");
+            return KineticStatus(StatusCode::CLIENT_IO_ERROR, strerror(poll_errno));
+        } else if (pfds[0].revents == 0 && std::chrono::steady_clock::now() >= deadline()) {
+            // The socket hasn't been ready since before the deadline, meaning
+            // the connection timed out
+            progress_.notify_all();
+            nonblocking_connection_->RemoveHandler(handler_key);
+            return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Network timeout");
         }
+        // The socket was ready, or there's a new request to send, so go
+        // round again to run the connection
     }
 
     // done was set, meaning handler was invoked and therefore removed internally
@@ -504,4 +629,13 @@ KineticStatus BlockingKineticConnection::RunOperation(
     }
 }
 
+void BlockingKineticConnection::Wake() {
+    if (wake_fds_[1] != -1) {
+        // If the pipe is full a wakeup is already pending
+        char c = 0;
+        ssize_t ignored = write(wake_fds_[1], &c, 1);
+        (void) ignored;
+    }
+}
+
 } // namespace kinetic
@@ -28,20 +28,45 @@ namespace kinetic {
 
 using com::seagate::kinetic::client::proto::Message;
 
-HmacProvider::HmacProvider() {}
+HmacProvider::HmacProvider() : key_(), key_context_(NULL) {}
+
+HmacProvider::HmacProvider(const std::string& key) : key_(key), key_context_(NULL) {
+    HMAC_CTX *context = new HMAC_CTX;
+    HMAC_CTX_init(context);
+    HMAC_Init_ex(context, key.c_str(), key.length(), EVP_sha1(), NULL);
+    key_context_ = context;
+}
+
+HmacProvider::~HmacProvider() {
+    if (key_context_ != NULL) {
+        HMAC_CTX *context = key_context_;
+        HMAC_CTX_cleanup(context);
+        delete context;
+    }
+}
+
+std::shared_ptr<HmacProviderInterface> HmacProvider::ForKey(const std::string& key) const {
+    return std::shared_ptr<HmacProviderInterface>(new HmacProvider(key));
+}
 
 std::string HmacProvider::ComputeHmac(const Message& message,
         const std::string& key) const {
+    return ComputeCommandHmac(message.commandbytes().data(), message.commandbytes().length(), key);
+}
+
+std::string HmacProvider::ComputeCommandHmac(const char *command_bytes, size_t length,
+        const std::string& key) const {
     HMAC_CTX ctx;
     HMAC_CTX_init(&ctx);
-    HMAC_Init_ex(&ctx, key.c_str(), key.length(), EVP_sha1(), NULL);
+    if (key_context_ == NULL || key != key_ || !HMAC_CTX_copy(&ctx, key_context_)) {
+        HMAC_Init_ex(&ctx, key.c_str(), key.length(), EVP_sha1(), NULL);
+    }
 
-    if (message.commandbytes().length() != 0) {
-        uint32_t message_length_bigendian = htonl(message.commandbytes().length());
+    if (length != 0) {
+        uint32_t message_length_bigendian = htonl(length);
         HMAC_Update(&ctx, reinterpret_cast<unsigned char *>(&message_length_bigendian),
             sizeof(uint32_t));
-        HMAC_Update(&ctx, reinterpret_cast<const unsigned char *>(message.commandbytes().c_str()),
-            message.commandbytes().length());
+        HMAC_Update(&ctx, reinterpret_cast<const unsigned char *>(command_bytes), length);
     }
 
     unsigned char result[SHA_DIGEST_LENGTH];
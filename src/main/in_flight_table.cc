@@ -0,0 +1,213 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "in_flight_table.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+using std::move;
+
+const size_t InFlightTable::kDefaultCapacity;
+
+// Rounds up to a power of two
+static size_t SlotsFor(size_t count) {
+    size_t slots = 1;
+    while (slots < count) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+InFlightTable::InFlightTable(size_t capacity) : by_sequence_(), by_key_(), overflow_(), overflow_keys_(),
+    mask_(0), size_(0) {
+    size_t slots = SlotsFor(std::max<size_t>(capacity, 1));
+    by_sequence_.resize(slots);
+    by_key_.resize(slots);
+    mask_ = slots - 1;
+}
+
+bool InFlightTable::Insert(int64_t sequence, HandlerKey key, shared_ptr<HandlerInterface> handler) {
+    CHECK(handler);
+    if (FindSequence(sequence) != NULL || FindKey(key) != NULL ||
+            (!overflow_.empty() && (overflow_.count(sequence) != 0 || overflow_keys_.count(key) != 0))) {
+        return false;
+    }
+    if (!Fits(sequence, key) && (size_ + 1) * 2 > capacity()) {
+        Resize(capacity() * 2);
+    }
+    Place(sequence, key, move(handler));
+    size_++;
+    return true;
+}
+
+HandlerInterface *InFlightTable::Find(int64_t sequence, HandlerKey *key) const {
+    const SequenceSlot &slot = by_sequence_[sequence & mask_];
+    if (slot.handler && slot.sequence == sequence) {
+        *key = slot.key;
+        return slot.handler.get();
+    }
+    if (!overflow_.empty()) {
+        auto it = overflow_.find(sequence);
+        if (it != overflow_.end()) {
+            *key = it->second.key;
+            return it->second.handler.get();
+        }
+    }
+    return NULL;
+}
+
+shared_ptr<HandlerInterface> InFlightTable::Take(int64_t sequence) {
+    SequenceSlot *slot = FindSequence(sequence);
+    if (slot == NULL) {
+        auto it = overflow_.find(sequence);
+        if (it == overflow_.end()) {
+            return shared_ptr<HandlerInterface>();
+        }
+        shared_ptr<HandlerInterface> handler = move(it->second.handler);
+        overflow_keys_.erase(it->second.key);
+        overflow_.erase(it);
+        size_--;
+        return handler;
+    }
+    KeySlot *key_slot = FindKey(slot->key);
+    CHECK(key_slot != NULL) << "No key slot for handler key " << slot->key;
+    key_slot->used = false;
+    size_--;
+    return move(slot->handler);
+}
+
+bool InFlightTable::Remove(HandlerKey key) {
+    KeySlot *key_slot = FindKey(key);
+    if (key_slot == NULL) {
+        auto it = overflow_keys_.find(key);
+        if (it == overflow_keys_.end()) {
+            return false;
+        }
+        overflow_.erase(it->second);
+        overflow_keys_.erase(it);
+        size_--;
+        return true;
+    }
+    SequenceSlot *slot = FindSequence(key_slot->sequence);
+    CHECK(slot != NULL) << "Handler key " << key << " mapped to seq " << key_slot->sequence
+        << " but no handler entry for that seq";
+    key_slot->used = false;
+    slot->handler.reset();
+    size_--;
+    return true;
+}
+
+vector<shared_ptr<HandlerInterface>> InFlightTable::TakeAll() {
+    vector<SequenceSlot *> taken;
+    for (auto it = by_sequence_.begin(); it != by_sequence_.end(); ++it) {
+        if (it->handler) {
+            taken.push_back(&*it);
+        }
+    }
+    for (auto it = overflow_.begin(); it != overflow_.end(); ++it) {
+        taken.push_back(&it->second);
+    }
+    std::sort(taken.begin(), taken.end(), [](const SequenceSlot *a, const SequenceSlot *b) {
+        return a->sequence < b->sequence;
+    });
+
+    vector<shared_ptr<HandlerInterface>> handlers;
+    handlers.reserve(taken.size());
+    for (auto it = taken.begin(); it != taken.end(); ++it) {
+        handlers.push_back(move((*it)->handler));
+    }
+    for (auto it = by_key_.begin(); it != by_key_.end(); ++it) {
+        it->used = false;
+    }
+    overflow_.clear();
+    overflow_keys_.clear();
+    size_ = 0;
+    return handlers;
+}
+
+void InFlightTable::Reserve(size_t count) {
+    size_t slots = SlotsFor(count);
+    if (slots > capacity()) {
+        Resize(slots);
+    }
+}
+
+// These only look in the rings
+InFlightTable::SequenceSlot *InFlightTable::FindSequence(int64_t sequence) {
+    SequenceSlot &slot = by_sequence_[sequence & mask_];
+    return slot.handler && slot.sequence == sequence ? &slot : NULL;
+}
+
+InFlightTable::KeySlot *InFlightTable::FindKey(HandlerKey key) {
+    KeySlot &slot = by_key_[key & mask_];
+    return slot.used && slot.key == key ? &slot : NULL;
+}
+
+bool InFlightTable::Fits(int64_t sequence, HandlerKey key) const {
+    return !by_sequence_[sequence & mask_].handler && !by_key_[key & mask_].used;
+}
+
+// Puts a request in its slots if they're both free, and in the overflow map
+// otherwise. Doesn't count it.
+void InFlightTable::Place(int64_t sequence, HandlerKey key, shared_ptr<HandlerInterface> handler) {
+    if (!Fits(sequence, key)) {
+        SequenceSlot &slot = overflow_[sequence];
+        slot.sequence = sequence;
+        slot.key = key;
+        slot.handler = move(handler);
+        overflow_keys_[key] = sequence;
+        return;
+    }
+    SequenceSlot &slot = by_sequence_[sequence & mask_];
+    slot.sequence = sequence;
+    slot.key = key;
+    slot.handler = move(handler);
+    KeySlot &key_slot = by_key_[key & mask_];
+    key_slot.key = key;
+    key_slot.sequence = sequence;
+    key_slot.used = true;
+}
+
+// Moves everything into rings of the given size. Overflowed requests get
+// another chance at a slot of their own.
+void InFlightTable::Resize(size_t capacity) {
+    vector<SequenceSlot> old;
+    old.swap(by_sequence_);
+    std::map<int64_t, SequenceSlot> old_overflow;
+    old_overflow.swap(overflow_);
+    overflow_keys_.clear();
+    by_sequence_.assign(capacity, SequenceSlot());
+    by_key_.assign(capacity, KeySlot());
+    mask_ = capacity - 1;
+    for (auto it = old.begin(); it != old.end(); ++it) {
+        if (it->handler) {
+            Place(it->sequence, it->key, move(it->handler));
+        }
+    }
+    for (auto it = old_overflow.begin(); it != old_overflow.end(); ++it) {
+        Place(it->second.sequence, it->second.key, move(it->second.handler));
+    }
+}
+
+} // namespace kinetic
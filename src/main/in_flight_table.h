@@ -0,0 +1,113 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_IN_FLIGHT_TABLE_H_
+#define KINETIC_CPP_CLIENT_IN_FLIGHT_TABLE_H_
+
+#include <cstdint>
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "kinetic/common.h"
+#include "kinetic/nonblocking_packet_service_interface.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::vector;
+
+// The handlers of requests awaiting a response, found by the request's
+// sequence number or by its handler key. Both go up by one with each request
+// on a connection, so rather than hashing, each is looked up in a ring of
+// power-of-two size at its low bits. A slot remembers the full number it
+// holds, so a stale lookup for a request that's been answered or removed
+// finds nothing even once the slot has been reused.
+//
+// As long as no more requests are outstanding than there are slots, every
+// request gets a slot of its own and nothing is allocated per request. A
+// request landing on a slot that's still taken makes the table double in
+// size, but only while at least half the slots are in use. Otherwise the slot
+// is held by a straggler well behind the rest, and growing to cover the span
+// between them would let one stuck request grow the table without bound, so
+// the newcomer goes into a small overflow map instead.
+class InFlightTable {
+    public:
+    explicit InFlightTable(size_t capacity = kDefaultCapacity);
+
+    // Returns false, changing nothing, if sequence or key is already in use
+    bool Insert(int64_t sequence, HandlerKey key, shared_ptr<HandlerInterface> handler);
+    // The handler waiting on sequence, or NULL. Sets key to its handler key.
+    HandlerInterface *Find(int64_t sequence, HandlerKey *key) const;
+    // Removes and returns the handler waiting on sequence, or NULL
+    shared_ptr<HandlerInterface> Take(int64_t sequence);
+    // Removes the handler with key. Returns false if there isn't one.
+    bool Remove(HandlerKey key);
+    // Removes every handler, in sequence order
+    vector<shared_ptr<HandlerInterface>> TakeAll();
+    // Makes room for at least count requests without having to grow
+    void Reserve(size_t count);
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return by_sequence_.size(); }
+    // How many requests are in the overflow map
+    size_t overflowed() const { return overflow_.size(); }
+
+    static const size_t kDefaultCapacity = 64;
+
+    private:
+    struct SequenceSlot {
+        SequenceSlot() : sequence(0), key(0), handler() {}
+        int64_t sequence;
+        HandlerKey key;
+        // NULL if the slot is free
+        shared_ptr<HandlerInterface> handler;
+    };
+
+    struct KeySlot {
+        KeySlot() : key(0), sequence(0), used(false) {}
+        HandlerKey key;
+        int64_t sequence;
+        bool used;
+    };
+
+    SequenceSlot *FindSequence(int64_t sequence);
+    KeySlot *FindKey(HandlerKey key);
+    bool Fits(int64_t sequence, HandlerKey key) const;
+    void Place(int64_t sequence, HandlerKey key, shared_ptr<HandlerInterface> handler);
+    void Resize(size_t capacity);
+
+    vector<SequenceSlot> by_sequence_;
+    vector<KeySlot> by_key_;
+    // Requests whose slots were taken when they arrived, by sequence, with
+    // their sequences by key
+    std::map<int64_t, SequenceSlot> overflow_;
+    std::unordered_map<HandlerKey, int64_t> overflow_keys_;
+    // One less than the number of slots in each ring
+    size_t mask_;
+    // Requests in the rings and in the overflow map
+    size_t size_;
+    DISALLOW_COPY_AND_ASSIGN(InFlightTable);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_IN_FLIGHT_TABLE_H_
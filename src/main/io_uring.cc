@@ -0,0 +1,324 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "io_uring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef KINETIC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+IoUring::IoUring() : ring_fd_(-1), features_(0), sq_ring_(NULL), sq_ring_size_(0),
+    cq_ring_(NULL), cq_ring_size_(0), sqes_(NULL), sqes_size_(0), sq_head_(NULL),
+    sq_tail_(NULL), sq_mask_(0), sq_array_(NULL), cq_head_(NULL), cq_tail_(NULL),
+    cq_mask_(0), cqes_(NULL), to_submit_(0) {}
+
+#ifdef KINETIC_HAVE_IO_URING
+
+IoUring::~IoUring() {
+    if (sqes_ != NULL) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != NULL && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != NULL) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+    }
+}
+
+bool IoUring::Init(unsigned int entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+    ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd_ < 0) {
+        return false;
+    }
+    features_ = params.features;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = NULL;
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = NULL;
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = NULL;
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ring_);
+    sq_head_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+}
+
+bool IoUring::RegisterBufferSlots(unsigned int count) {
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = count;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    return syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0;
+}
+
+bool IoUring::SetBuffer(unsigned int index, void *base, size_t length) {
+    struct iovec iov;
+    iov.iov_base = base;
+    iov.iov_len = base == NULL ? 0 : length;
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uint64_t>(&iov);
+    update.nr = 1;
+    // Returns the number of slots updated
+    return syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS_UPDATE,
+        &update, sizeof(update)) == 1;
+}
+
+struct io_uring_sqe *IoUring::GetSqe() {
+    uint32_t tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) > sq_mask_) {
+        // Full, so hand what's queued to the kernel to make room
+        if (!Submit(0, 0)) {
+            return NULL;
+        }
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) > sq_mask_) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes_) + (tail & sq_mask_);
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[tail & sq_mask_] = tail & sq_mask_;
+    // The kernel only looks at the entry once the tail moves past it
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+    return sqe;
+}
+
+bool IoUring::PrepareRead(int fd, char *buf, size_t length, int buffer_index, uint64_t user_data) {
+    struct io_uring_sqe *sqe = GetSqe();
+    if (sqe == NULL) {
+        return false;
+    }
+    if (buffer_index >= 0) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = buffer_index;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = length;
+    // Sockets can't seek, and reads from them must be at offset 0
+    sqe->off = 0;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::PrepareSendmsg(int fd, const struct msghdr *msg, uint64_t user_data) {
+    struct io_uring_sqe *sqe = GetSqe();
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::PrepareCancel(uint64_t target_user_data, uint64_t user_data) {
+    struct io_uring_sqe *sqe = GetSqe();
+    if (sqe == NULL) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target_user_data;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::Enter(bool wait, int timeout_ms) {
+    if (wait && *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        // Already something to reap
+        wait = false;
+    }
+    if (!wait || timeout_ms == 0) {
+        return to_submit_ == 0 || Submit(0, 0);
+    }
+    if (timeout_ms < 0 || (features_ & IORING_FEAT_EXT_ARG)) {
+        return Submit(1, timeout_ms);
+    }
+
+    // Older kernels can't take a timeout, so submit and then poll the ring,
+    // which becomes readable once there are completions
+    if (to_submit_ > 0 && !Submit(0, 0)) {
+        return false;
+    }
+    struct pollfd pfd;
+    pfd.fd = ring_fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, timeout_ms) >= 0 || errno == EINTR;
+}
+
+bool IoUring::Submit(unsigned int wait_for, int timeout_ms) {
+    unsigned int flags = wait_for > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void *argp = NULL;
+    size_t argsz = 0;
+    if (wait_for > 0 && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    while (true) {
+        int result = syscall(__NR_io_uring_enter, ring_fd_, to_submit_, wait_for, flags, argp, argsz);
+        if (result >= 0) {
+            to_submit_ -= std::min<uint32_t>(result, to_submit_);
+            if (to_submit_ == 0 || wait_for > 0 || result == 0) {
+                return true;
+            }
+            continue;
+        }
+        // Timing out or being interrupted while waiting isn't an error, and
+        // with EAGAIN or EBUSY completions need reaping before the kernel
+        // will take more. Anything not submitted goes with the next call.
+        return errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY;
+    }
+}
+
+int IoUring::Reap(Completion *completions, int max) {
+    uint32_t head = *cq_head_;
+    uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    int count = 0;
+    const struct io_uring_cqe *cqes = static_cast<const struct io_uring_cqe *>(cqes_);
+    while (head != tail && count < max) {
+        const struct io_uring_cqe &cqe = cqes[head & cq_mask_];
+        completions[count].user_data = cqe.user_data;
+        completions[count].result = cqe.res;
+        count++;
+        head++;
+    }
+    // Hand the entries back to the kernel
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+#else
+
+IoUring::~IoUring() {}
+
+bool IoUring::Init(unsigned int entries) {
+    errno = ENOSYS;
+    return false;
+}
+
+bool IoUring::RegisterBufferSlots(unsigned int count) {
+    return false;
+}
+
+bool IoUring::SetBuffer(unsigned int index, void *base, size_t length) {
+    return false;
+}
+
+struct io_uring_sqe *IoUring::GetSqe() {
+    return NULL;
+}
+
+bool IoUring::PrepareRead(int fd, char *buf, size_t length, int buffer_index, uint64_t user_data) {
+    return false;
+}
+
+bool IoUring::PrepareSendmsg(int fd, const struct msghdr *msg, uint64_t user_data) {
+    return false;
+}
+
+bool IoUring::PrepareCancel(uint64_t target_user_data, uint64_t user_data) {
+    return false;
+}
+
+bool IoUring::Enter(bool wait, int timeout_ms) {
+    errno = ENOSYS;
+    return false;
+}
+
+bool IoUring::Submit(unsigned int wait_for, int timeout_ms) {
+    return false;
+}
+
+int IoUring::Reap(Completion *completions, int max) {
+    return 0;
+}
+
+#endif  // KINETIC_HAVE_IO_URING
+
+} // namespace kinetic
@@ -0,0 +1,103 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_IO_URING_H_
+#define KINETIC_CPP_CLIENT_IO_URING_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "kinetic/common.h"
+
+struct io_uring_sqe;
+
+namespace kinetic {
+
+// A minimal io_uring instance driven with the raw system calls, covering just
+// what the packet service needs: socket reads into registered buffers, vectored
+// sends and cancellation. Everything that touches the kernel's structures lives
+// in io_uring.cc, so nothing else needs linux/io_uring.h. Built without
+// KINETIC_HAVE_IO_URING, Init always fails with ENOSYS.
+class IoUring {
+    public:
+    struct Completion {
+        uint64_t user_data;
+        // Bytes transferred, or a negated errno
+        int32_t result;
+    };
+
+    IoUring();
+    ~IoUring();
+
+    // Sets up a ring with room for entries submissions. Returns false with
+    // errno set if io_uring isn't available.
+    bool Init(unsigned int entries);
+    int fd() const { return ring_fd_; }
+
+    // Registers a table of count empty buffer slots, filled in with
+    // SetBuffer. Returns false if the kernel doesn't support sparse tables.
+    bool RegisterBufferSlots(unsigned int count);
+    // Points slot index at length bytes at base, or empties it if base is
+    // NULL. The memory stays pinned until the slot is emptied.
+    bool SetBuffer(unsigned int index, void *base, size_t length);
+
+    // Each of these queues one submission, flushing the queue to the kernel
+    // first if it's full. A buffer_index of -1 reads with an ordinary recv
+    // rather than into a registered buffer.
+    bool PrepareRead(int fd, char *buf, size_t length, int buffer_index, uint64_t user_data);
+    bool PrepareSendmsg(int fd, const struct msghdr *msg, uint64_t user_data);
+    bool PrepareCancel(uint64_t target_user_data, uint64_t user_data);
+
+    // Submits everything queued and, if wait is set and no completions are
+    // waiting, waits up to timeout_ms milliseconds (-1 for ever) for one.
+    // Where the kernel can take a timeout this is a single system call.
+    // Returns false with errno set on failure; timing out isn't a failure.
+    bool Enter(bool wait, int timeout_ms);
+
+    // Copies up to max completions into completions and returns how many
+    int Reap(Completion *completions, int max);
+
+    private:
+    struct io_uring_sqe *GetSqe();
+    bool Submit(unsigned int wait_for, int timeout_ms);
+
+    int ring_fd_;
+    uint32_t features_;
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    void *sqes_;
+    size_t sqes_size_;
+    uint32_t *sq_head_;
+    uint32_t *sq_tail_;
+    uint32_t sq_mask_;
+    uint32_t *sq_array_;
+    uint32_t *cq_head_;
+    uint32_t *cq_tail_;
+    uint32_t cq_mask_;
+    void *cqes_;
+    // Submissions written to the queue but not yet handed to the kernel
+    uint32_t to_submit_;
+    DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_IO_URING_H_
@@ -0,0 +1,216 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "io_uring_channel.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+using std::move;
+
+const uint64_t IoUringChannel::kOperationMask;
+const size_t IoUringChannel::kReceiveBufferSize;
+const int IoUringChannel::kMaxSendIovecs;
+
+IoUringChannel::IoUringChannel(IoUring *ring, int fd) : ring_(ring), fd_(fd), buffer_slot_(-1),
+    receive_buffer_(kReceiveBufferSize), receive_start_(0), receive_end_(0),
+    receive_in_flight_(false), send_in_flight_(false), has_send_result_(false), send_result_(0),
+    closed_(false), ready_(false) {
+    memset(&send_msg_, 0, sizeof(send_msg_));
+    send_msg_.msg_iov = send_iov_;
+}
+
+ssize_t IoUringChannel::Take(char *buf, size_t length) {
+    if (receive_start_ == receive_end_) {
+        if (closed_) {
+            return -1;
+        }
+        if (!receive_in_flight_ && !ArmReceive()) {
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t taken = std::min(length, receive_end_ - receive_start_);
+    memcpy(buf, &receive_buffer_[receive_start_], taken);
+    receive_start_ += taken;
+    // Start on the next receive right away so it can complete while the
+    // reader works through what it has
+    if (receive_start_ == receive_end_ && !closed_ && !receive_in_flight_ && !ArmReceive()) {
+        closed_ = true;
+    }
+    return taken;
+}
+
+bool IoUringChannel::empty() const {
+    return receive_start_ == receive_end_;
+}
+
+bool IoUringChannel::ArmReceive() {
+    receive_start_ = receive_end_ = 0;
+    if (!ring_->PrepareRead(fd_, &receive_buffer_[0], receive_buffer_.size(), buffer_slot_,
+            user_data(kReceive))) {
+        PLOG(WARNING) << "Failed to queue receive";
+        return false;
+    }
+    receive_in_flight_ = true;
+    return true;
+}
+
+bool IoUringChannel::QueueSend(const struct iovec *iov, int iovcnt) {
+    CHECK(!send_in_flight_);
+    CHECK_LE(iovcnt, kMaxSendIovecs);
+    if (closed_) {
+        return false;
+    }
+    std::copy(iov, iov + iovcnt, send_iov_);
+    send_msg_.msg_iovlen = iovcnt;
+    if (!ring_->PrepareSendmsg(fd_, &send_msg_, user_data(kSend))) {
+        PLOG(WARNING) << "Failed to queue send";
+        return false;
+    }
+    send_in_flight_ = true;
+    return true;
+}
+
+bool IoUringChannel::TakeSendResult(int *result) {
+    if (!has_send_result_) {
+        return false;
+    }
+    has_send_result_ = false;
+    *result = send_result_;
+    return true;
+}
+
+void IoUringChannel::Complete(Operation operation, int32_t result) {
+    if (operation == kSend) {
+        send_in_flight_ = false;
+        has_send_result_ = true;
+        send_result_ = result;
+        return;
+    }
+
+    receive_in_flight_ = false;
+    if (result > 0) {
+        receive_start_ = 0;
+        receive_end_ = result;
+    } else if (result == -EAGAIN && buffer_slot_ >= 0) {
+        // Fixed-buffer reads don't wait on nonblocking sockets, so fall back
+        // to recv, which does. The next Take queues it.
+        buffer_slot_ = -1;
+    } else if (result != -EINTR) {
+        if (result < 0) {
+            errno = -result;
+            PLOG(WARNING) << "Receive failed";
+        }
+        closed_ = true;
+    }
+}
+
+bool IoUringChannel::Cancel() {
+    bool queued = true;
+    if (receive_in_flight_) {
+        queued = ring_->PrepareCancel(user_data(kReceive), user_data(kCancel)) && queued;
+    }
+    if (send_in_flight_) {
+        queued = ring_->PrepareCancel(user_data(kSend), user_data(kCancel)) && queued;
+    }
+    return queued;
+}
+
+void IoUringChannel::Close() {
+    closed_ = true;
+    receive_start_ = receive_end_ = 0;
+}
+
+IoUringPacketWriter::IoUringPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
+    unique_ptr<string> packet, const PacketValue& value, shared_ptr<IoUringChannel> channel)
+    : NonblockingPacketWriter(socket_wrapper, move(packet), value), channel_(channel),
+    sending_file_chunk_(false) {}
+
+NonblockingStringStatus IoUringPacketWriter::Write() {
+    if (header_and_message_.empty()) {
+        return kFailed;
+    }
+    if (channel_->send_in_flight()) {
+        return kInProgress;
+    }
+
+    int result;
+    if (channel_->TakeSendResult(&result)) {
+        if (result <= 0 && result != -EINTR && result != -EAGAIN) {
+            if (result < 0) {
+                errno = -result;
+                PLOG(WARNING) << "Send failed";
+            }
+            return kFailed;
+        }
+        if (result > 0) {
+            bytes_written_ += result;
+            if (sending_file_chunk_) {
+                file_chunk_start_ += result;
+            }
+        }
+    }
+
+    size_t header_size = header_and_message_.size();
+    if (bytes_written_ == header_size + value_.size()) {
+        return kDone;
+    }
+
+    struct iovec iov[kMaxIovecs];
+    int iovcnt = 0;
+    sending_file_chunk_ = false;
+    if (bytes_written_ < header_size) {
+        iov[iovcnt].iov_base = &header_and_message_[bytes_written_];
+        iov[iovcnt].iov_len = header_size - bytes_written_;
+        iovcnt++;
+    }
+    size_t value_offset = bytes_written_ > header_size ? bytes_written_ - header_size : 0;
+    if (!value_.is_file()) {
+        iovcnt += ValueIovecs(value_offset, iov + iovcnt, kMaxIovecs - iovcnt);
+    } else if (iovcnt == 0) {
+        // File chunks go out on their own so it's clear how much of the
+        // chunk each send took
+        if (!FillFileChunk()) {
+            return kFailed;
+        }
+        iov[0].iov_base = file_chunk_.data() + file_chunk_start_;
+        iov[0].iov_len = file_chunk_end_ - file_chunk_start_;
+        iovcnt = 1;
+        sending_file_chunk_ = true;
+    }
+
+    return channel_->QueueSend(iov, iovcnt) ? kInProgress : kFailed;
+}
+
+unique_ptr<NonblockingPacketWriterInterface> IoUringPacketWriterFactory::CreateWriter(
+    shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<string> packet,
+    const PacketValue& value) {
+    return unique_ptr<NonblockingPacketWriterInterface>(
+        new IoUringPacketWriter(socket_wrapper, move(packet), value, channel_));
+}
+
+} // namespace kinetic
@@ -0,0 +1,154 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_IO_URING_CHANNEL_H_
+#define KINETIC_CPP_CLIENT_IO_URING_CHANNEL_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <memory>
+#include <vector>
+
+#include "kinetic/common.h"
+#include "kinetic/io_uring_loop.h"
+
+#include "io_uring.h"
+#include "nonblocking_packet.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::vector;
+
+// One connection's I/O through an IoUringLoop. The channel is the packet
+// source its receiver reads from, and IoUringPacketWriter queues its sends
+// here. At most one receive and one send are in flight at a time, which
+// matches how the reader and sender work anyway.
+//
+// Completions are tagged with the channel's address, with the kind of
+// operation in the low bits. The loop makes sure nothing is in flight before
+// it lets go of a channel.
+class IoUringChannel : public PacketSourceInterface {
+    public:
+    enum Operation {
+        kReceive = 1,
+        kSend = 2,
+        kCancel = 3
+    };
+    static const uint64_t kOperationMask = 3;
+    static const size_t kReceiveBufferSize = 64 * 1024;
+    static const int kMaxSendIovecs = 64;
+
+    IoUringChannel(IoUring *ring, int fd);
+
+    ssize_t Take(char *buf, size_t length);
+    bool empty() const;
+
+    // Queues a send of the given iovecs, which are copied. The memory they
+    // point to must stay put until the send completes. Returns false if the
+    // channel is closed or the send couldn't be queued.
+    bool QueueSend(const struct iovec *iov, int iovcnt);
+    bool send_in_flight() const { return send_in_flight_; }
+    // Sets result to what the last send returned, if it's completed since
+    // the last call
+    bool TakeSendResult(int *result);
+
+    // Used by the loop
+    uint64_t user_data(Operation operation) const {
+        return reinterpret_cast<uint64_t>(this) | operation;
+    }
+    static IoUringChannel *FromUserData(uint64_t user_data, Operation *operation) {
+        *operation = static_cast<Operation>(user_data & kOperationMask);
+        return reinterpret_cast<IoUringChannel *>(user_data & ~kOperationMask);
+    }
+    void Complete(Operation operation, int32_t result);
+    bool busy() const { return receive_in_flight_ || send_in_flight_; }
+    bool Cancel();
+    // Fails the channel for good once the loop is done with it
+    void Close();
+    char *receive_buffer() { return &receive_buffer_[0]; }
+    void set_buffer_slot(int slot) { buffer_slot_ = slot; }
+    int buffer_slot() const { return buffer_slot_; }
+    bool ready() const { return ready_; }
+    void set_ready(bool ready) { ready_ = ready; }
+
+    private:
+    bool ArmReceive();
+
+    IoUring *ring_;
+    int fd_;
+    // Registered buffer slot holding receive_buffer_, or -1 to use recv
+    int buffer_slot_;
+    vector<char> receive_buffer_;
+    size_t receive_start_;
+    size_t receive_end_;
+    bool receive_in_flight_;
+    bool send_in_flight_;
+    bool has_send_result_;
+    int send_result_;
+    // Set on end of file, a failed receive or once the loop lets go
+    bool closed_;
+    // Set while the channel is on the loop's list of channels to run
+    bool ready_;
+    struct iovec send_iov_[kMaxSendIovecs];
+    struct msghdr send_msg_;
+    DISALLOW_COPY_AND_ASSIGN(IoUringChannel);
+};
+
+// Writes a packet by queueing sends on an IoUringChannel. Each call to Write
+// either queues the next part of the packet or, while a send is in flight,
+// returns kInProgress straight away. File values are read into memory a chunk
+// at a time, since the ring has no sendfile.
+//
+// Sends go out with SENDMSG from the packet's and value's own memory, not
+// from registered buffers. Values belong to the caller, so registering them
+// would take an io_uring_register call apiece, which is the system call the
+// ring is there to save. Copying them into a registered buffer instead adds a
+// copy in user space to the one the kernel makes anyway, and the operations
+// that send from registered buffers don't fit: WRITE_FIXED can't take
+// MSG_NOSIGNAL, so a reset connection would raise SIGPIPE, and SEND_ZC holds
+// the buffer until the drive acknowledges the data.
+class IoUringPacketWriter : public NonblockingPacketWriter {
+    public:
+    IoUringPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<string> packet,
+        const PacketValue& value, shared_ptr<IoUringChannel> channel);
+    NonblockingStringStatus Write();
+
+    private:
+    shared_ptr<IoUringChannel> channel_;
+    // Set while the send in flight is from the file chunk
+    bool sending_file_chunk_;
+    DISALLOW_COPY_AND_ASSIGN(IoUringPacketWriter);
+};
+
+class IoUringPacketWriterFactory : public NonblockingPacketWriterFactoryInterface {
+    public:
+    explicit IoUringPacketWriterFactory(shared_ptr<IoUringChannel> channel) : channel_(channel) {}
+    unique_ptr<NonblockingPacketWriterInterface> CreateWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
+        unique_ptr<string> packet, const PacketValue& value);
+
+    private:
+    shared_ptr<IoUringChannel> channel_;
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_IO_URING_CHANNEL_H_
@@ -0,0 +1,240 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "kinetic/io_uring_loop.h"
+
+#include <errno.h>
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+#include "io_uring.h"
+#include "io_uring_channel.h"
+
+namespace kinetic {
+
+using std::make_shared;
+
+// Most completions copied out of the ring at a time
+static const int kMaxCompletions = 64;
+
+IoUringLoop::IoUringLoop(unsigned int entries) : ring_(new IoUring()), available_(false),
+    free_buffer_slots_(), registrations_(), ready_(), parked_() {
+    available_ = ring_->Init(entries);
+    if (!available_) {
+        PLOG(WARNING) << "io_uring is not available";
+        return;
+    }
+    // One receive buffer slot per connection the ring can comfortably serve.
+    // Without them connections receive with recv into the same buffers.
+    if (ring_->RegisterBufferSlots(entries)) {
+        for (int slot = entries - 1; slot >= 0; slot--) {
+            free_buffer_slots_.push_back(slot);
+        }
+    }
+}
+
+IoUringLoop::~IoUringLoop() {
+    while (!registrations_.empty()) {
+        Unregister(registrations_.begin());
+    }
+    for (auto it = parked_.begin(); it != parked_.end(); ++it) {
+        if (!Drain(it->channel.get())) {
+            // The kernel may yet read or write the memory behind the channel's
+            // I/O, so it's safer to never free it at all
+            LOG(ERROR) << "Leaking a connection whose I/O couldn't be cancelled";
+            new Registration(*it);
+        }
+    }
+}
+
+bool IoUringLoop::available() const {
+    return available_;
+}
+
+int IoUringLoop::fd() const {
+    return available_ ? ring_->fd() : -1;
+}
+
+shared_ptr<IoUringChannel> IoUringLoop::NewChannel(int fd) {
+    if (!available_) {
+        return shared_ptr<IoUringChannel>();
+    }
+    return make_shared<IoUringChannel>(ring_.get(), fd);
+}
+
+bool IoUringLoop::Add(shared_ptr<NonblockingKineticConnectionInterface> connection,
+    shared_ptr<IoUringChannel> channel) {
+    if (!free_buffer_slots_.empty() &&
+            ring_->SetBuffer(free_buffer_slots_.back(), channel->receive_buffer(),
+                IoUringChannel::kReceiveBufferSize)) {
+        channel->set_buffer_slot(free_buffer_slots_.back());
+        free_buffer_slots_.pop_back();
+    }
+    Registration registration;
+    registration.connection = connection;
+    registration.channel = channel;
+    registrations_[channel.get()] = registration;
+    return true;
+}
+
+bool IoUringLoop::Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection) {
+    for (auto it = registrations_.begin(); it != registrations_.end(); ++it) {
+        if (it->second.connection == connection) {
+            Unregister(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IoUringLoop::Flush(const shared_ptr<NonblockingKineticConnectionInterface>& connection) {
+    for (auto it = registrations_.begin(); it != registrations_.end(); ++it) {
+        if (it->second.connection == connection) {
+            return Run(it->first);
+        }
+    }
+    return false;
+}
+
+int IoUringLoop::RunOnce(int timeout_ms) {
+    if (!available_) {
+        errno = ENOSYS;
+        return -1;
+    }
+    // Connections may already be waiting to run if completions were picked up
+    // while removing a connection, in which case there's no sense waiting
+    if (!ring_->Enter(ready_.empty(), timeout_ms)) {
+        return -1;
+    }
+    ReapCompletions();
+    ReleaseParked();
+
+    // Running connections can add or remove others, and queue more
+    // completions when the queue fills up, so work from a copy
+    vector<IoUringChannel *> ready;
+    ready.swap(ready_);
+    int run = 0;
+    for (auto it = ready.begin(); it != ready.end(); ++it) {
+        if (registrations_.find(*it) == registrations_.end()) {
+            continue;
+        }
+        Run(*it);
+        run++;
+    }
+    return run;
+}
+
+bool IoUringLoop::Run(IoUringChannel *channel) {
+    auto it = registrations_.find(channel);
+    CHECK(it != registrations_.end());
+    channel->set_ready(false);
+    // Hold on to the connection in case a callback removes it
+    shared_ptr<NonblockingKineticConnectionInterface> connection = it->second.connection;
+    IoInterest interest;
+    if (connection->Run(&interest)) {
+        return true;
+    }
+    it = registrations_.find(channel);
+    if (it != registrations_.end()) {
+        Unregister(it);
+    }
+    return false;
+}
+
+void IoUringLoop::Unregister(unordered_map<IoUringChannel *, Registration>::iterator it) {
+    // The connection may go away along with its registration, and its
+    // handlers may remove other connections, so let go of it only once the
+    // registration is gone
+    Registration registration = it->second;
+    registrations_.erase(it);
+    IoUringChannel *channel = registration.channel.get();
+    ready_.erase(std::remove(ready_.begin(), ready_.end(), channel), ready_.end());
+    bool drained = Drain(channel);
+    channel->Close();
+    if (!drained) {
+        // Sends point into memory belonging to the connection's writer, and
+        // receives into the channel, so both have to outlive the I/O
+        parked_.push_back(registration);
+        return;
+    }
+    ReleaseBufferSlot(channel);
+}
+
+void IoUringLoop::ReleaseBufferSlot(IoUringChannel *channel) {
+    if (channel->buffer_slot() >= 0) {
+        ring_->SetBuffer(channel->buffer_slot(), NULL, 0);
+        free_buffer_slots_.push_back(channel->buffer_slot());
+        channel->set_buffer_slot(-1);
+    }
+}
+
+void IoUringLoop::ReleaseParked() {
+    for (auto it = parked_.begin(); it != parked_.end();) {
+        if (it->channel->busy()) {
+            ++it;
+            continue;
+        }
+        ReleaseBufferSlot(it->channel.get());
+        it = parked_.erase(it);
+    }
+}
+
+// Returns false if the channel may still have I/O in flight
+bool IoUringLoop::Drain(IoUringChannel *channel) {
+    if (!channel->busy()) {
+        return true;
+    }
+    if (!channel->Cancel()) {
+        PLOG(ERROR) << "Failed to cancel I/O";
+    }
+    // The kernel may still be using the channel's buffers until the
+    // cancelled operations complete
+    while (channel->busy()) {
+        if (!ring_->Enter(true, -1)) {
+            PLOG(ERROR) << "Failed waiting for cancelled I/O";
+            return false;
+        }
+        ReapCompletions();
+    }
+    return true;
+}
+
+void IoUringLoop::ReapCompletions() {
+    IoUring::Completion completions[kMaxCompletions];
+    int count;
+    while ((count = ring_->Reap(completions, kMaxCompletions)) > 0) {
+        for (int i = 0; i < count; i++) {
+            IoUringChannel::Operation operation;
+            IoUringChannel *channel = IoUringChannel::FromUserData(completions[i].user_data, &operation);
+            if (operation == IoUringChannel::kCancel) {
+                continue;
+            }
+            channel->Complete(operation, completions[i].result);
+            // Parked channels have nothing left to run
+            if (!channel->ready() && registrations_.count(channel) != 0) {
+                channel->set_ready(true);
+                ready_.push_back(channel);
+            }
+        }
+    }
+}
+
+} // namespace kinetic
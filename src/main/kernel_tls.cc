@@ -0,0 +1,246 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include "kernel_tls.h"
+
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#ifdef KINETIC_HAVE_KERNEL_TLS
+#include <linux/tls.h>
+#endif
+
+#include <algorithm>
+
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+#ifdef KINETIC_HAVE_KERNEL_TLS
+// Not in every libc's headers
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+// TLS record content type of alerts
+static const unsigned char kAlertRecordType = 21;
+
+TlsRecordKeys::TlsRecordKeys() : key_size(0), write_key(), write_salt(), read_key(), read_salt(),
+    write_sequence(), read_sequence(), read_buffered(false) {}
+
+void TlsPrf(const EVP_MD *md, const unsigned char *secret, size_t secret_length, const string &label,
+        const string &seed, unsigned char *out, size_t length) {
+    string label_and_seed = label + seed;
+    // P_hash: A(1) = HMAC(secret, label_and_seed), A(i) = HMAC(secret, A(i-1)),
+    // and the output is HMAC(secret, A(i) + label_and_seed) for i = 1, 2...
+    unsigned char a[EVP_MAX_MD_SIZE];
+    unsigned int a_length;
+    HMAC(md, secret, secret_length, reinterpret_cast<const unsigned char *>(label_and_seed.data()),
+        label_and_seed.size(), a, &a_length);
+    size_t filled = 0;
+    while (filled < length) {
+        string input(reinterpret_cast<char *>(a), a_length);
+        input += label_and_seed;
+        unsigned char chunk[EVP_MAX_MD_SIZE];
+        unsigned int chunk_length;
+        HMAC(md, secret, secret_length, reinterpret_cast<const unsigned char *>(input.data()), input.size(),
+            chunk, &chunk_length);
+        size_t count = std::min(length - filled, static_cast<size_t>(chunk_length));
+        memcpy(out + filled, chunk, count);
+        filled += count;
+
+        unsigned char next[EVP_MAX_MD_SIZE];
+        HMAC(md, secret, secret_length, a, a_length, next, &a_length);
+        memcpy(a, next, a_length);
+        OPENSSL_cleanse(chunk, sizeof(chunk));
+    }
+    OPENSSL_cleanse(a, sizeof(a));
+}
+
+static bool EndsWith(const string &s, const string &suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool GetTlsRecordKeys(SSL *ssl, TlsRecordKeys *keys) {
+    // The kernel can't compress records
+    if (SSL_version(ssl) != TLS1_2_VERSION || SSL_get_current_compression(ssl) != NULL) {
+        return false;
+    }
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    if (cipher == NULL) {
+        return false;
+    }
+    // Every suite with AES-GCM has SHA-256 as its PRF hash with 128 bit keys,
+    // and SHA-384 with 256 bit keys. OpenSSL names them after all three.
+    string name(SSL_CIPHER_get_name(cipher));
+    const EVP_MD *md;
+    if (EndsWith(name, "AES128-GCM-SHA256")) {
+        keys->key_size = 16;
+        md = EVP_sha256();
+    } else if (EndsWith(name, "AES256-GCM-SHA384")) {
+        keys->key_size = 32;
+        md = EVP_sha384();
+    } else {
+        return false;
+    }
+
+    SSL_SESSION *session = SSL_get_session(ssl);
+    if (session == NULL) {
+        return false;
+    }
+    unsigned char master_key[SSL_MAX_MASTER_KEY_LENGTH];
+    size_t master_key_length;
+    // The key block's seed is the server's random followed by the client's
+    string randoms;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    master_key_length = session->master_key_length;
+    memcpy(master_key, session->master_key, master_key_length);
+    randoms.assign(reinterpret_cast<char *>(ssl->s3->server_random), SSL3_RANDOM_SIZE);
+    randoms.append(reinterpret_cast<char *>(ssl->s3->client_random), SSL3_RANDOM_SIZE);
+    memcpy(keys->write_sequence, ssl->s3->write_sequence, sizeof(keys->write_sequence));
+    memcpy(keys->read_sequence, ssl->s3->read_sequence, sizeof(keys->read_sequence));
+    // rbuf holds what's been read from the socket and not yet decrypted, and
+    // rrec the rest of the last record decrypted
+    keys->read_buffered = ssl->s3->rbuf.left != 0 || ssl->s3->rrec.length != 0;
+#else
+    master_key_length = SSL_SESSION_get_master_key(session, master_key, sizeof(master_key));
+    unsigned char random[SSL3_RANDOM_SIZE];
+    SSL_get_server_random(ssl, random, sizeof(random));
+    randoms.assign(reinterpret_cast<char *>(random), sizeof(random));
+    SSL_get_client_random(ssl, random, sizeof(random));
+    randoms.append(reinterpret_cast<char *>(random), sizeof(random));
+    keys->write_sequence[7] = 1;
+    keys->read_sequence[7] = 1;
+    keys->read_buffered = SSL_has_pending(ssl);
+#endif
+
+    // AEAD suites have no MAC keys, so the key block is the client's key,
+    // the server's key, then the client's implicit nonce and the server's
+    unsigned char key_block[2 * sizeof(keys->write_key) + 2 * sizeof(keys->write_salt)];
+    size_t key_size = keys->key_size;
+    TlsPrf(md, master_key, master_key_length, "key expansion", randoms, key_block,
+        2 * key_size + 2 * sizeof(keys->write_salt));
+    memcpy(keys->write_key, key_block, key_size);
+    memcpy(keys->read_key, key_block + key_size, key_size);
+    memcpy(keys->write_salt, key_block + 2 * key_size, sizeof(keys->write_salt));
+    memcpy(keys->read_salt, key_block + 2 * key_size + sizeof(keys->write_salt), sizeof(keys->read_salt));
+    OPENSSL_cleanse(key_block, sizeof(key_block));
+    OPENSSL_cleanse(master_key, sizeof(master_key));
+    return true;
+}
+
+#ifdef KINETIC_HAVE_KERNEL_TLS
+// Gives the kernel the keys for one direction. The explicit part of each
+// record's nonce only has to be unique for the key, and the kernel counts it
+// up from the sequence number. OpenSSL gave the Finished message a random one,
+// so the two won't meet.
+template <typename CryptoInfo>
+static bool SetKeys(int fd, int direction, int cipher_type, const unsigned char *key, size_t key_size,
+        const unsigned char *salt, const unsigned char *sequence) {
+    CryptoInfo info;
+    memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_2_VERSION;
+    info.info.cipher_type = cipher_type;
+    CHECK_EQ(key_size, sizeof(info.key));
+    memcpy(info.key, key, sizeof(info.key));
+    memcpy(info.salt, salt, sizeof(info.salt));
+    memcpy(info.iv, sequence, sizeof(info.iv));
+    memcpy(info.rec_seq, sequence, sizeof(info.rec_seq));
+    bool ok = setsockopt(fd, SOL_TLS, direction, &info, sizeof(info)) == 0;
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ok;
+}
+
+static bool SetKeys(int fd, int direction, const unsigned char *key, size_t key_size,
+        const unsigned char *salt, const unsigned char *sequence) {
+    if (key_size == 16) {
+        return SetKeys<struct tls12_crypto_info_aes_gcm_128>(fd, direction, TLS_CIPHER_AES_GCM_128, key,
+            key_size, salt, sequence);
+    }
+#ifdef TLS_CIPHER_AES_GCM_256
+    if (key_size == 32) {
+        return SetKeys<struct tls12_crypto_info_aes_gcm_256>(fd, direction, TLS_CIPHER_AES_GCM_256, key,
+            key_size, salt, sequence);
+    }
+#endif
+    return false;
+}
+#endif
+
+bool StartKernelTlsSend(int fd, const TlsRecordKeys &keys) {
+#if defined(KINETIC_HAVE_KERNEL_TLS) && defined(TCP_ULP)
+    // Until it's given keys the TLS layer passes everything through, so the
+    // socket carries on working if the kernel then turns them down
+    if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+        PLOG(INFO) << "Kernel TLS isn't available";
+        return false;
+    }
+    if (!SetKeys(fd, TLS_TX, keys.write_key, keys.key_size, keys.write_salt, keys.write_sequence)) {
+        PLOG(INFO) << "The kernel can't encrypt this connection's records";
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool StartKernelTlsReceive(int fd, const TlsRecordKeys &keys) {
+#if defined(KINETIC_HAVE_KERNEL_TLS) && defined(TLS_RX)
+    if (!SetKeys(fd, TLS_RX, keys.read_key, keys.key_size, keys.read_salt, keys.read_sequence)) {
+        PLOG(INFO) << "The kernel can't decrypt this connection's records";
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SendKernelTlsCloseNotify(int fd) {
+#if defined(KINETIC_HAVE_KERNEL_TLS) && defined(TLS_SET_RECORD_TYPE)
+    // A warning-level close_notify, in an alert record rather than the
+    // application data records plain sends make
+    char alert[2] = {1, 0};
+    struct iovec iov;
+    iov.iov_base = alert;
+    iov.iov_len = sizeof(alert);
+    char control[CMSG_SPACE(sizeof(kAlertRecordType))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(kAlertRecordType));
+    *CMSG_DATA(cmsg) = kAlertRecordType;
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+        PLOG(INFO) << "Failed to send close_notify";
+    }
+#endif
+}
+
+} // namespace kinetic
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_KERNEL_TLS_H_
+#define KINETIC_CPP_CLIENT_KERNEL_TLS_H_
+
+#include <stddef.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+
+#include <string>
+
+namespace kinetic {
+
+using std::string;
+
+// What the kernel needs to take over the records of a TLS connection (kTLS):
+// the keys and implicit nonces TLS 1.2 derives for AES-GCM in each direction,
+// and the sequence number of the next record each way. Everything is from the
+// client's side of the connection.
+struct TlsRecordKeys {
+    TlsRecordKeys();
+
+    // 16 for AES-128-GCM or 32 for AES-256-GCM
+    size_t key_size;
+    unsigned char write_key[32];
+    unsigned char write_salt[4];
+    unsigned char read_key[32];
+    unsigned char read_salt[4];
+    // Big-endian, as they go into each record's nonce and additional data
+    unsigned char write_sequence[8];
+    unsigned char read_sequence[8];
+    // Set if OpenSSL is holding bytes it has read from the socket and not yet
+    // handed out. The kernel would never see those, so receiving has to stay
+    // with OpenSSL.
+    bool read_buffered;
+};
+
+// TLS 1.2's pseudorandom function (RFC 5246 section 5), with md as its hash.
+// Fills length bytes of out.
+void TlsPrf(const EVP_MD *md, const unsigned char *secret, size_t secret_length, const string &label,
+    const string &seed, unsigned char *out, size_t length);
+
+// Works out the record keys of ssl, which must have just finished its
+// handshake with nothing sent or received since. Returns false unless it
+// negotiated TLS 1.2 with one of the AES-GCM cipher suites and no compression,
+// which is all the kernel can take.
+//
+// OpenSSL 1.0 has no API for any of this, but its structures aren't opaque,
+// so the master secret, randoms and sequence numbers are read straight out of
+// them. Later versions hide the sequence numbers; straight after a TLS 1.2
+// handshake each side has sent only its Finished message under the new keys,
+// so both are 1.
+bool GetTlsRecordKeys(SSL *ssl, TlsRecordKeys *keys);
+
+// Attaches the kernel's TLS layer to the TCP socket fd and has it encrypt
+// everything sent on it from now on, so plain writes, writev and sendfile
+// all go out as TLS records. Returns false, leaving sends to OpenSSL, if the
+// kernel can't.
+bool StartKernelTlsSend(int fd, const TlsRecordKeys &keys);
+
+// Has the kernel decrypt everything received on fd from now on, so plain
+// reads return the records' contents. Only application data can be read
+// that way; any other record, such as an alert, fails the read. Call after
+// StartKernelTlsSend succeeds. Returns false, leaving receiving to OpenSSL,
+// if the kernel can't.
+bool StartKernelTlsReceive(int fd, const TlsRecordKeys &keys);
+
+// Sends a close_notify alert on a socket whose sends the kernel encrypts
+void SendKernelTlsCloseNotify(int fd);
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_KERNEL_TLS_H_
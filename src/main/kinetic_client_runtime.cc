@@ -0,0 +1,317 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "kinetic/kinetic_client_runtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "glog/logging.h"
+
+#include "kinetic/kinetic_reactor.h"
+#include "mpsc_queue.h"
+
+namespace kinetic {
+
+using std::make_shared;
+using std::move;
+using std::weak_ptr;
+
+namespace {
+
+// How long an I/O thread leaves its reactor between checks for submissions
+// where the reactor can't be waited on together with the wakeup
+const int kFallbackIntervalMs = 10;
+
+// An added connection as the listener installed on it sees it
+struct Registration {
+    explicit Registration(weak_ptr<NonblockingKineticConnectionInterface> connection)
+        : connection(connection), pending(false) {}
+    weak_ptr<NonblockingKineticConnectionInterface> connection;
+    // Set while the connection is waiting in Wakeup's queue to be flushed
+    std::atomic<bool> pending;
+};
+
+// Wakes an I/O thread and tells it which connections have had requests
+// submitted. Listeners installed on connections hold on to it, so it can
+// outlive the thread.
+class Wakeup {
+    public:
+    Wakeup() : signalled_(false), submitted_() {
+#ifdef __linux__
+        read_fd_ = write_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        PCHECK(read_fd_ >= 0) << "Failed to create eventfd";
+#else
+        int fds[2];
+        PCHECK(pipe(fds) == 0) << "Failed to create pipe";
+        for (int i = 0; i < 2; i++) {
+            fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        }
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+#endif
+    }
+
+    ~Wakeup() {
+        close(read_fd_);
+        if (write_fd_ != read_fd_) {
+            close(write_fd_);
+        }
+    }
+
+    int fd() const { return read_fd_; }
+
+    // Only the first signal since the thread last woke up costs a system call
+    void Signal() {
+        if (!signalled_.exchange(true)) {
+            uint64_t one = 1;
+            // Can only fail if the counter or pipe is already full, in which
+            // case the thread will wake up anyway
+            ssize_t ignored = write(write_fd_, &one, sizeof(one));
+            (void) ignored;
+        }
+    }
+
+    void Submitted(const shared_ptr<Registration> &registration) {
+        if (!registration->pending.exchange(true)) {
+            submitted_.Push(registration);
+            Signal();
+        }
+    }
+
+    // Called by the thread once it's woken up. Anything signalled after this
+    // wakes it again. Exchanging rather than storing makes every push whose
+    // signal was skipped because of the flag visible to TakeSubmitted.
+    void Clear() {
+        uint64_t buffer[16];
+        while (read(read_fd_, buffer, sizeof(buffer)) > 0) {}
+        signalled_.exchange(false);
+    }
+
+    // Only returns false once the queue is really empty. A push that has
+    // started but not linked its node in holds back everything pushed after
+    // it, including pushes whose signal was skipped, so it's waited for.
+    bool TakeSubmitted(shared_ptr<Registration> *registration) {
+        while (!submitted_.Pop(registration)) {
+            if (submitted_.Empty()) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        // Requests submitted from here on have to signal again
+        (*registration)->pending = false;
+        return true;
+    }
+
+    private:
+    int read_fd_;
+    int write_fd_;
+    std::atomic<bool> signalled_;
+    MpscQueue<shared_ptr<Registration>> submitted_;
+    DISALLOW_COPY_AND_ASSIGN(Wakeup);
+};
+
+} // namespace
+
+class KineticClientRuntime::IoThread {
+    public:
+    IoThread() : wakeup_(make_shared<Wakeup>()), reactor_(), mutex_(), tasks_(), stopping_(false),
+        thread_(&IoThread::Loop, this) {}
+
+    ~IoThread() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            stopping_ = true;
+        }
+        wakeup_->Signal();
+        thread_.join();
+    }
+
+    bool Add(shared_ptr<NonblockingKineticConnectionInterface> connection) {
+        shared_ptr<Wakeup> wakeup = wakeup_;
+        auto registration = make_shared<Registration>(connection);
+        connection->SetSubmitListener([wakeup, registration]() { wakeup->Submitted(registration); });
+        return RunOnThread<bool>([this, connection]() { return reactor_.Add(connection); });
+    }
+
+    bool Remove(const shared_ptr<NonblockingKineticConnectionInterface> &connection) {
+        // The listener is left in place, since requests may still be being
+        // submitted. Waking the thread for them does no harm.
+        return RunOnThread<bool>([this, connection]() { return reactor_.Remove(connection); });
+    }
+
+    size_t size() {
+        return RunOnThread<size_t>([this]() { return reactor_.size(); });
+    }
+
+    bool on_this_thread() const {
+        return std::this_thread::get_id() == thread_.get_id();
+    }
+
+    private:
+    // Runs task on the I/O thread, since only it may touch the reactor, and
+    // returns its result
+    template <typename T>
+    T RunOnThread(const std::function<T()> &task) {
+        if (on_this_thread()) {
+            return task();
+        }
+        std::packaged_task<T()> packaged(task);
+        std::future<T> result = packaged.get_future();
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            tasks_.push_back(std::packaged_task<void()>(move(packaged)));
+        }
+        wakeup_->Signal();
+        return result.get();
+    }
+
+    void Loop() {
+        struct pollfd pollfds[2];
+        pollfds[0].fd = wakeup_->fd();
+        pollfds[0].events = POLLIN;
+        pollfds[1].fd = reactor_.fd();
+        pollfds[1].events = POLLIN;
+        // Without epoll the reactor can't be waited on along with the wakeup,
+        // so it does the waiting and the wakeup is checked in between
+        bool combined = reactor_.fd() >= 0;
+
+        while (true) {
+            pollfds[0].revents = pollfds[1].revents = 0;
+            int count = poll(pollfds, combined ? 2 : 1, combined ? -1 : 0);
+            if (count < 0 && errno != EINTR) {
+                PLOG(ERROR) << "Failed to wait for connections";
+                return;
+            }
+            if (pollfds[0].revents != 0) {
+                wakeup_->Clear();
+                if (!RunTasks()) {
+                    return;
+                }
+                FlushSubmitted();
+            }
+            if (!combined) {
+                reactor_.RunOnce(kFallbackIntervalMs);
+            } else if (pollfds[1].revents != 0) {
+                reactor_.RunOnce(0);
+            }
+        }
+    }
+
+    // Returns false once the thread is to stop
+    bool RunTasks() {
+        std::deque<std::packaged_task<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (stopping_) {
+                return false;
+            }
+            tasks.swap(tasks_);
+        }
+        for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+            (*it)();
+        }
+        return true;
+    }
+
+    void FlushSubmitted() {
+        shared_ptr<Registration> registration;
+        while (wakeup_->TakeSubmitted(&registration)) {
+            shared_ptr<NonblockingKineticConnectionInterface> connection = registration->connection.lock();
+            // Does nothing if the connection has been removed since
+            if (connection) {
+                reactor_.Flush(connection);
+            }
+        }
+    }
+
+    shared_ptr<Wakeup> wakeup_;
+    KineticReactor reactor_;
+    // Guards tasks_ and stopping_
+    std::mutex mutex_;
+    std::deque<std::packaged_task<void()>> tasks_;
+    bool stopping_;
+    // Last, so that everything it uses is ready before it starts
+    std::thread thread_;
+    DISALLOW_COPY_AND_ASSIGN(IoThread);
+};
+
+KineticClientRuntime::KineticClientRuntime(int io_threads, shared_ptr<ExecutorInterface> executor)
+    : executor_(executor), threads_(), next_thread_(0) {
+    CHECK_GT(io_threads, 0);
+    for (int i = 0; i < io_threads; i++) {
+        threads_.push_back(unique_ptr<IoThread>(new IoThread()));
+    }
+}
+
+KineticClientRuntime::~KineticClientRuntime() {
+    threads_.clear();
+}
+
+bool KineticClientRuntime::Add(shared_ptr<NonblockingKineticConnectionInterface> connection) {
+    // A callback adding a connection keeps it on its own thread rather than
+    // waiting on another one
+    IoThread *thread = NULL;
+    for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+        if ((*it)->on_this_thread()) {
+            thread = it->get();
+        }
+    }
+    if (thread == NULL) {
+        thread = threads_[next_thread_.fetch_add(1, std::memory_order_relaxed) % threads_.size()].get();
+    }
+
+    if (executor_) {
+        connection->SetCompletionExecutor(executor_);
+    }
+    return thread->Add(connection);
+}
+
+bool KineticClientRuntime::Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection) {
+    // Removing is rare enough that asking every thread is simpler than
+    // keeping track of where each connection went, and of which have failed
+    for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+        if ((*it)->Remove(connection)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t KineticClientRuntime::size() const {
+    size_t size = 0;
+    for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+        size += (*it)->size();
+    }
+    return size;
+}
+
+} // namespace kinetic
@@ -18,20 +18,37 @@
 #include "kinetic/kinetic_connection_factory.h"
 #include "socket_wrapper.h"
 #include "nonblocking_packet_service.h"
+#include "io_uring_channel.h"
+#include "pending_connection.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <chrono>
 #include <exception>
 #include <stdexcept>
 
 
 namespace kinetic {
 
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+// How long opening a single connection may take, handshake included
+static const int kConnectTimeoutSeconds = 30;
+
 KineticConnectionFactory NewKineticConnectionFactory() {
-    HmacProvider hmac_provider;
+    return KineticConnectionFactory(make_shared<HmacProvider>());
+}
+
+KineticConnectionFactory NewKineticConnectionFactory(shared_ptr<HmacProviderInterface> hmac_provider) {
     return KineticConnectionFactory(hmac_provider);
 }
 
 KineticConnectionFactory::KineticConnectionFactory(
-        HmacProvider hmac_provider)
-    : hmac_provider_(hmac_provider) {}
+        shared_ptr<HmacProviderInterface> hmac_provider)
+    : hmac_provider_(hmac_provider), tls_context_(make_shared<TlsContext>()) {}
 
 
 Status KineticConnectionFactory::NewNonblockingConnection(
@@ -114,27 +131,219 @@ Status KineticConnectionFactory::NewThreadsafeBlockingConnection(
     return status;
 }
 
+Status KineticConnectionFactory::NewIoUringConnection(
+        const ConnectionOptions& options,
+        IoUringLoop& loop,
+        shared_ptr<NonblockingKineticConnection>& connection) {
+    if (!loop.available())
+        return Status::makeInternalError("io_uring is not available");
+    if (options.use_ssl)
+        return Status::makeInternalError("SSL connections can't use io_uring");
+
+    unique_ptr<NonblockingKineticConnection> nbc;
+    shared_ptr<IoUringChannel> channel;
+    Status status = doNewConnection(options, nbc, &loop, &channel);
+    if (status.ok()) {
+        connection.reset(nbc.release());
+        loop.Add(connection, channel);
+    }
+    return status;
+}
+
+Status KineticConnectionFactory::StartNonblockingConnection(
+        const ConnectionOptions& options,
+        unique_ptr<PendingKineticConnection>& pending) {
+    unique_ptr<PendingConnection> connection;
+    try {
+        connection.reset(new PendingConnection(options, hmac_provider_, tls_context_));
+    } catch(std::exception& e) {
+        return Status::makeInternalError("Connection error: "+std::string(e.what()));
+    }
+    pending.reset(new PendingKineticConnection(*this, options, std::move(connection)));
+    return Status::makeOk();
+}
+
+void KineticConnectionFactory::NewNonblockingConnections(
+        const vector<ConnectionOptions>& options,
+        unsigned int timeout_seconds,
+        ConnectCallbackInterface& callback) {
+    auto deadline = steady_clock::now() + seconds(timeout_seconds);
+    vector<unique_ptr<PendingKineticConnection>> pending(options.size());
+    vector<IoInterest> interests(options.size());
+    size_t remaining = options.size();
+
+    // Continues connection i, reporting it if it's done with
+    auto run = [&](size_t i) {
+        if (pending[i]->Continue(&interests[i]))
+            return;
+        Status status = pending[i]->status();
+        shared_ptr<NonblockingKineticConnection> connection = pending[i]->connection();
+        pending[i].reset();
+        remaining--;
+        if (status.ok()) {
+            callback.Success(i, connection);
+        } else {
+            callback.Failure(i, status);
+        }
+    };
+
+    for (size_t i = 0; i < options.size(); i++) {
+        Status started = StartNonblockingConnection(options[i], pending[i]);
+        if (started.notOk()) {
+            remaining--;
+            callback.Failure(i, started);
+            continue;
+        }
+        run(i);
+    }
+
+    vector<struct pollfd> pollfds;
+    vector<size_t> indices;
+    while (remaining > 0) {
+        auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if (left <= 0)
+            break;
+
+        pollfds.clear();
+        indices.clear();
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (!pending[i])
+                continue;
+            struct pollfd pfd;
+            pfd.fd = interests[i].fd;
+            pfd.events = (interests[i].read ? POLLIN : 0) | (interests[i].write ? POLLOUT : 0);
+            pfd.revents = 0;
+            pollfds.push_back(pfd);
+            indices.push_back(i);
+        }
+        if (poll(&pollfds[0], pollfds.size(), left) < 0 && errno != EINTR) {
+            PLOG(ERROR) << "Failed waiting for connections";
+            break;
+        }
+        for (size_t j = 0; j < pollfds.size(); j++) {
+            if (pollfds[j].revents != 0)
+                run(indices[j]);
+        }
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i]) {
+            pending[i].reset();
+            callback.Failure(i, Status::makeInternalError("Connection error: Timed out."));
+        }
+    }
+}
+
+PendingKineticConnection::PendingKineticConnection(const KineticConnectionFactory &factory,
+        const ConnectionOptions &options, unique_ptr<PendingConnection> pending)
+    : factory_(factory), options_(options), pending_(std::move(pending)),
+    status_(Status::makeInternalError("Connection error: Still connecting.")), connection_() {}
+
+PendingKineticConnection::~PendingKineticConnection() {}
+
+bool PendingKineticConnection::Continue(IoInterest *interest) {
+    if (!pending_)
+        return false;
+    NonblockingStringStatus status = pending_->Run(interest);
+    if (status == kInProgress)
+        return true;
+    if (status == kDone) {
+        unique_ptr<NonblockingKineticConnection> connection;
+        status_ = factory_.doFinishConnection(options_, *pending_, connection);
+        if (status_.ok())
+            connection_.reset(connection.release());
+    } else {
+        status_ = Status::makeInternalError("Connection error: " + pending_->error());
+    }
+    pending_.reset();
+    return false;
+}
+
+shared_ptr<NonblockingKineticConnection> PendingKineticConnection::connection() {
+    shared_ptr<NonblockingKineticConnection> connection;
+    connection.swap(connection_);
+    return connection;
+}
+
 Status KineticConnectionFactory::doNewConnection(
         ConnectionOptions const& options,
-        unique_ptr <NonblockingKineticConnection>& connection) {
+        unique_ptr <NonblockingKineticConnection>& connection,
+        IoUringLoop *io_uring_loop,
+        shared_ptr<IoUringChannel> *io_uring_channel) {
+    try{
+        PendingConnection pending(options, hmac_provider_, tls_context_);
+        auto deadline = steady_clock::now() + seconds(kConnectTimeoutSeconds);
+        IoInterest interest;
+        NonblockingStringStatus status;
+        while ((status = pending.Run(&interest)) == kInProgress) {
+            auto left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+            if (left <= 0)
+                throw std::runtime_error("Timed out.");
+            struct pollfd pfd;
+            pfd.fd = interest.fd;
+            pfd.events = (interest.read ? POLLIN : 0) | (interest.write ? POLLOUT : 0);
+            pfd.revents = 0;
+            if (poll(&pfd, 1, left) < 0 && errno != EINTR)
+                throw std::runtime_error("Could not wait for socket.");
+        }
+        if (status == kFailed)
+            throw std::runtime_error(pending.error());
+        return doFinishConnection(options, pending, connection, io_uring_loop, io_uring_channel);
+    } catch(std::exception& e){
+           return Status::makeInternalError("Connection error: "+std::string(e.what()));
+    }
+}
+
+Status KineticConnectionFactory::doFinishConnection(
+        ConnectionOptions const& options,
+        PendingConnection& pending,
+        unique_ptr <NonblockingKineticConnection>& connection,
+        IoUringLoop *io_uring_loop,
+        shared_ptr<IoUringChannel> *io_uring_channel) {
     try{
-        auto socket_wrapper = make_shared<SocketWrapper>(options.host, options.port, options.use_ssl, true);
-        if (!socket_wrapper->Connect())
-            throw std::runtime_error("Could not connect to socket.");
+        shared_ptr<SocketWrapper> socket_wrapper = pending.socket_wrapper();
+        shared_ptr<NonblockingReceiver> nonblocking_receiver = pending.receiver();
+        shared_ptr<NonblockingReceiverInterface> receiver = nonblocking_receiver;
+
+        if (io_uring_loop) {
+            // The handshake has been read the usual way; everything after it
+            // goes through the ring. Fixed-buffer reads only wait for data on
+            // blocking sockets, and the ring does the waiting for us anyway.
+            *io_uring_channel = io_uring_loop->NewChannel(socket_wrapper->fd());
+            if (!*io_uring_channel)
+                throw std::runtime_error("Could not set up io_uring.");
+            int flags = fcntl(socket_wrapper->fd(), F_GETFL);
+            if (flags < 0 || fcntl(socket_wrapper->fd(), F_SETFL, flags & ~O_NONBLOCK) != 0)
+                throw std::runtime_error("Could not make socket blocking.");
+            nonblocking_receiver->set_packet_source(io_uring_channel->get());
+        }
 
-        shared_ptr<NonblockingReceiverInterface> receiver;
-        receiver = shared_ptr<NonblockingReceiverInterface>(new NonblockingReceiver(socket_wrapper, hmac_provider_, options));
+        shared_ptr<ZerocopyTracker> zerocopy;
+        if (options.zerocopy_send && !options.use_ssl && !io_uring_loop) {
+            zerocopy = make_shared<ZerocopyTracker>(socket_wrapper->fd(), options.zerocopy_threshold);
+            if (!zerocopy->Enable()) {
+                // Fall back to ordinary sends
+                zerocopy.reset();
+            }
+        }
 
-        auto writer_factory =
-            shared_ptr<NonblockingPacketWriterFactoryInterface>(new NonblockingPacketWriterFactory());
+        shared_ptr<NonblockingPacketWriterFactoryInterface> writer_factory;
+        if (io_uring_loop) {
+            writer_factory.reset(new IoUringPacketWriterFactory(*io_uring_channel));
+        } else {
+            writer_factory.reset(new NonblockingPacketWriterFactory(zerocopy));
+        }
+        // The connection builds requests from these and the sender gives them back
+        auto pools = make_shared<RequestPools>();
         auto sender = unique_ptr<NonblockingSenderInterface>(new NonblockingSender(socket_wrapper,
                                                                                    receiver,
                                                                                    writer_factory,
-                                                                                   hmac_provider_,
-                                                                                   options));
+                                                                                   pending.hmac_provider(),
+                                                                                   options,
+                                                                                   pools));
 
         NonblockingPacketService *service = new NonblockingPacketService(socket_wrapper, move(sender), receiver);
-        connection.reset(new NonblockingKineticConnection(service));
+        connection.reset(new NonblockingKineticConnection(service, pools));
 
     } catch(std::exception& e){
            return Status::makeInternalError("Connection error: "+std::string(e.what()));
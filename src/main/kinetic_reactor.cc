@@ -0,0 +1,189 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include "kinetic/kinetic_reactor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+using std::vector;
+
+// Most events picked up by a single epoll_wait
+static const int kMaxEvents = 64;
+
+KineticReactor::KineticReactor() : epoll_fd_(-1), next_id_(0), registrations_(), ids_() {
+#ifdef __linux__
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        PLOG(ERROR) << "Failed to create epoll instance";
+    }
+#endif
+}
+
+KineticReactor::~KineticReactor() {
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+bool KineticReactor::Add(shared_ptr<NonblockingKineticConnectionInterface> connection) {
+    if (ids_.count(connection.get()) != 0) {
+        return false;
+    }
+    Registration registration;
+    registration.connection = connection;
+    if (!connection->Run(&registration.interest)) {
+        return false;
+    }
+
+    uint64_t id = next_id_++;
+#ifdef __linux__
+    if (epoll_fd_ < 0) {
+        return false;
+    }
+    // Registering for both directions up front means the registration never
+    // has to change; with edge triggering an idle direction costs nothing
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, registration.interest.fd, &event) != 0) {
+        PLOG(WARNING) << "Failed to add connection to epoll";
+        return false;
+    }
+#endif
+    registrations_[id] = registration;
+    ids_[connection.get()] = id;
+    return true;
+}
+
+bool KineticReactor::Remove(const shared_ptr<NonblockingKineticConnectionInterface>& connection) {
+    auto id = ids_.find(connection.get());
+    if (id == ids_.end()) {
+        return false;
+    }
+    Unregister(registrations_.find(id->second));
+    return true;
+}
+
+bool KineticReactor::Flush(const shared_ptr<NonblockingKineticConnectionInterface>& connection) {
+    auto id = ids_.find(connection.get());
+    if (id == ids_.end()) {
+        return false;
+    }
+    return Run(id->second);
+}
+
+int KineticReactor::RunOnce(int timeout_ms) {
+    // Collect the ready connections before running any of them, since their
+    // callbacks may add or remove connections
+    vector<uint64_t> ready;
+
+#ifdef __linux__
+    struct epoll_event events[kMaxEvents];
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        ready.push_back(events[i].data.u64);
+    }
+#else
+    vector<struct pollfd> pollfds;
+    vector<uint64_t> ids;
+    for (auto it = registrations_.begin(); it != registrations_.end(); ++it) {
+        const IoInterest &interest = it->second.interest;
+        if (!interest.read && !interest.write) {
+            // Idle until Flush is called
+            continue;
+        }
+        struct pollfd pfd;
+        pfd.fd = interest.fd;
+        pfd.events = (interest.read ? POLLIN : 0) | (interest.write ? POLLOUT : 0);
+        pfd.revents = 0;
+        pollfds.push_back(pfd);
+        ids.push_back(it->first);
+    }
+    int count = poll(pollfds.empty() ? NULL : &pollfds[0], pollfds.size(), timeout_ms);
+    if (count < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < pollfds.size(); i++) {
+        if (pollfds[i].revents != 0) {
+            ready.push_back(ids[i]);
+        }
+    }
+#endif
+
+    int run = 0;
+    for (auto it = ready.begin(); it != ready.end(); ++it) {
+        // A callback may have removed the connection already
+        if (registrations_.count(*it) == 0) {
+            continue;
+        }
+        Run(*it);
+        run++;
+    }
+    return run;
+}
+
+int KineticReactor::fd() const {
+    return epoll_fd_;
+}
+
+bool KineticReactor::Run(uint64_t id) {
+    auto it = registrations_.find(id);
+    CHECK(it != registrations_.end());
+    // Keep the connection alive even if a callback removes it
+    shared_ptr<NonblockingKineticConnectionInterface> connection = it->second.connection;
+    IoInterest interest;
+    bool ok = connection->Run(&interest);
+
+    // Callbacks can change the registrations, so look the connection up again
+    it = registrations_.find(id);
+    if (it == registrations_.end()) {
+        return ok;
+    }
+    if (!ok) {
+        Unregister(it);
+        return false;
+    }
+    it->second.interest = interest;
+    return true;
+}
+
+void KineticReactor::Unregister(unordered_map<uint64_t, Registration>::iterator it) {
+#ifdef __linux__
+    // The connection still owns its socket, so this can only fail if the
+    // socket was already closed, which removes it from epoll anyway
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.interest.fd, NULL);
+#endif
+    ids_.erase(it->second.connection.get());
+    registrations_.erase(it);
+}
+
+} // namespace kinetic
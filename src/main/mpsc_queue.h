@@ -0,0 +1,92 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_MPSC_QUEUE_H_
+#define KINETIC_CPP_CLIENT_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+#include "kinetic/common.h"
+
+namespace kinetic {
+
+// An unbounded queue any number of threads can push to without taking a lock,
+// and that a single thread at a time pops from. A push is one atomic exchange,
+// so producers never wait on each other or on the consumer beyond that.
+//
+// Items pushed by one thread come out in the order they were pushed; items
+// pushed by different threads come out in the order their exchanges happened.
+// A push that has done its exchange but not yet linked its node in holds back
+// everything pushed after it, so Pop can return false for a moment even
+// though the queue isn't empty.
+template <typename T>
+class MpscQueue {
+    public:
+    MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        T value;
+        while (Pop(&value)) {}
+        delete tail_;
+    }
+
+    void Push(T value) {
+        Node *node = new Node();
+        node->value = std::move(value);
+        Node *previous = head_.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Only one thread may pop at a time
+    bool Pop(T *value) {
+        // tail_ is a node whose value has already been taken
+        Node *next = tail_->next.load(std::memory_order_acquire);
+        if (next == NULL) {
+            return false;
+        }
+        *value = std::move(next->value);
+        delete tail_;
+        tail_ = next;
+        return true;
+    }
+
+    // Whether nothing has been pushed since the last successful Pop. Unlike a
+    // failed Pop, this is false while a push is still linking its node in.
+    // Only the popping thread may call it.
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_;
+    }
+
+    private:
+    struct Node {
+        Node() : next(NULL), value() {}
+        std::atomic<Node *> next;
+        T value;
+    };
+
+    // The most recently pushed node, written by producers
+    std::atomic<Node *> head_;
+    // The last node popped, only touched by the consumer
+    Node *tail_;
+    DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_MPSC_QUEUE_H_
@@ -17,6 +17,8 @@
 
 #include "kinetic/nonblocking_kinetic_connection.h"
 #include "nonblocking_packet_service.h"
+#include "object_pool.h"
+#include <string.h>
 #include <memory>
 #include <glog/logging.h>
 
@@ -84,6 +86,70 @@ void GetHandler::Error(KineticStatus error, Command const * const response) {
     callback_->Failure(error);
 }
 
+GetIntoHandler::GetIntoHandler(char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback)
+    : buffer_(buffer), capacity_(capacity), string_buffer_(NULL), fd_(-1), file_offset_(0),
+    value_size_(0), callback_(callback) {}
+
+GetIntoHandler::GetIntoHandler(string *buffer, const shared_ptr<GetIntoCallbackInterface> callback)
+    : buffer_(NULL), capacity_(0), string_buffer_(buffer), fd_(-1), file_offset_(0),
+    value_size_(0), callback_(callback) {}
+
+GetIntoHandler::GetIntoHandler(int fd, off_t offset, const shared_ptr<GetIntoCallbackInterface> callback)
+    : buffer_(NULL), capacity_(0), string_buffer_(NULL), fd_(fd), file_offset_(offset),
+    value_size_(0), callback_(callback) {}
+
+char* GetIntoHandler::ValueDestination(size_t value_length) {
+    if (fd_ != -1) {
+        return NULL;
+    }
+    if (string_buffer_ != NULL) {
+        string_buffer_->resize(value_length);
+        value_size_ = value_length;
+        return &(*string_buffer_)[0];
+    }
+    if (value_length > capacity_) {
+        // Let the value be read as usual so Handle can report that it didn't fit
+        return NULL;
+    }
+    value_size_ = value_length;
+    return buffer_;
+}
+
+int GetIntoHandler::ValueFile(size_t value_length, off_t *offset) {
+    if (fd_ != -1) {
+        value_size_ = value_length;
+        *offset = file_offset_;
+    }
+    return fd_;
+}
+
+void GetIntoHandler::Handle(const Command &response, unique_ptr<const string> value) {
+    if (value) {
+        // The value wasn't received into the buffer, either because it was empty
+        // or because it doesn't fit. Empty values leave the file untouched.
+        value_size_ = value->size();
+        if (fd_ != -1) {
+            CHECK_EQ((size_t) 0, value_size_);
+        } else if (string_buffer_ != NULL) {
+            string_buffer_->assign(*value);
+        } else if (value_size_ > capacity_) {
+            callback_->Failure(KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR,
+                "Value does not fit in buffer"));
+            return;
+        } else if (value_size_ > 0) {
+            memcpy(buffer_, value->data(), value_size_);
+        }
+    }
+    callback_->Success(response.body().keyvalue().key(), value_size_,
+        response.body().keyvalue().dbversion(), response.body().keyvalue().tag(),
+        response.body().keyvalue().algorithm());
+}
+
+void GetIntoHandler::Error(KineticStatus error, Command const * const response) {
+    callback_->Failure(error);
+}
+
 GetVersionHandler::GetVersionHandler(const shared_ptr<GetVersionCallbackInterface> callback)
     : callback_(callback) {}
 
@@ -229,8 +295,12 @@ void P2PPushHandler::Error(KineticStatus error, Command const * const response)
 }
 
 NonblockingKineticConnection::NonblockingKineticConnection(
-        NonblockingPacketServiceInterface *service)
-    : service_(service), empty_str_(make_shared<string>("")), cluster_version_(0) {}
+        NonblockingPacketServiceInterface *service, shared_ptr<RequestPools> pools)
+    : service_(service), pools_(pools), empty_value_(make_shared<string>("")), cluster_version_(0) {
+    if (!pools_) {
+        pools_ = make_shared<RequestPools>();
+    }
+}
 
 NonblockingKineticConnection::~NonblockingKineticConnection() {
     delete service_;
@@ -240,12 +310,20 @@ bool NonblockingKineticConnection::Run(fd_set *read_fds, fd_set *write_fds, int
     return service_->Run(read_fds, write_fds, nfds);
 }
 
+bool NonblockingKineticConnection::Run(IoInterest *interest) {
+    return service_->Run(interest);
+}
+
 void NonblockingKineticConnection::SetClientClusterVersion(int64_t cluster_version) {
     cluster_version_ = cluster_version;
 }
 
+unique_ptr<Message> NonblockingKineticConnection::NewMessage() {
+    return pools_->messages.Acquire();
+}
+
 unique_ptr<Command> NonblockingKineticConnection::NewCommand(Command_MessageType message_type) {
-    unique_ptr<Command> cmd(new Command());
+    unique_ptr<Command> cmd = pools_->commands.Acquire();
     cmd->mutable_header()->set_messagetype(message_type);
     cmd->mutable_header()->set_clusterversion(cluster_version_);
     return move(cmd);
@@ -254,11 +332,11 @@ unique_ptr<Command> NonblockingKineticConnection::NewCommand(Command_MessageType
 HandlerKey NonblockingKineticConnection::NoOp(const shared_ptr<SimpleCallbackInterface> callback) {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_NOOP);
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::Get(const shared_ptr<const string> key,
@@ -271,6 +349,39 @@ HandlerKey NonblockingKineticConnection::Get(const string key,
     return this->Get(make_shared<string>(key), callback);
 }
 
+HandlerKey NonblockingKineticConnection::GetInto(const shared_ptr<const string> key, char *buffer,
+        size_t capacity, const shared_ptr<GetIntoCallbackInterface> callback) {
+    unique_ptr<GetIntoHandler> handler(new GetIntoHandler(buffer, capacity, callback));
+    return SubmitGetInto(key, move(handler));
+}
+
+HandlerKey NonblockingKineticConnection::GetInto(const string key, char *buffer, size_t capacity,
+        const shared_ptr<GetIntoCallbackInterface> callback) {
+    return this->GetInto(make_shared<string>(key), buffer, capacity, callback);
+}
+
+HandlerKey NonblockingKineticConnection::GetInto(const shared_ptr<const string> key, string *buffer,
+        const shared_ptr<GetIntoCallbackInterface> callback) {
+    unique_ptr<GetIntoHandler> handler(new GetIntoHandler(buffer, callback));
+    return SubmitGetInto(key, move(handler));
+}
+
+HandlerKey NonblockingKineticConnection::GetInto(const string key, string *buffer,
+        const shared_ptr<GetIntoCallbackInterface> callback) {
+    return this->GetInto(make_shared<string>(key), buffer, callback);
+}
+
+HandlerKey NonblockingKineticConnection::GetToFile(const shared_ptr<const string> key, int fd,
+        off_t offset, const shared_ptr<GetIntoCallbackInterface> callback) {
+    unique_ptr<GetIntoHandler> handler(new GetIntoHandler(fd, offset, callback));
+    return SubmitGetInto(key, move(handler));
+}
+
+HandlerKey NonblockingKineticConnection::GetToFile(const string key, int fd, off_t offset,
+        const shared_ptr<GetIntoCallbackInterface> callback) {
+    return this->GetToFile(make_shared<string>(key), fd, offset, callback);
+}
+
 HandlerKey NonblockingKineticConnection::GetNext(const shared_ptr<const string> key,
     const shared_ptr<GetCallbackInterface> callback) {
     return GenericGet(key, callback, Command_MessageType_GETNEXT);
@@ -294,13 +405,13 @@ HandlerKey NonblockingKineticConnection::GetPrevious(const string key,
 HandlerKey NonblockingKineticConnection::GetVersion(const shared_ptr<const string> key,
     const shared_ptr<GetVersionCallbackInterface> callback) {
     unique_ptr<GetVersionHandler> handler(new GetVersionHandler(callback));
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_GETVERSION);
     request->mutable_body()->mutable_keyvalue()->set_key(*key);
 
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::GetVersion(const string key,
@@ -317,7 +428,7 @@ HandlerKey NonblockingKineticConnection::GetKeyRange(const shared_ptr<const stri
         const shared_ptr<GetKeyRangeCallbackInterface> callback) {
     unique_ptr<GetKeyRangeHandler> handler(new GetKeyRangeHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_GETKEYRANGE);
@@ -328,7 +439,7 @@ HandlerKey NonblockingKineticConnection::GetKeyRange(const shared_ptr<const stri
     request->mutable_body()->mutable_range()->set_reverse(reverse_results);
     request->mutable_body()->mutable_range()->set_maxreturned(max_results);
 
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::GetKeyRange(const string start_key,
@@ -349,7 +460,7 @@ HandlerKey NonblockingKineticConnection::Put(const shared_ptr<const string> key,
     PersistMode persistMode) {
     unique_ptr<PutHandler> handler(new PutHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_PUT);
@@ -372,7 +483,7 @@ HandlerKey NonblockingKineticConnection::Put(const shared_ptr<const string> key,
     request->mutable_body()->mutable_keyvalue()->set_synchronization(
             this->GetSynchronizationForPersistMode(persistMode));
 
-    return service_->Submit(move(msg), move(request), record->value(), move(handler));
+    return service_->Submit(move(msg), move(request), record->packet_value(), move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::Put(const string key,
@@ -408,7 +519,7 @@ HandlerKey NonblockingKineticConnection::Delete(const shared_ptr<const string> k
     PersistMode persistMode) {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_DELETE);
@@ -421,7 +532,7 @@ HandlerKey NonblockingKineticConnection::Delete(const shared_ptr<const string> k
     request->mutable_body()->mutable_keyvalue()->set_synchronization(
             this->GetSynchronizationForPersistMode(persistMode));
 
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::Delete(const string key, const string version,
@@ -448,14 +559,14 @@ HandlerKey NonblockingKineticConnection::SecureErase(const shared_ptr<string> pi
         const shared_ptr<SimpleCallbackInterface> callback) {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_PINAUTH);
     if(pin) msg->mutable_pinauth()->set_pin(*pin);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_PINOP);
     request->mutable_body()->mutable_pinop()->set_pinoptype(Command_PinOperation_PinOpType_SECURE_ERASE_PINOP);
 
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SecureErase(const string pin,
@@ -467,14 +578,14 @@ HandlerKey NonblockingKineticConnection::InstantErase(const shared_ptr<string> p
         const shared_ptr<SimpleCallbackInterface> callback) {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_PINAUTH);
     if(pin) msg->mutable_pinauth()->set_pin(*pin);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_PINOP);
     request->mutable_body()->mutable_pinop()->set_pinoptype(Command_PinOperation_PinOpType_ERASE_PINOP);
 
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::InstantErase(const string pin,
@@ -487,13 +598,13 @@ HandlerKey NonblockingKineticConnection::LockDevice(const shared_ptr<string> pin
 {
    unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-   unique_ptr<Message> msg(new Message());
+   unique_ptr<Message> msg = NewMessage();
    msg->set_authtype(Message_AuthType_PINAUTH);
    if(pin) msg->mutable_pinauth()->set_pin(*pin);
 
    unique_ptr<Command> request = NewCommand(Command_MessageType_PINOP);
    request->mutable_body()->mutable_pinop()->set_pinoptype(Command_PinOperation_PinOpType_LOCK_PINOP);
-   return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+   return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 
 
 }
@@ -508,13 +619,13 @@ HandlerKey NonblockingKineticConnection::UnlockDevice(const shared_ptr<string> p
 {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_PINAUTH);
     if(pin) msg->mutable_pinauth()->set_pin(*pin);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_PINOP);
     request->mutable_body()->mutable_pinop()->set_pinoptype(Command_PinOperation_PinOpType_UNLOCK_PINOP);
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::UnlockDevice(const string pin,
@@ -527,25 +638,35 @@ HandlerKey NonblockingKineticConnection::GenericGet(const shared_ptr<const strin
     const shared_ptr<GetCallbackInterface> callback, Command_MessageType message_type) {
     unique_ptr<GetHandler> handler(new GetHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(message_type);
 
     request->mutable_body()->mutable_keyvalue()->set_key(*key);
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
+}
+
+HandlerKey NonblockingKineticConnection::SubmitGetInto(const shared_ptr<const string> key,
+    unique_ptr<GetIntoHandler> handler) {
+    unique_ptr<Message> msg = NewMessage();
+    msg->set_authtype(Message_AuthType_HMACAUTH);
+    unique_ptr<Command> request = NewCommand(Command_MessageType_GET);
+
+    request->mutable_body()->mutable_keyvalue()->set_key(*key);
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SetClusterVersion(int64_t new_cluster_version,
     const shared_ptr<SimpleCallbackInterface> callback) {
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(Command_MessageType_SETUP);
 
     request->mutable_body()->mutable_setup()->set_newclusterversion(
             new_cluster_version);
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::GetLog(
@@ -565,7 +686,7 @@ HandlerKey NonblockingKineticConnection::GetLog(
 HandlerKey NonblockingKineticConnection::GetLog(const vector<Command_GetLog_Type>& types,
         const shared_ptr<GetLogCallbackInterface> callback) {
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(Command_MessageType_GETLOG);
 
@@ -575,27 +696,27 @@ HandlerKey NonblockingKineticConnection::GetLog(const vector<Command_GetLog_Type
     }
 
     unique_ptr<GetLogHandler> handler(new GetLogHandler(callback));
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::UpdateFirmware(
         const shared_ptr<const string> new_firmware,
         const shared_ptr<SimpleCallbackInterface> callback) {
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(Command_MessageType_SETUP);
 
     request->mutable_body()->mutable_setup()->set_firmwaredownload(true);
 
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
-    return service_->Submit(move(msg), move(request), new_firmware, move(handler));
+    return service_->Submit(move(msg), move(request), PacketValue(new_firmware), move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SetACLs(const shared_ptr<const list<ACL>> acls,
         const shared_ptr<SimpleCallbackInterface> callback) {
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(Command_MessageType_SECURITY);
 
@@ -648,13 +769,13 @@ HandlerKey NonblockingKineticConnection::SetACLs(const shared_ptr<const list<ACL
     }
 
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SetLockPIN(const shared_ptr<const string> new_pin, const shared_ptr<const string> current_pin,
         const shared_ptr<SimpleCallbackInterface> callback)
 {
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_SECURITY);
@@ -664,7 +785,7 @@ HandlerKey NonblockingKineticConnection::SetLockPIN(const shared_ptr<const strin
         request->mutable_body()->mutable_security()->set_newlockpin(*new_pin);
 
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SetLockPIN(const string new_pin, const string current_pin,
@@ -677,7 +798,7 @@ HandlerKey NonblockingKineticConnection::SetErasePIN(const shared_ptr<const stri
     const shared_ptr<const string> current_pin,
     const shared_ptr<SimpleCallbackInterface> callback)
 {
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
 
     unique_ptr<Command> request = NewCommand(Command_MessageType_SECURITY);
@@ -687,7 +808,7 @@ HandlerKey NonblockingKineticConnection::SetErasePIN(const shared_ptr<const stri
         request->mutable_body()->mutable_security()->set_newerasepin(*new_pin);
 
     unique_ptr<SimpleHandler> handler(new SimpleHandler(callback));
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 HandlerKey NonblockingKineticConnection::SetErasePIN(const string new_pin, const string current_pin,
@@ -726,7 +847,7 @@ HandlerKey NonblockingKineticConnection::P2PPush(
         const shared_ptr<const P2PPushRequest> push_request,
         const shared_ptr<P2PPushCallbackInterface> callback) {
 
-    unique_ptr<Message> msg(new Message());
+    unique_ptr<Message> msg = NewMessage();
     msg->set_authtype(Message_AuthType_HMACAUTH);
     unique_ptr<Command> request = NewCommand(Command_MessageType_PEER2PEERPUSH);
 
@@ -734,13 +855,21 @@ HandlerKey NonblockingKineticConnection::P2PPush(
     PopulateP2PMessage(mutable_p2pop, push_request);
 
     unique_ptr<P2PPushHandler> handler(new P2PPushHandler(callback));
-    return service_->Submit(move(msg), move(request), empty_str_, move(handler));
+    return service_->Submit(move(msg), move(request), empty_value_, move(handler));
 }
 
 bool NonblockingKineticConnection::RemoveHandler(HandlerKey handler_key) {
     return service_->Remove(handler_key);
 }
 
+void NonblockingKineticConnection::SetSubmitListener(std::function<void()> listener) {
+    service_->SetSubmitListener(listener);
+}
+
+void NonblockingKineticConnection::SetCompletionExecutor(shared_ptr<ExecutorInterface> executor) {
+    service_->SetCompletionExecutor(executor);
+}
+
 Command_Synchronization NonblockingKineticConnection::GetSynchronizationForPersistMode(PersistMode persistMode) {
     Command_Synchronization sync_option;
     switch (persistMode) {
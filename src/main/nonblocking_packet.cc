@@ -16,220 +16,762 @@
  */
 
 #include "nonblocking_packet.h"
+#include <errno.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <netinet/tcp.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <time.h>
+#endif
+
+#include <algorithm>
 
 #include "glog/logging.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite_inl.h>
 
 namespace kinetic {
 
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+using com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH;
+using com::seagate::kinetic::client::proto::Message_HMACauth;
+
 using std::make_shared;
 using std::string;
+using std::vector;
+
+// Magic byte plus the two 4-byte big-endian lengths
+static const size_t kHeaderSize = 9;
+// How much the packet reader asks the socket for at a time
+static const size_t kReceiveBufferSize = 64 * 1024;
+// Values with at least this much left to read bypass the receive buffer. Below
+// it, going through the buffer is worth the copy because the same call can
+// pick up the responses that follow.
+static const size_t kDirectReadThreshold = 16 * 1024;
+// How much of a file value is read into memory at a time when it can't be
+// handed to sendfile
+static const size_t kFileChunkSize = 64 * 1024;
+// Most pieces of a packet passed to a single writev or sendmsg. A sliced value
+// with more slices than this goes out over several calls.
+const int NonblockingPacketWriter::kMaxIovecs;
+const size_t TlsRecordBuffer::kRecordSize;
+
+TlsRecordBuffer::TlsRecordBuffer(shared_ptr<SocketWrapperInterface> socket_wrapper)
+    : socket_wrapper_(socket_wrapper), buffer_(), flushing_(false) {
+    buffer_.reserve(kRecordSize);
+}
+
+size_t TlsRecordBuffer::Append(const char *data, size_t length) {
+    if (full()) {
+        return 0;
+    }
+    size_t count = std::min(length, kRecordSize - buffer_.size());
+    buffer_.insert(buffer_.end(), data, data + count);
+    return count;
+}
+
+NonblockingStringStatus TlsRecordBuffer::Flush() {
+    if (buffer_.empty()) {
+        return kDone;
+    }
+    flushing_ = true;
+    int result = SSL_write(socket_wrapper_->getSSL(), buffer_.data(), buffer_.size());
+    if (result <= 0) {
+        int err = SSL_get_error(socket_wrapper_->getSSL(), result);
+        return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ? kInProgress : kFailed;
+    }
+    // Without SSL_MODE_ENABLE_PARTIAL_WRITE success means all of it went out
+    CHECK_EQ(buffer_.size(), static_cast<size_t>(result));
+    buffer_.clear();
+    flushing_ = false;
+    return kDone;
+}
 
 NonblockingPacketWriter::NonblockingPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<const Message> message,
-    const shared_ptr<const string> value)
-    : socket_wrapper_(socket_wrapper), message_(move(message)), value_(value), state_(kMagic),
-    writer_(new NonblockingStringWriter(socket_wrapper_, make_shared<string>("F"))) {}
+    const PacketValue& value, shared_ptr<ZerocopyTracker> zerocopy, shared_ptr<TlsRecordBuffer> record_buffer)
+    : socket_wrapper_(socket_wrapper), message_(move(message)), value_(value),
+    ssl_write_(socket_wrapper_->getSSL() && !socket_wrapper_->ktls_send()), zerocopy_(),
+    record_buffer_(ssl_write_ ? record_buffer : shared_ptr<TlsRecordBuffer>()), header_and_message_(), bytes_written_(0), file_chunk_(), file_chunk_start_(0), file_chunk_end_(0) {
+    // The kernel's TLS layer doesn't take MSG_ZEROCOPY, so kTLS doesn't help here
+    if (zerocopy && !value_.is_file() && zerocopy->ShouldUse(value_.size()) &&
+            !socket_wrapper_->getSSL() && socket_wrapper_->is_socket()) {
+        zerocopy_ = zerocopy;
+    }
+}
+
+NonblockingPacketWriter::NonblockingPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<string> packet,
+    const PacketValue& value, shared_ptr<ZerocopyTracker> zerocopy, shared_ptr<TlsRecordBuffer> record_buffer)
+    : NonblockingPacketWriter(socket_wrapper, unique_ptr<const Message>(), value, zerocopy, record_buffer) {
+    packet_ = move(packet);
+    header_and_message_.swap(*packet_);
+}
 
-NonblockingPacketWriter::~NonblockingPacketWriter() {
-    if (writer_ != NULL) {
-        delete writer_;
+unique_ptr<string> NonblockingPacketWriter::TakePacket() {
+    if (packet_) {
+        packet_->swap(header_and_message_);
     }
+    return move(packet_);
 }
 
 NonblockingStringStatus NonblockingPacketWriter::Write() {
-    struct stat statbuf;
-    if (fstat(socket_wrapper_->fd(), &statbuf)) {
-        PLOG(ERROR) << "Unable to fstat socket";
+    // An encoded packet that came in empty couldn't be encoded
+    if (header_and_message_.empty() && (!message_ || !Serialize())) {
         return kFailed;
     }
-#ifndef __APPLE__
-    if (S_ISSOCK(statbuf.st_mode)) {
-        int optval = 1;
-        setsockopt(socket_wrapper_->fd(), IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
-    }
-#endif
 
-    while (true) {
-        NonblockingStringStatus status = writer_->Write();
-        if (status != kDone) {
-            return status;
+    size_t total_size = header_and_message_.size() + value_.size();
+    while (bytes_written_ < total_size) {
+        NonblockingStringStatus ssl_status = kInProgress;
+        ssize_t status;
+        if (ssl_write_) {
+            status = WriteSSL(&ssl_status);
+        } else if (value_.is_file() && bytes_written_ >= header_and_message_.size()) {
+            status = WriteFilePlain();
+        } else {
+            status = WritePlain();
         }
-
-        // Transition to the next state
-        switch (state_) {
-            case kMagic:
-                if (!TransitionFromMagic()) {
-                    return kFailed;
-                }
-                break;
-            case kMessageLength:
-                TransitionFromMessageLength();
-                break;
-            case kValueLength:
-                TransitionFromValueLength();
-                break;
-            case kMessage:
-                TransitionFromMessage();
-                break;
-            case kValue:
-                TransitionFromValue();
-                break;
-            case kFinished:
-                if (fstat(socket_wrapper_->fd(), &statbuf)) {
-                    PLOG(ERROR) << "Unable to fstat socket";
-                    return kFailed;
-                }
-                if (S_ISSOCK(statbuf.st_mode)) {
-                    int optval = 0;
-#ifndef __APPLE__
-                    setsockopt(socket_wrapper_->fd(), IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
-#endif
-                    optval = 1;
-                    setsockopt(socket_wrapper_->fd(), IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
-                }
-                return kDone;
-            default:
-                CHECK(false);
+        if (status == 0) {
+            return kFailed;
+        }
+        if (status < 0) {
+            if (ssl_write_) {
+                return ssl_status;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return kInProgress;
+            }
+            return kFailed;
         }
+        bytes_written_ += status;
     }
+
+    CHECK_EQ(bytes_written_, total_size);
+    return kDone;
 }
 
-bool NonblockingPacketWriter::TransitionFromMagic() {
-    // Move on to the writing the message length
-    if (!message_->SerializeToString(&serialized_message_)) {
-        // Serialization can fail if the message is missing required fields
+static void WriteHeader(char *buf, size_t message_size, size_t value_size) {
+    buf[0] = 'F';
+    uint32_t size = htonl(message_size);
+    memcpy(buf + 1, &size, sizeof(size));
+    size = htonl(value_size);
+    memcpy(buf + 5, &size, sizeof(size));
+}
+
+bool NonblockingPacketWriter::Serialize() {
+    int message_size = message_->ByteSize();
+    header_and_message_.resize(kHeaderSize + message_size);
+    char *buf = &header_and_message_[0];
+    WriteHeader(buf, message_size, value_.size());
+
+    // Serialization can fail if the message is missing required fields
+    return message_->SerializeToArray(buf + kHeaderSize, message_size);
+}
+
+bool EncodeRequest(const Message& envelope, const Command& command, size_t value_size, int64_t identity,
+    const HmacProviderInterface& hmac_provider, const string& hmac_key, string *packet) {
+    DCHECK(!envelope.has_commandbytes() && !envelope.has_hmacauth());
+    packet->clear();
+    if (!envelope.IsInitialized() || !command.IsInitialized()) {
         return false;
     }
-    uint32_t size = htonl(serialized_message_.size());
-    delete writer_;
-    std::string encoded_size(reinterpret_cast<char *>(&size), sizeof(size));
-    writer_ = new NonblockingStringWriter(socket_wrapper_, make_shared<string>(encoded_size));
-    state_ = kMessageLength;
+
+    // ByteSize caches the sizes that SerializeWithCachedSizesToArray relies on
+    int envelope_size = envelope.ByteSize();
+    int command_size = command.ByteSize();
+    size_t command_offset = kHeaderSize + envelope_size +
+        WireFormatLite::TagSize(Message::kCommandBytesFieldNumber, WireFormatLite::TYPE_BYTES) +
+        CodedOutputStream::VarintSize32(command_size);
+    packet->resize(command_offset + command_size);
+
+    uint8_t *target = reinterpret_cast<uint8_t *>(&(*packet)[kHeaderSize]);
+    target = envelope.SerializeWithCachedSizesToArray(target);
+    target = WireFormatLite::WriteTagToArray(Message::kCommandBytesFieldNumber,
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED, target);
+    target = CodedOutputStream::WriteVarint32ToArray(command_size, target);
+    command.SerializeWithCachedSizesToArray(target);
+
+    if (envelope.authtype() == Message_AuthType_HMACAUTH) {
+        string hmac = hmac_provider.ComputeCommandHmac(packet->data() + command_offset, command_size,
+            hmac_key);
+        int auth_size = WireFormatLite::TagSize(Message_HMACauth::kIdentityFieldNumber, WireFormatLite::TYPE_INT64) +
+            WireFormatLite::Int64Size(identity) +
+            WireFormatLite::TagSize(Message_HMACauth::kHmacFieldNumber, WireFormatLite::TYPE_BYTES) +
+            WireFormatLite::BytesSize(hmac);
+        size_t auth_offset = packet->size();
+        packet->resize(auth_offset +
+            WireFormatLite::TagSize(Message::kHmacAuthFieldNumber, WireFormatLite::TYPE_MESSAGE) +
+            WireFormatLite::LengthDelimitedSize(auth_size));
+
+        target = reinterpret_cast<uint8_t *>(&(*packet)[auth_offset]);
+        target = WireFormatLite::WriteTagToArray(Message::kHmacAuthFieldNumber,
+            WireFormatLite::WIRETYPE_LENGTH_DELIMITED, target);
+        target = CodedOutputStream::WriteVarint32ToArray(auth_size, target);
+        target = WireFormatLite::WriteInt64ToArray(Message_HMACauth::kIdentityFieldNumber, identity, target);
+        WireFormatLite::WriteBytesToArray(Message_HMACauth::kHmacFieldNumber, hmac, target);
+    }
+
+    WriteHeader(&(*packet)[0], packet->size() - kHeaderSize, value_size);
     return true;
 }
 
-void NonblockingPacketWriter::TransitionFromMessageLength() {
-    // Move on to writing the value length
-    uint32_t size = htonl(value_->size());
-    delete writer_;
-    std::string encoded_size(reinterpret_cast<char *>(&size), sizeof(size));
-    writer_ = new NonblockingStringWriter(socket_wrapper_, make_shared<string>(encoded_size));
-    state_ = kValueLength;
+ssize_t NonblockingPacketWriter::WritePlain() {
+    struct iovec iov[kMaxIovecs];
+    int iovcnt = 0;
+
+    size_t header_size = header_and_message_.size();
+    if (bytes_written_ < header_size) {
+        iov[iovcnt].iov_base = &header_and_message_[bytes_written_];
+        iov[iovcnt].iov_len = header_size - bytes_written_;
+        iovcnt++;
+    }
+    size_t value_offset = bytes_written_ > header_size ? bytes_written_ - header_size : 0;
+    // File values follow the header separately, see WriteFilePlain, and so do
+    // zerocopy values since the header buffer goes away with the writer
+    bool zerocopy = zerocopy_ && iovcnt == 0;
+    if (!value_.is_file() && (!zerocopy_ || zerocopy)) {
+        iovcnt += ValueIovecs(value_offset, iov + iovcnt, kMaxIovecs - iovcnt);
+    }
+
+    // Tests use pipes rather than sockets, and sendmsg only works on sockets.
+    // The socket wrapper knows which kind of FD it holds so we don't have to
+    // fstat it on every write.
+    if (!socket_wrapper_->is_socket()) {
+        return writev(socket_wrapper_->fd(), iov, iovcnt);
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+
+    int flags = 0;
+    // Prevent sending SIGPIPE signal on Linux. SIGPIPE is undesirable because the library
+    // client will crash if the remote server closes the connection.
+    #ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+    #endif
+    #ifdef MSG_ZEROCOPY
+    if (zerocopy) {
+        // Let go of whatever the kernel has finished sending first so the
+        // socket's budget for pinned pages isn't used up
+        zerocopy_->Reap();
+        ssize_t result = sendmsg(socket_wrapper_->fd(), &msg, flags | MSG_ZEROCOPY);
+        if (result > 0) {
+            zerocopy_->Sent(value_);
+            return result;
+        }
+        if (result == 0 || errno != ENOBUFS) {
+            return result;
+        }
+        // Out of budget for pinned pages; an ordinary copy still works
+    }
+    #endif
+    return sendmsg(socket_wrapper_->fd(), &msg, flags);
+}
+
+// Points up to max iovecs at the rest of a string or sliced value, starting
+// value_offset bytes in, and returns how many were used
+int NonblockingPacketWriter::ValueIovecs(size_t value_offset, struct iovec *iov, int max) const {
+    if (value_offset >= value_.size() || max == 0) {
+        return 0;
+    }
+    if (!value_.is_slices()) {
+        const string &value = *value_.string_value();
+        iov[0].iov_base = const_cast<char *>(value.data() + value_offset);
+        iov[0].iov_len = value.size() - value_offset;
+        return 1;
+    }
+
+    int iovcnt = 0;
+    const vector<ValueSlice> &slices = value_.slices();
+    for (auto it = slices.begin(); it != slices.end() && iovcnt < max; ++it) {
+        if (value_offset >= it->length) {
+            // Already written, or empty
+            value_offset -= it->length;
+            continue;
+        }
+        iov[iovcnt].iov_base = const_cast<char *>(it->data + value_offset);
+        iov[iovcnt].iov_len = it->length - value_offset;
+        value_offset = 0;
+        iovcnt++;
+    }
+    return iovcnt;
 }
 
-void NonblockingPacketWriter::TransitionFromValueLength() {
-    // Move on to writing the serialized message
-    delete writer_;
-    writer_ = new NonblockingStringWriter(socket_wrapper_, make_shared<string>(serialized_message_));
-    state_ = kMessage;
+ssize_t NonblockingPacketWriter::WriteSSL(NonblockingStringStatus *status) {
+    if (record_buffer_ && record_buffer_->full()) {
+        *status = record_buffer_->Flush();
+        if (*status != kDone) {
+            return -1;
+        }
+    }
+
+    // SSL_write has no vectored variant, so write the header and message
+    // followed by the value
+    const char *data;
+    size_t length;
+    size_t header_size = header_and_message_.size();
+    if (bytes_written_ < header_size) {
+        data = header_and_message_.data() + bytes_written_;
+        length = header_size - bytes_written_;
+    } else if (value_.is_file()) {
+        // A retried SSL_write must be passed the same data, which holds since
+        // the chunk isn't refilled until all of it has been written
+        if (!FillFileChunk()) {
+            *status = kFailed;
+            return -1;
+        }
+        data = file_chunk_.data() + file_chunk_start_;
+        length = file_chunk_end_ - file_chunk_start_;
+    } else {
+        struct iovec iov;
+        CHECK_EQ(1, ValueIovecs(bytes_written_ - header_size, &iov, 1));
+        data = static_cast<const char *>(iov.iov_base);
+        length = iov.iov_len;
+    }
+
+    ssize_t result;
+    if (record_buffer_ && (length < TlsRecordBuffer::kRecordSize || !record_buffer_->empty())) {
+        // Gather small pieces, and top up what's already buffered, into
+        // full records. The buffer can't be full at this point.
+        result = record_buffer_->Append(data, length);
+    } else {
+        // At least a full record's worth, which gains nothing from a copy.
+        // A retry comes back here with the same data since nothing has been
+        // buffered in the meantime.
+        result = SSL_write(socket_wrapper_->getSSL(), data, length);
+        if (result <= 0) {
+            int err = SSL_get_error(socket_wrapper_->getSSL(), result);
+            *status = (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ?
+                kInProgress : kFailed;
+            return -1;
+        }
+    }
+    if (bytes_written_ >= header_size && value_.is_file()) {
+        file_chunk_start_ += result;
+    }
+    return result;
 }
 
-void NonblockingPacketWriter::TransitionFromMessage() {
-    // Move on to writing the value
-    delete writer_;
-    writer_ = new NonblockingStringWriter(socket_wrapper_, value_);
-    state_ = kValue;
+ssize_t NonblockingPacketWriter::WriteFilePlain() {
+    size_t value_offset = bytes_written_ - header_and_message_.size();
+#ifdef __linux__
+    // The kernel copies the file to the socket itself, so the value never
+    // passes through our memory. A short file shows up as a return of 0.
+    off_t offset = value_.offset() + value_offset;
+
+    // sendfile has no equivalent of MSG_NOSIGNAL, so block SIGPIPE around the
+    // call and discard the one it raises if the server has gone away
+    sigset_t sigpipe_set, old_set;
+    sigemptyset(&sigpipe_set);
+    sigaddset(&sigpipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_set);
+    ssize_t result = sendfile(socket_wrapper_->fd(), value_.fd(), &offset,
+        value_.size() - value_offset);
+    if (result < 0 && errno == EPIPE) {
+        int saved_errno = errno;
+        struct timespec no_wait = {0, 0};
+        while (sigtimedwait(&sigpipe_set, NULL, &no_wait) == -1 && errno == EINTR) {}
+        errno = saved_errno;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return result;
+#else
+    if (!FillFileChunk()) {
+        return -1;
+    }
+    ssize_t result = write(socket_wrapper_->fd(), file_chunk_.data() + file_chunk_start_,
+        file_chunk_end_ - file_chunk_start_);
+    if (result > 0) {
+        file_chunk_start_ += result;
+    }
+    return result;
+#endif
 }
 
-void NonblockingPacketWriter::TransitionFromValue() {
-    // We're done!
-    state_ = kFinished;
+bool NonblockingPacketWriter::FillFileChunk() {
+    if (file_chunk_start_ < file_chunk_end_) {
+        return true;
+    }
+    if (file_chunk_.empty()) {
+        file_chunk_.resize(kFileChunkSize);
+    }
+
+    size_t value_offset = bytes_written_ - header_and_message_.size();
+    size_t length = std::min(kFileChunkSize, value_.size() - value_offset);
+    ssize_t result;
+    do {
+        result = pread(value_.fd(), file_chunk_.data(), length, value_.offset() + value_offset);
+    } while (result < 0 && errno == EINTR);
+    if (result <= 0) {
+        if (result == 0) {
+            // The file ended before the value did
+            errno = EIO;
+        }
+        PLOG(WARNING) << "Failed to read value from file";
+        return false;
+    }
+    file_chunk_start_ = 0;
+    file_chunk_end_ = result;
+    return true;
 }
 
 NonblockingPacketReader::NonblockingPacketReader(shared_ptr<SocketWrapperInterface> socket_wrapper, Message* response,
-        unique_ptr<const string> &value)
-    : socket_wrapper_(socket_wrapper), response_(response), state_(kMagic), value_(value), magic_(),
-    reader_(new NonblockingStringReader(socket_wrapper_, 1, magic_)) {
+        unique_ptr<const string> &value, ValueSinkProviderInterface *value_sink_provider)
+    : socket_wrapper_(socket_wrapper), response_(response), value_(value),
+    value_sink_provider_(value_sink_provider), source_(NULL), state_(kHeader),
+    buffer_(kReceiveBufferSize), buffer_start_(0), buffer_end_(0), message_length_(0),
+    value_length_(0), value_buffer_(), value_destination_(NULL), value_received_(0),
+    value_fd_(-1), value_file_offset_(0), value_sink_failed_(false), pipe_bytes_(0) {
+    pipe_fds_[0] = pipe_fds_[1] = -1;
 }
 
 NonblockingPacketReader::~NonblockingPacketReader() {
-    if (reader_ != NULL) {
-        delete reader_;
+    if (pipe_fds_[0] != -1) {
+        close(pipe_fds_[0]);
+        close(pipe_fds_[1]);
     }
 }
 
 NonblockingStringStatus NonblockingPacketReader::Read() {
-    while (true) {
-        NonblockingStringStatus status = reader_->Read();
-        if (status != kDone) {
-            return status;
-        }
+    // Set once a read comes back short. The socket has nothing more for us at
+    // that point, so there's no sense making another call just to get EAGAIN.
+    bool drained = false;
+    size_t needed;
 
-        // Transition to the next state
+    while (true) {
         switch (state_) {
-            case kMagic:
-                if (!TransitionFromMagic()) {
+            case kHeader:
+                // Reject a bad magic byte without waiting for the rest of the header
+                if (buffered() > 0 && buffer_[buffer_start_] != 'F') {
                     return kFailed;
                 }
-                break;
-            case kMessageLength:
-                TransitionFromMessageLength();
-                break;
-            case kValueLength:
-                TransitionFromValueLength();
+                if (buffered() >= kHeaderSize) {
+                    ParseHeader();
+                    continue;
+                }
+                needed = kHeaderSize;
                 break;
             case kMessage:
-                TransitionFromMessage();
-                break;
-            case kValue:
-                if (!TransitionFromValue()) {
-                    return kFailed;
+                if (buffered() >= message_length_) {
+                    if (!response_->ParseFromArray(buffer_.data() + buffer_start_, message_length_)) {
+                        return kFailed;
+                    }
+                    buffer_start_ += message_length_;
+                    ValueSink sink;
+                    if (value_sink_provider_ == NULL || value_length_ == 0 ||
+                            !value_sink_provider_->GetValueSink(*response_, value_length_, &sink)) {
+                        value_buffer_.reset(new string(value_length_, '\0'));
+                        sink.buffer = &(*value_buffer_)[0];
+                    }
+                    value_destination_ = sink.buffer;
+                    value_fd_ = sink.fd;
+                    value_file_offset_ = sink.file_offset;
+                    value_sink_failed_ = false;
+                    value_received_ = 0;
+                    state_ = kValue;
+                    continue;
                 }
+                needed = message_length_;
                 break;
-            case kFinished:
-                return kDone;
+            case kValue: {
+                if (value_fd_ != -1) {
+                    NonblockingStringStatus status = ReadValueToFile(&drained);
+                    if (status != kDone) {
+                        return status;
+                    }
+                    value_fd_ = -1;
+                    value_.reset();
+                    state_ = kHeader;
+                    return kDone;
+                }
+                size_t length = std::min(buffered(), value_length_ - value_received_);
+                if (value_destination_ != NULL) {
+                    memcpy(value_destination_ + value_received_, buffer_.data() + buffer_start_, length);
+                }
+                buffer_start_ += length;
+                value_received_ += length;
+                if (value_received_ == value_length_) {
+                    // value_buffer_ is empty if the value went to the provider's sink
+                    value_ = move(value_buffer_);
+                    value_destination_ = NULL;
+                    state_ = kHeader;
+                    return kDone;
+                }
+                if (value_destination_ != NULL &&
+                        value_length_ - value_received_ >= kDirectReadThreshold) {
+                    // Large values skip the receive buffer and are read
+                    // straight into the string that goes to the caller
+                    if (drained) {
+                        return kInProgress;
+                    }
+                    size_t received;
+                    NonblockingStringStatus status = ReceiveInto(value_destination_ + value_received_,
+                        value_length_ - value_received_, &received, &drained);
+                    if (status != kDone) {
+                        return status;
+                    }
+                    value_received_ += received;
+                    continue;
+                }
+                needed = 1;
                 break;
+            }
             default:
                 CHECK(false);
         }
+
+        if (drained) {
+            return kInProgress;
+        }
+        NonblockingStringStatus status = Fill(needed, &drained);
+        if (status != kDone) {
+            return status;
+        }
+    }
+}
+
+void NonblockingPacketReader::DropValueSink() {
+    if (state_ != kValue || value_buffer_) {
+        return;
     }
+    // Whoever supplied the sink no longer wants the value, so throw the rest
+    // of it away as it arrives
+    DiscardPipe();
+    value_fd_ = -1;
+    value_destination_ = NULL;
 }
 
-bool NonblockingPacketReader::TransitionFromMagic() {
-    // Check the magic byte and move on to reading the message length
-    if (*magic_ != "F") {
+// Returns kDone once the whole value has been received and passed on to the
+// file. Failing to write the file doesn't stop us reading the value, since the
+// connection is fine and the responses behind it still need to be read.
+NonblockingStringStatus NonblockingPacketReader::ReadValueToFile(bool *drained) {
+    while (true) {
+        // Whatever came in with the message goes first
+        size_t length = std::min(buffered(), value_length_ - value_received_);
+        if (length > 0) {
+            WriteValueToFile(buffer_.data() + buffer_start_, length, value_received_);
+            buffer_start_ += length;
+            value_received_ += length;
+        }
+        if (value_received_ == value_length_ && pipe_bytes_ == 0) {
+            return kDone;
+        }
+
+#ifdef __linux__
+        // Once the kernel decrypts what's received, the socket can be spliced
+        if (source_ == NULL && (!socket_wrapper_->getSSL() || socket_wrapper_->ktls_receive()) &&
+                !value_sink_failed_ && OpenPipe()) {
+            NonblockingStringStatus status = Splice();
+            if (status != kDone) {
+                return status;
+            }
+            continue;
+        }
+#endif
+
+        // Copy through the receive buffer, which is all SSL allows
+        if (*drained) {
+            return kInProgress;
+        }
+        NonblockingStringStatus status = Fill(1, drained);
+        if (status != kDone) {
+            return status;
+        }
+    }
+}
+
+bool NonblockingPacketReader::OpenPipe() {
+#ifdef __linux__
+    if (pipe_fds_[0] == -1 && pipe2(pipe_fds_, O_CLOEXEC) != 0) {
+        // Copying through the receive buffer still works
+        PLOG(WARNING) << "Failed to create pipe to splice value through";
+        pipe_fds_[0] = pipe_fds_[1] = -1;
         return false;
     }
-    delete reader_;
-    reader_ = new NonblockingStringReader(socket_wrapper_, 4, message_length_);
-    state_ = kMessageLength;
     return true;
+#else
+    return false;
+#endif
+}
+
+NonblockingStringStatus NonblockingPacketReader::Splice() {
+#ifdef __linux__
+    if (pipe_bytes_ == 0) {
+        ssize_t result;
+        do {
+            result = splice(socket_wrapper_->fd(), NULL, pipe_fds_[1], NULL,
+                value_length_ - value_received_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } while (result < 0 && errno == EINTR);
+        if (result == 0) {
+            // Unexpected EOF
+            return kFailed;
+        }
+        if (result < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? kInProgress : kFailed;
+        }
+        pipe_bytes_ = result;
+        value_received_ += result;
+    }
+
+    while (pipe_bytes_ > 0) {
+        loff_t offset = value_file_offset_ + (value_received_ - pipe_bytes_);
+        ssize_t result = splice(pipe_fds_[0], NULL, value_fd_, &offset, pipe_bytes_, SPLICE_F_MOVE);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && errno == EINVAL) {
+            // Some files (O_APPEND, some filesystems) can't be spliced into, so
+            // copy what's in the pipe out by hand
+            CopyPipeToFile();
+            break;
+        }
+        if (result <= 0) {
+            PLOG(WARNING) << "Failed to write value to file";
+            value_sink_failed_ = true;
+            DiscardPipe();
+            break;
+        }
+        pipe_bytes_ -= result;
+    }
+#endif
+    return kDone;
+}
+
+// position is relative to the start of the value
+void NonblockingPacketReader::WriteValueToFile(const char *data, size_t length, size_t position) {
+    off_t offset = value_file_offset_ + position;
+    while (length > 0 && !value_sink_failed_) {
+        ssize_t result = pwrite(value_fd_, data, length, offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            PLOG(WARNING) << "Failed to write value to file";
+            value_sink_failed_ = true;
+            break;
+        }
+        data += result;
+        length -= result;
+        offset += result;
+    }
+}
+
+void NonblockingPacketReader::CopyPipeToFile() {
+    char scratch[4096];
+    while (pipe_bytes_ > 0) {
+        ssize_t result = read(pipe_fds_[0], scratch, std::min(sizeof(scratch), pipe_bytes_));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_GT(result, 0);
+        WriteValueToFile(scratch, result, value_received_ - pipe_bytes_);
+        pipe_bytes_ -= result;
+    }
 }
 
-void NonblockingPacketReader::TransitionFromMessageLength() {
-    // Move on to reading the value length
-    delete reader_;
-    reader_ = new NonblockingStringReader(socket_wrapper_, 4, value_length_);
-    state_ = kValueLength;
+void NonblockingPacketReader::DiscardPipe() {
+    char scratch[4096];
+    while (pipe_bytes_ > 0) {
+        ssize_t result = read(pipe_fds_[0], scratch, std::min(sizeof(scratch), pipe_bytes_));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        // Bytes that made it into the pipe can always be read back out
+        CHECK_GT(result, 0);
+        pipe_bytes_ -= result;
+    }
 }
 
-void NonblockingPacketReader::TransitionFromValueLength() {
-    // Move on to reading the message
-    delete reader_;
-    CHECK_EQ(4u, message_length_->size());
-    uint32_t length = ntohl(*reinterpret_cast<const uint32_t *>(message_length_->data()));
-    reader_ = new NonblockingStringReader(socket_wrapper_, length, message_);
+void NonblockingPacketReader::ParseHeader() {
+    const char *header = buffer_.data() + buffer_start_;
+    memcpy(&message_length_, header + 1, sizeof(message_length_));
+    message_length_ = ntohl(message_length_);
+    memcpy(&value_length_, header + 5, sizeof(value_length_));
+    value_length_ = ntohl(value_length_);
+    buffer_start_ += kHeaderSize;
     state_ = kMessage;
 }
 
-void NonblockingPacketReader::TransitionFromMessage() {
-    // Move on to reading the value
-    delete reader_;
-    CHECK_EQ(4u, value_length_->size());
-    uint32_t length = ntohl(*reinterpret_cast<const uint32_t *>(value_length_->data()));
-    reader_ = new NonblockingStringReader(socket_wrapper_, length, value_);
-    state_ = kValue;
+NonblockingStringStatus NonblockingPacketReader::Fill(size_t needed, bool *drained) {
+    // Move any partial packet to the front so the rest of the buffer is free
+    // for the socket, and grow the buffer if a message won't fit in it
+    if (buffer_start_ > 0) {
+        memmove(buffer_.data(), buffer_.data() + buffer_start_, buffered());
+        buffer_end_ -= buffer_start_;
+        buffer_start_ = 0;
+    }
+    if (needed > buffer_.size()) {
+        buffer_.resize(needed);
+    }
+
+    size_t received;
+    NonblockingStringStatus status = ReceiveInto(buffer_.data() + buffer_end_,
+        buffer_.size() - buffer_end_, &received, drained);
+    if (status == kDone) {
+        buffer_end_ += received;
+    }
+    return status;
 }
 
-bool NonblockingPacketReader::TransitionFromValue() {
-    // We're done!
-    state_ = kFinished;
-    return response_->ParseFromString(*message_);
+NonblockingStringStatus NonblockingPacketReader::ReceiveInto(char *dest, size_t length, size_t *received,
+        bool *drained) {
+    if (source_ != NULL) {
+        ssize_t taken = source_->Take(dest, length);
+        if (taken < 0) {
+            return kFailed;
+        }
+        if (taken == 0) {
+            return kInProgress;
+        }
+        *received = taken;
+        *drained = source_->empty();
+        return kDone;
+    }
+
+    while (true) {
+        int status;
+        if (socket_wrapper_->getSSL() && !socket_wrapper_->ktls_receive()) {
+            status = SSL_read(socket_wrapper_->getSSL(), dest, length);
+            if (status <= 0) {
+                int err = SSL_get_error(socket_wrapper_->getSSL(), status);
+                return (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) ?
+                    kInProgress : kFailed;
+            }
+        } else {
+            status = read(socket_wrapper_->fd(), dest, length);
+            if (status == 0) {
+                // Unexpected EOF
+                return kFailed;
+            }
+            if (status < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return kInProgress;
+                }
+                return kFailed;
+            }
+            // Only trust short reads on plain sockets, or ones the kernel
+            // decrypts; SSL_read hands back at most one record per call
+            // whatever is waiting behind it
+            *drained = static_cast<size_t>(status) < length;
+        }
+        *received = status;
+        return kDone;
+    }
 }
 
 } // namespace kinetic
@@ -18,12 +18,18 @@
 #ifndef KINETIC_CPP_CLIENT_NONBLOCKING_PACKET_H_
 #define KINETIC_CPP_CLIENT_NONBLOCKING_PACKET_H_
 
+#include <sys/uio.h>
+
 #include <memory>
+#include <vector>
 
 #include "kinetic/common.h"
+#include "kinetic/hmac_provider.h"
+#include "kinetic/packet_value.h"
 
 #include "kinetic_client.pb.h"
 #include "nonblocking_string.h"
+#include "zerocopy_tracker.h"
 
 namespace kinetic {
 
@@ -31,80 +37,266 @@ using std::shared_ptr;
 using std::unique_ptr;
 using std::string;
 
+using com::seagate::kinetic::client::proto::Command;
 using com::seagate::kinetic::client::proto::Message;
 
 enum State {
-    kMagic,
-    kMessageLength,
-    kValueLength,
+    kHeader,
     kMessage,
-    kValue,
-    kFinished
+    kValue
 };
 
 class NonblockingPacketWriterInterface {
     public:
     virtual ~NonblockingPacketWriterInterface() {}
     virtual NonblockingStringStatus Write() = 0;
+    // Hands back the encoded packet once Write has returned kDone, so that its
+    // buffer can be reused. Writers that hold on to it return NULL.
+    virtual unique_ptr<string> TakePacket() { return unique_ptr<string>(); }
 };
 
+// Encodes a request into packet in one pass: the 9-byte header, envelope's
+// fields, then command serialized straight into place as the commandBytes
+// field. If envelope uses HMAC auth the HMAC is computed over the command
+// bytes where they lie and a hmacAuth field with identity is appended after
+// them; protobuf readers take fields in any order. Whatever packet held is
+// replaced but its capacity is kept, so a reused string rarely has to grow.
+// envelope must not have commandBytes or hmacAuth set. Returns false if either
+// message is missing required fields.
+bool EncodeRequest(const Message& envelope, const Command& command, size_t value_size, int64_t identity,
+    const HmacProviderInterface& hmac_provider, const string& hmac_key, string *packet);
+
+// Gathers what writers on a TLS connection send into TLS records of up to
+// 16 KiB. Without it every piece of a packet passed to SSL_write becomes a
+// record of its own, each with its own header, MAC and padding, and small
+// packets go out as several tiny records. There's one buffer per connection so
+// that consecutive small packets can share a record.
+//
+// Bytes added to the buffer aren't sent until it fills up or Flush is called.
+// Once SSL_write has been given the buffered bytes, nothing more can be added
+// until they've all gone out, since a retried SSL_write must be passed the
+// same data.
+class TlsRecordBuffer {
+    public:
+    // The most plaintext a single TLS record carries
+    static const size_t kRecordSize = 16 * 1024;
+    explicit TlsRecordBuffer(shared_ptr<SocketWrapperInterface> socket_wrapper);
+    // Copies up to length bytes of data into the buffer and returns how many
+    // were copied, which is 0 if the buffer is full or being written
+    size_t Append(const char *data, size_t length);
+    // Writes out whatever is buffered
+    NonblockingStringStatus Flush();
+    bool empty() const { return buffer_.empty(); }
+    // True if nothing more can be added until Flush succeeds
+    bool full() const { return flushing_ || buffer_.size() == kRecordSize; }
+
+    private:
+    shared_ptr<SocketWrapperInterface> socket_wrapper_;
+    std::vector<char> buffer_;
+    // Set once SSL_write has been called on buffer_ without finishing
+    bool flushing_;
+    DISALLOW_COPY_AND_ASSIGN(TlsRecordBuffer);
+};
+
+// Writes a single packet. The 9-byte header and the serialized message are
+// built into one buffer, or come already encoded by EncodeRequest, and are
+// then sent along with the value using vectored I/O,
+// so in the common case a whole packet goes out in a single system call. If
+// the socket only accepts part of the packet the writer remembers how far it
+// got and picks up from there on the next call to Write.
+// Sliced values get one iovec per slice, so they are never joined into a
+// single buffer. Values that are a range of a file are sent with sendfile
+// where it's available, and otherwise read and sent a bounded chunk at a time.
+// Over TLS the packet is copied into a TlsRecordBuffer so that it goes out in
+// as few records as possible; only runs of value of at least a full record are
+// passed straight to SSL_write. Write may then return kDone with part of the
+// packet still buffered. If the kernel is doing the encryption (kTLS) the
+// packet is written as on a plain socket.
+//
+// Given a ZerocopyTracker, large enough in-memory values on plain sockets are
+// sent with MSG_ZEROCOPY in calls of their own, after the header. The tracker
+// then holds on to the value until the kernel is done with it, which may be
+// well after the writer itself has gone.
 class NonblockingPacketWriter : public NonblockingPacketWriterInterface {
     public:
     NonblockingPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<const Message> message,
-            const shared_ptr<const string> value);
-    ~NonblockingPacketWriter();
+            const PacketValue& value, shared_ptr<ZerocopyTracker> zerocopy = shared_ptr<ZerocopyTracker>(),
+            shared_ptr<TlsRecordBuffer> record_buffer = shared_ptr<TlsRecordBuffer>());
+    // Writes packet, which holds the header and message as built by
+    // EncodeRequest
+    NonblockingPacketWriter(shared_ptr<SocketWrapperInterface> socket_wrapper, unique_ptr<string> packet,
+            const PacketValue& value, shared_ptr<ZerocopyTracker> zerocopy = shared_ptr<ZerocopyTracker>(),
+            shared_ptr<TlsRecordBuffer> record_buffer = shared_ptr<TlsRecordBuffer>());
     NonblockingStringStatus Write();
+    unique_ptr<string> TakePacket();
 
-    private:
-    bool TransitionFromMagic();
-    void TransitionFromMessageLength();
-    void TransitionFromValueLength();
-    void TransitionFromMessage();
-    void TransitionFromValue();
+    protected:
+    // The most iovecs a packet is split into for one send
+    static const int kMaxIovecs = 64;
+    bool Serialize();
+    ssize_t WritePlain();
+    int ValueIovecs(size_t value_offset, struct iovec *iov, int max) const;
+    ssize_t WriteFilePlain();
+    ssize_t WriteSSL(NonblockingStringStatus *status);
+    bool FillFileChunk();
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
     unique_ptr<const Message> message_;
-    const shared_ptr<const string> value_;
-    State state_;
-    NonblockingStringWriter *writer_;
-    std::string serialized_message_;
+    const PacketValue value_;
+    // Set if the packet has to go through SSL_write. TLS connections whose
+    // sends the kernel encrypts are written like plain ones.
+    const bool ssl_write_;
+    // NULL unless this packet's value goes out with MSG_ZEROCOPY
+    shared_ptr<ZerocopyTracker> zerocopy_;
+    // Where the packet is gathered into records if it goes through SSL_write.
+    // NULL to pass each piece to SSL_write as it is.
+    shared_ptr<TlsRecordBuffer> record_buffer_;
+    // Magic byte, message length, value length and serialized message
+    std::string header_and_message_;
+    // The string an encoded packet came in. Its contents are swapped into
+    // header_and_message_ while the packet is written and back by TakePacket.
+    unique_ptr<string> packet_;
+    size_t bytes_written_;
+    // Part of a file value that has been read but not yet written. Bytes in
+    // [file_chunk_start_, file_chunk_end_) are the next ones to send.
+    std::vector<char> file_chunk_;
+    size_t file_chunk_start_;
+    size_t file_chunk_end_;
     DISALLOW_COPY_AND_ASSIGN(NonblockingPacketWriter);
 };
 
+// Where a packet's value is read to instead of a new string: either memory
+// for the whole value, or a file the value is written to starting at
+// file_offset
+struct ValueSink {
+    ValueSink() : buffer(NULL), fd(-1), file_offset(0) {}
+    char *buffer;
+    int fd;
+    off_t file_offset;
+};
+
+// Where a NonblockingPacketReader gets its bytes when something other than the
+// reader itself is receiving from the socket
+class PacketSourceInterface {
+    public:
+    virtual ~PacketSourceInterface() {}
+    // Copies up to length bytes of what has been received into buf and returns
+    // how many were copied: 0 if nothing has arrived yet, or -1 if the
+    // connection has failed or been closed
+    virtual ssize_t Take(char *buf, size_t length) = 0;
+    // True if everything received so far has been taken
+    virtual bool empty() const = 0;
+};
+
+// Lets the owner of a NonblockingPacketReader choose where each value is read to
+class ValueSinkProviderInterface {
+    public:
+    virtual ~ValueSinkProviderInterface() {}
+    // Called once a packet's message has been read but before any of its value
+    // has. Returns false to have the value read into a new string as usual.
+    virtual bool GetValueSink(const Message& message, size_t value_length, ValueSink *sink) = 0;
+};
+
+// Reads packets from a connection. The reader is meant to live as long as the
+// connection: it keeps a receive buffer and asks the socket for as much as the
+// buffer can hold, so a single system call usually picks up several responses.
+// Each call to Read hands back one packet, and only goes to the socket once the
+// packets already sitting in the buffer have been handed back. If a packet's
+// value went to a sink supplied by the ValueSinkProviderInterface, value is set
+// to NULL when Read returns kDone.
+//
+// Values going to a file are spliced from the socket through a pipe on plain
+// Linux connections, and TLS ones the kernel decrypts, so they never pass
+// through our memory. Otherwise they go
+// through the receive buffer, which bounds how much of the value is in memory
+// at once.
 class NonblockingPacketReader {
     public:
-    NonblockingPacketReader(shared_ptr<SocketWrapperInterface> socket_wrapper, Message* response, unique_ptr<const string>& value);
+    NonblockingPacketReader(shared_ptr<SocketWrapperInterface> socket_wrapper, Message* response, unique_ptr<const string>& value,
+        ValueSinkProviderInterface *value_sink_provider);
     ~NonblockingPacketReader();
     NonblockingStringStatus Read();
+    // Stops writing to the sink supplied by the provider for the value
+    // currently being read. The rest of that value is read and thrown away.
+    void DropValueSink();
+    // True if the last value read was meant for a file but couldn't all be
+    // written to it
+    bool value_sink_failed() const { return value_sink_failed_; }
+    // From now on take bytes from source rather than reading the socket.
+    // Anything already in the receive buffer is still read first.
+    void set_source(PacketSourceInterface *source) { source_ = source; }
 
     private:
-    bool TransitionFromMagic();
-    void TransitionFromMessageLength();
-    void TransitionFromValueLength();
-    void TransitionFromMessage();
-    bool TransitionFromValue();
+    NonblockingStringStatus Fill(size_t needed, bool *drained);
+    NonblockingStringStatus ReceiveInto(char *dest, size_t length, size_t *received, bool *drained);
+    NonblockingStringStatus ReadValueToFile(bool *drained);
+    bool OpenPipe();
+    NonblockingStringStatus Splice();
+    void WriteValueToFile(const char *data, size_t length, size_t position);
+    void CopyPipeToFile();
+    void DiscardPipe();
+    void ParseHeader();
+    size_t buffered() const { return buffer_end_ - buffer_start_; }
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
     Message* const response_;
-    State state_;
     unique_ptr<const string>& value_;
-    unique_ptr<const string> magic_;
-    unique_ptr<const string> message_length_;
-    unique_ptr<const string> value_length_;
-    unique_ptr<const string> message_;
-    NonblockingStringReader* reader_;
+    ValueSinkProviderInterface *const value_sink_provider_;
+    PacketSourceInterface *source_;
+    State state_;
+    std::vector<char> buffer_;
+    // Bytes in [buffer_start_, buffer_end_) have been received but not yet consumed
+    size_t buffer_start_;
+    size_t buffer_end_;
+    uint32_t message_length_;
+    uint32_t value_length_;
+    // The value being received; this is the same string that ends up in value_.
+    // Empty if the value is going to a sink from the provider.
+    unique_ptr<string> value_buffer_;
+    // Where the value is being copied to in memory, or NULL if it's going to
+    // a file or being thrown away
+    char *value_destination_;
+    size_t value_received_;
+    // The file the value is being written to, or -1
+    int value_fd_;
+    off_t value_file_offset_;
+    bool value_sink_failed_;
+    // Pipe values are spliced through on their way to a file, created when
+    // first needed. pipe_bytes_ of the value are sitting in it.
+    int pipe_fds_[2];
+    size_t pipe_bytes_;
     DISALLOW_COPY_AND_ASSIGN(NonblockingPacketReader);
 };
 
 class NonblockingPacketWriterFactoryInterface {
     public:
     virtual ~NonblockingPacketWriterFactoryInterface() {}
+    // packet holds the header and message as built by EncodeRequest
     virtual unique_ptr<NonblockingPacketWriterInterface> CreateWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
-        unique_ptr<const Message> message, const shared_ptr<const string> value) = 0;
+        unique_ptr<string> packet, const PacketValue& value) = 0;
+    // Sends anything the writers have left buffered. Called whenever there's
+    // nothing more to write for the time being.
+    virtual NonblockingStringStatus Flush() { return kDone; }
+    // Lets go of values the kernel has finished sending from. Called every
+    // time the connection runs, since a completion left unread keeps the
+    // socket reporting an error and so wakes anything waiting on it.
+    virtual void Reap() {}
 };
 
 class NonblockingPacketWriterFactory : public NonblockingPacketWriterFactoryInterface {
     public:
+    NonblockingPacketWriterFactory() : zerocopy_(), record_buffer_() {}
+    // Writers created by this factory send large values with MSG_ZEROCOPY,
+    // tracked by zerocopy. There should be one tracker per socket.
+    explicit NonblockingPacketWriterFactory(shared_ptr<ZerocopyTracker> zerocopy)
+        : zerocopy_(zerocopy), record_buffer_() {}
     unique_ptr<NonblockingPacketWriterInterface> CreateWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
-        unique_ptr<const Message> message, const shared_ptr<const string> value);
+        unique_ptr<string> packet, const PacketValue& value);
+    NonblockingStringStatus Flush();
+    void Reap();
+
+    private:
+    shared_ptr<ZerocopyTracker> zerocopy_;
+    // Shared by the writers on a TLS connection, created with the first one
+    shared_ptr<TlsRecordBuffer> record_buffer_;
 };
 
 } // namespace kinetic
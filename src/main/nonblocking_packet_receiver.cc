@@ -19,6 +19,9 @@
 #include <exception>
 #include <stdexcept>
 #include <ctime>
+#include <errno.h>
+#include <poll.h>
+#include "response_decoder.h"
 
 namespace kinetic {
 
@@ -91,56 +94,54 @@ public:
 };
 
 NonblockingReceiver::NonblockingReceiver(shared_ptr<SocketWrapperInterface> socket_wrapper,
-    HmacProvider hmac_provider, const ConnectionOptions &connection_options)
+    shared_ptr<HmacProviderInterface> hmac_provider, const ConnectionOptions &connection_options,
+    bool wait_for_handshake)
 : socket_wrapper_(socket_wrapper), hmac_provider_(hmac_provider),
-connection_options_(connection_options), nonblocking_response_(NULL),
-connection_id_(0), handler_() {
+connection_options_(connection_options),
+nonblocking_response_(new NonblockingPacketReader(socket_wrapper_, &message_, value_, this)),
+connection_id_(0), handshake_(std::make_shared<HandshakeHandler>()), handler_(),
+command_parsed_(false), has_value_sink_(false), value_sink_key_(0), in_flight_() {
 
-    shared_ptr<HandshakeHandler> hh = std::make_shared<HandshakeHandler>();
-    map_.insert(make_pair(-1,make_pair(hh,-1)));
-    handler_to_message_seq_map_.insert(make_pair(-1, -1));
+    in_flight_.Insert(-1, -1, handshake_);
 
+    if (!wait_for_handshake)
+        return;
 
-    auto start = std::time(0);
+    auto deadline = std::time(0) + 30;
 
-    while(true){
-        if(Receive() == kError)
-            break;
-        if(hh->done)
-            break;
+    NonblockingPacketServiceStatus status;
+    while ((status = ReceiveHandshake()) == kIoWait) {
         auto now = std::time(0);
-        if(now-start > 30)
+        if (now > deadline)
+            break;
+        struct pollfd pfd;
+        pfd.fd = socket_wrapper_->fd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (deadline - now + 1) * 1000) < 0 && errno != EINTR)
             break;
     }
-    if(!hh->success)
+    if (status != kIdle)
         throw std::runtime_error("Could not complete handshake.");
 
 }
 
+NonblockingPacketServiceStatus NonblockingReceiver::ReceiveHandshake() {
+    NonblockingPacketServiceStatus status = Receive();
+    if (handshake_->done)
+        return handshake_->success ? kIdle : kError;
+    return status == kError ? kError : kIoWait;
+}
+
 NonblockingReceiver::~NonblockingReceiver() {
-    if (nonblocking_response_ != NULL) {
-        delete nonblocking_response_;
-    }
     CallAllErrorHandlers(KineticStatus(StatusCode::CLIENT_SHUTDOWN, "Receiver shutdown"));
 }
 
 bool NonblockingReceiver::Enqueue(shared_ptr<HandlerInterface> handler, google::int64 sequence,
     HandlerKey handler_key) {
-    auto seq_to_handler_res = map_.insert(make_pair(sequence, make_pair(handler, handler_key)));
-    if (!seq_to_handler_res.second) {
-        LOG(WARNING) << "Found existing handler for sequence " << sequence;
-        return false;
-    }
-    auto handler_key_to_seq_res =
-        handler_to_message_seq_map_.insert(make_pair(handler_key, sequence));
-    if (!handler_key_to_seq_res.second) {
-        LOG(WARNING) << "Found existing sequence " << sequence << " for handler_key "
+    if (!in_flight_.Insert(sequence, handler_key, handler)) {
+        LOG(WARNING) << "Found existing handler for sequence " << sequence << " or handler_key "
             << handler_key;
-        auto handler_map_entry = map_.find(sequence);
-        CHECK(handler_map_entry != map_.end())
-                    << "Couldn't find just-inserted handler map entry for sequence "
-                    << sequence;
-        map_.erase(handler_map_entry);
         return false;
     }
     return true;
@@ -148,15 +149,11 @@ bool NonblockingReceiver::Enqueue(shared_ptr<HandlerInterface> handler, google::
 
 
 NonblockingPacketServiceStatus NonblockingReceiver::Receive() {
+    // Keep going until every complete response the reader has buffered has
+    // been dispatched and the socket has nothing more for us
     while (true) {
-        if (nonblocking_response_ == NULL) {
-            if (map_.empty()) {
-                return kIdle;
-            }
-
-            // Start working on the next thing in the request queue
-            nonblocking_response_ = new NonblockingPacketReader(
-                socket_wrapper_, &message_, value_);
+        if (in_flight_.empty()) {
+            return kIdle;
         }
 
         NonblockingStringStatus status = nonblocking_response_->Read();
@@ -168,23 +165,23 @@ NonblockingPacketServiceStatus NonblockingReceiver::Receive() {
             return kError;
         }
 
-        // We're done receiving this response
-        delete nonblocking_response_;
-        nonblocking_response_ = NULL;
+        bool command_parsed = command_parsed_;
+        command_parsed_ = false;
+        has_value_sink_ = false;
 
         if(message_.has_hmacauth())
-        if (!hmac_provider_.ValidateHmac(message_, connection_options_.hmac_key)) {
+        if (!hmac_provider_->ValidateHmac(message_, connection_options_.hmac_key)) {
             LOG(INFO) << "Response HMAC mismatch";
             CallAllErrorHandlers(KineticStatus(StatusCode::CLIENT_RESPONSE_HMAC_VERIFICATION_ERROR,
                 "Response HMAC mismatch"));
             return kIdle;
         }
-        if(!command_.ParseFromString(message_.commandbytes())){
+        if(!command_parsed && !ParseCommand(message_.commandbytes())){
             CallAllErrorHandlers(KineticStatus(StatusCode::CLIENT_IO_ERROR, "I/O read error parsing proto::Command"));
             return kError;
         }
         if (command_.header().has_connectionid()) {
-            connection_id_ = command_.header().connectionid();
+            connection_id_.store(command_.header().connectionid(), std::memory_order_relaxed);
         }
 
         if(message_.authtype() == Message_AuthType_UNSOLICITEDSTATUS)
@@ -197,21 +194,21 @@ NonblockingPacketServiceStatus NonblockingReceiver::Receive() {
             return kIdle;
         }
 
-        auto find_result = map_.find(command_.header().acksequence());
-        if (find_result == map_.end()) {
+        handler_ = in_flight_.Take(command_.header().acksequence());
+        if (!handler_) {
             LOG(WARNING) << "Couldn't find a handler for acksequence " <<
                 command_.header().acksequence();
             continue;
         }
-        auto handler_pair = find_result->second;
-        handler_ = handler_pair.first;
-        map_.erase(find_result);
 
-        CHECK_EQ((size_t) 1, handler_to_message_seq_map_.erase(handler_pair.second))
-                << "Couldn't delete handler key to sequence entry for handler_key "
-                << handler_pair.second;
+        if (handler_ == handshake_) {
+            ReserveForLimits();
+        }
 
-        if (command_.status().code() == Command_Status_StatusCode_SUCCESS) {
+        if (nonblocking_response_->value_sink_failed()) {
+            handler_->Error(KineticStatus(StatusCode::CLIENT_IO_ERROR,
+                "Could not write value to file"), &command_);
+        } else if (command_.status().code() == Command_Status_StatusCode_SUCCESS) {
             handler_->Handle(command_, move(value_));
         } else {
             handler_->Error(GetKineticStatus(ConvertFromProtoStatus(
@@ -223,51 +220,86 @@ NonblockingPacketServiceStatus NonblockingReceiver::Receive() {
     }
 }
 
+bool NonblockingReceiver::GetValueSink(const Message& message, size_t value_length, ValueSink *sink) {
+    // Find the handler before the value arrives so it can have the value read
+    // straight into its own memory or file. Receive reuses the parsed command.
+    if (message.authtype() == Message_AuthType_UNSOLICITEDSTATUS ||
+            !ParseCommand(message.commandbytes())) {
+        return false;
+    }
+    command_parsed_ = true;
+    if (!command_.header().has_acksequence()) {
+        return false;
+    }
+    HandlerKey handler_key;
+    HandlerInterface *handler = in_flight_.Find(command_.header().acksequence(), &handler_key);
+    if (handler == NULL) {
+        return false;
+    }
+    sink->buffer = handler->ValueDestination(value_length);
+    if (sink->buffer == NULL) {
+        sink->fd = handler->ValueFile(value_length, &sink->file_offset);
+        if (sink->fd == -1) {
+            return false;
+        }
+    }
+    has_value_sink_ = true;
+    value_sink_key_ = handler_key;
+    return true;
+}
+
+void NonblockingReceiver::DropValueSink() {
+    if (has_value_sink_) {
+        nonblocking_response_->DropValueSink();
+        has_value_sink_ = false;
+    }
+}
+
 int64_t NonblockingReceiver::connection_id() {
-    return connection_id_;
+    return connection_id_.load(std::memory_order_relaxed);
+}
+
+void NonblockingReceiver::FailAll(KineticStatus status) {
+    CallAllErrorHandlers(status);
 }
 
 void NonblockingReceiver::CallAllErrorHandlers(KineticStatus error) {
+    DropValueSink();
     if (handler_) {
         handler_->Error(error, NULL);
         handler_.reset();
     }
 
-    auto iter = map_.begin();
-    while (iter != map_.end()) {
-        auto handler_pair = iter->second;
-        shared_ptr<HandlerInterface> handler = handler_pair.first;
-        HandlerKey handler_key = handler_pair.second;
+    vector<shared_ptr<HandlerInterface>> handlers = in_flight_.TakeAll();
+    for (auto it = handlers.begin(); it != handlers.end(); ++it) {
+        (*it)->Error(error, NULL);
+    }
+}
 
-        CHECK_EQ((size_t) 1, handler_to_message_seq_map_.erase(handler_key))
-                << "Couldn't delete handler to sequence entry for handler_key " << handler_key;
+// Most responses are to the few kinds of request a busy client keeps making,
+// and the fast decoder handles those
+bool NonblockingReceiver::ParseCommand(const string& bytes) {
+    return DecodeHotResponse(bytes, &command_) || command_.ParseFromString(bytes);
+}
 
-        handler->Error(error, NULL);
-        handler.reset();
-        iter++;
+// The drive's handshake carries its limits. Making room for as many requests
+// as it will take at once means the in-flight table never has to grow.
+void NonblockingReceiver::ReserveForLimits() {
+    if (!command_.body().getlog().has_limits()) {
+        return;
     }
-    map_.clear();
+    const auto &limits = command_.body().getlog().limits();
+    in_flight_.Reserve(static_cast<size_t>(limits.maxoutstandingreadrequests()) +
+        limits.maxoutstandingwriterequests());
 }
 
 bool NonblockingReceiver::Remove(HandlerKey key) {
-    auto handler_key_to_seq = handler_to_message_seq_map_.find(key);
-    if (handler_key_to_seq == handler_to_message_seq_map_.end()) {
+    if (!in_flight_.Remove(key)) {
         return false;
     }
-
-    google::protobuf::int64 seq = handler_key_to_seq->second;
-
-    handler_to_message_seq_map_.erase(handler_key_to_seq);
-
-    auto seq_to_handler = map_.find(seq);
-    CHECK(seq_to_handler != map_.end()) << "Handler key " << handler_key_to_seq->first
-        << " mapped to seq " << seq << " but no handler entry for that seq";
-
-    auto handler_pair = seq_to_handler->second;
-    auto handler_key = handler_pair.second;
-    CHECK_EQ(handler_key, key);
-    map_.erase(seq_to_handler);
-
+    if (has_value_sink_ && value_sink_key_ == key) {
+        DropValueSink();
+    }
     return true;
 }
 
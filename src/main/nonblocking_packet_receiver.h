@@ -21,6 +21,7 @@
 #include <sys/select.h>
 #include <cstdint>
 
+#include <atomic>
 #include <queue>
 #include <unordered_map>
 #include <glog/logging.h>
@@ -29,6 +30,7 @@
 #include "kinetic/connection_options.h"
 #include "kinetic/hmac_provider.h"
 #include "kinetic_client.pb.h"
+#include "in_flight_table.h"
 #include "nonblocking_packet.h"
 #include "socket_wrapper_interface.h"
 
@@ -59,36 +61,68 @@ class NonblockingReceiverInterface {
     virtual NonblockingPacketServiceStatus Receive() = 0;
     virtual int64_t connection_id() = 0;
     virtual bool Remove(HandlerKey key) = 0;
+    // Calls back every request waiting for a response with status
+    virtual void FailAll(KineticStatus status) = 0;
 };
 
-class NonblockingReceiver : public NonblockingReceiverInterface {
+class HandshakeHandler;
+
+class NonblockingReceiver : public NonblockingReceiverInterface, public ValueSinkProviderInterface {
     public:
+    // Unless wait_for_handshake is unset, the constructor waits up to 30
+    // seconds for the drive's handshake and throws if it doesn't arrive.
+    // Otherwise call ReceiveHandshake until it stops returning kIoWait before
+    // using the receiver.
     explicit NonblockingReceiver(shared_ptr<SocketWrapperInterface> socket_wrapper,
-        HmacProvider hmac_provider, const ConnectionOptions &connection_options);
+        shared_ptr<HmacProviderInterface> hmac_provider, const ConnectionOptions &connection_options,
+        bool wait_for_handshake = true);
     ~NonblockingReceiver();
+    // Reads as much of the handshake as has arrived. Returns kIdle once it's
+    // been received, kIoWait while waiting for more of it, or kError.
+    NonblockingPacketServiceStatus ReceiveHandshake();
     bool Enqueue(shared_ptr<HandlerInterface> handler, google::int64 sequence,
             HandlerKey handler_key);
     NonblockingPacketServiceStatus Receive();
     int64_t connection_id();
     bool Remove(HandlerKey key);
+    void FailAll(KineticStatus status);
+    bool GetValueSink(const Message& message, size_t value_length, ValueSink *sink);
+    // Have responses taken from source instead of read from the socket. Only
+    // makes sense once the handshake has been received.
+    void set_packet_source(PacketSourceInterface *source) {
+        nonblocking_response_->set_source(source);
+    }
 
     private:
     void CallAllErrorHandlers(KineticStatus error);
+    void ReserveForLimits();
+    bool ParseCommand(const string& bytes);
+    void DropValueSink();
 
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
-    HmacProvider hmac_provider_;
+    shared_ptr<HmacProviderInterface> hmac_provider_;
     ConnectionOptions connection_options_;
-    NonblockingPacketReader *nonblocking_response_;
-    int64_t connection_id_;
+    // Lives as long as the receiver since it may hold bytes of responses we
+    // haven't got to yet
+    unique_ptr<NonblockingPacketReader> nonblocking_response_;
+    // Read by the sender on submitting threads, so it's atomic. The value is
+    // only ever a label for requests, so relaxed ordering does.
+    std::atomic<int64_t> connection_id_;
+    shared_ptr<HandshakeHandler> handshake_;
     shared_ptr<HandlerInterface> handler_;
     Message message_;
     Command command_;
+    // Set when GetValueSink has already parsed command_ for the response being read
+    bool command_parsed_;
+    // Set while the value being read is going to a sink owned by the handler for
+    // value_sink_key_
+    bool has_value_sink_;
+    HandlerKey value_sink_key_;
     unique_ptr<const string> value_;
-    unordered_map<google::protobuf::int64, pair<shared_ptr<HandlerInterface>, HandlerKey>> map_;
     // handler_key is separate from message sequence so that we don't tie handler identification
     // semantics to the message sequencing, since message sequence semantics are outside of our
-    // control.
-    unordered_map<HandlerKey, google::protobuf::int64> handler_to_message_seq_map_;
+    // control. The table finds handlers by either.
+    InFlightTable in_flight_;
     DISALLOW_COPY_AND_ASSIGN(NonblockingReceiver);
 };
 
@@ -28,67 +28,139 @@ using std::make_pair;
 NonblockingSender::NonblockingSender(shared_ptr<SocketWrapperInterface> socket_wrapper,
                                      shared_ptr<NonblockingReceiverInterface> receiver,
                                      shared_ptr<NonblockingPacketWriterFactoryInterface> packet_writer_factory,
-                                     HmacProvider hmac_provider,
-                                     const ConnectionOptions &connection_options) :
+                                     shared_ptr<HmacProviderInterface> hmac_provider,
+                                     const ConnectionOptions &connection_options,
+                                     shared_ptr<RequestPools> pools) :
         socket_wrapper_(socket_wrapper),
         receiver_(receiver),
         packet_writer_factory_(packet_writer_factory),
         hmac_provider_(hmac_provider),
         connection_options_(connection_options),
+        pools_(pools),
+        requests_(),
         sequence_number_(0),
+        submissions_(),
+        out_of_order_(),
+        next_sequence_(0),
         current_writer_(),
         handler_()
 {}
 
 void NonblockingSender::Enqueue(unique_ptr<Message> message, unique_ptr<Command> command,
-    const shared_ptr<const string> value, unique_ptr<HandlerInterface> handler,
+    const PacketValue& value, unique_ptr<HandlerInterface> handler,
     HandlerKey handler_key) {
 
     command->mutable_header()->set_connectionid(receiver_->connection_id());
-    command->mutable_header()->set_sequence(sequence_number_++);
+    int64_t sequence = sequence_number_.fetch_add(1, std::memory_order_relaxed);
+    command->mutable_header()->set_sequence(sequence);
     /* COMMAND PART OF MESSAGE IS FINALIZED */
-    message->set_commandbytes(command->SerializeAsString());
 
-    if(message->authtype() == com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH){
-        message->mutable_hmacauth()->set_identity(connection_options_.user_id);
-        message->mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(*message, connection_options_.hmac_key));
+    unique_ptr<Request> request = requests_.Acquire();
+    request->packet = packets_.Acquire();
+    // The command bytes and HMAC are written straight into the packet
+    message->clear_commandbytes();
+    message->clear_hmacauth();
+    if (!EncodeRequest(*message, *command, value.size(), connection_options_.user_id, *hmac_provider_,
+            connection_options_.hmac_key, request->packet.get())) {
+        // The writer fails on the empty packet, which fails the request in turn
+        LOG(WARNING) << "Could not encode request with sequence " << sequence;
+    }
+    if (pools_) {
+        pools_->messages.Release(move(message));
+        pools_->commands.Release(move(command));
     }
 
-    unique_ptr<Request> request(new Request());
-    request->message = move(message);
-    request->command = move(command);
+    request->sequence = sequence;
     request->value = value;
     request->handler = move(handler);
     request->handler_key = handler_key;
 
-    request_queue_.push_back(move(request));
+    submissions_.Push(move(request));
 }
 
 NonblockingSender::~NonblockingSender() {
+    FailAll(KineticStatus(StatusCode::CLIENT_SHUTDOWN, "Sender shutdown"));
+}
+
+// Moves what Enqueue has handed over onto request_queue_. Requests enqueued
+// at the same time on different threads can arrive out of order, and the
+// drive expects sequence numbers to go up, so anything that overtook a
+// request still on its way waits in out_of_order_.
+void NonblockingSender::TakeSubmissions() {
+    unique_ptr<Request> request;
+    while (submissions_.Pop(&request)) {
+        int64_t sequence = request->sequence;
+        if (sequence != next_sequence_) {
+            out_of_order_[sequence] = move(request);
+            continue;
+        }
+        request_queue_.push_back(move(request));
+        next_sequence_++;
+        auto it = out_of_order_.begin();
+        while (it != out_of_order_.end() && it->first == next_sequence_) {
+            if (it->second) {
+                request_queue_.push_back(move(it->second));
+            }
+            out_of_order_.erase(it++);
+            next_sequence_++;
+        }
+    }
+}
+
+void NonblockingSender::FailAll(KineticStatus status) {
+    // A request part way through being written can't be finished either
+    if (handler_) {
+        handler_->Error(status, NULL);
+        handler_.reset();
+    }
+    TakeSubmissions();
+    for (auto it = out_of_order_.begin(); it != out_of_order_.end(); ++it) {
+        if (it->second) {
+            request_queue_.push_back(move(it->second));
+        }
+    }
+    out_of_order_.clear();
+
     while (!request_queue_.empty()) {
         unique_ptr<Request> request = move(request_queue_.front());
         request_queue_.pop_front();
-        request->handler->Error(
-            KineticStatus(StatusCode::CLIENT_SHUTDOWN, "Sender shutdown"),
-            NULL);
+        request->handler->Error(status, NULL);
+        Recycle(move(request));
     }
 }
 
+void NonblockingSender::Recycle(unique_ptr<Request> request) {
+    packets_.Release(move(request->packet));
+    requests_.Release(move(request));
+}
+
 NonblockingPacketServiceStatus NonblockingSender::Send() {
+    packet_writer_factory_->Reap();
+    TakeSubmissions();
     while (true) {
         if (!current_writer_) {
             if (request_queue_.empty()) {
+                // Writers may leave the tail of what they wrote buffered in
+                // the hope of sharing a TLS record with the next packet
+                NonblockingStringStatus status = packet_writer_factory_->Flush();
+                if (status == kInProgress) {
+                    return kIoWait;
+                }
+                if (status == kFailed) {
+                    return kError;
+                }
                 return kIdle;
             }
 
             // Start working on the next thing on the request queue
             unique_ptr<Request> request = move(request_queue_.front());
             request_queue_.pop_front();
-            message_sequence_ = request->command->header().sequence();
+            message_sequence_ = request->sequence;
             handler_key_ = request->handler_key;
             current_writer_ = move(packet_writer_factory_->CreateWriter(socket_wrapper_,
-                move(request->message), request->value));
+                move(request->packet), request->value));
             handler_ = move(request->handler);
+            Recycle(move(request));
         }
 
         NonblockingStringStatus status = current_writer_->Write();
@@ -103,16 +175,12 @@ NonblockingPacketServiceStatus NonblockingSender::Send() {
                     KineticStatus(StatusCode::CLIENT_IO_ERROR, "I/O write error"), NULL);
             handler_.reset();
 
-            while (!request_queue_.empty()) {
-                unique_ptr<Request> request = move(request_queue_.front());
-                request_queue_.pop_front();
-                request->handler->Error(KineticStatus(StatusCode::CLIENT_IO_ERROR,
-                    "I/O write error"), NULL);
-            }
+            FailAll(KineticStatus(StatusCode::CLIENT_IO_ERROR, "I/O write error"));
             return kError;
         }
 
         // We're done with this request
+        packets_.Release(current_writer_->TakePacket());
         current_writer_.reset();
 
         if (!receiver_->Enqueue(handler_, message_sequence_, handler_key_)) {
@@ -126,12 +194,20 @@ NonblockingPacketServiceStatus NonblockingSender::Send() {
 }
 
 bool NonblockingSender::Remove(HandlerKey key) {
+    TakeSubmissions();
     for (auto it = request_queue_.begin(); it != request_queue_.end(); it++) {
         if ((*it)->handler_key == key) {
+            Recycle(move(*it));
             request_queue_.erase(it);
             return true;
         }
     }
+    for (auto it = out_of_order_.begin(); it != out_of_order_.end(); it++) {
+        if (it->second && it->second->handler_key == key) {
+            Recycle(move(it->second));
+            return true;
+        }
+    }
     return false;
 }
 
@@ -21,6 +21,8 @@
 #include <sys/select.h>
 #include <cstdint>
 
+#include <atomic>
+#include <map>
 #include <queue>
 #include <unordered_map>
 #include <glog/logging.h>
@@ -31,7 +33,9 @@
 #include "kinetic/connection_options.h"
 #include "kinetic/hmac_provider.h"
 #include "kinetic_client.pb.h"
+#include "mpsc_queue.h"
 #include "nonblocking_packet.h"
+#include "object_pool.h"
 #include "socket_wrapper_interface.h"
 #include "nonblocking_packet_receiver.h"
 
@@ -51,41 +55,77 @@ class NonblockingSenderInterface {
     public:
     virtual ~NonblockingSenderInterface() {}
     // The HandlerKey returned will be unique for the lifespan of the Sender instance.
-    virtual void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    virtual void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
             unique_ptr<HandlerInterface> handler, HandlerKey handler_key) = 0;
     virtual NonblockingPacketServiceStatus Send() = 0;
     // remove the handler if it hasn't already started being processed. Returns true if a handler
     // actually was removed.
     virtual bool Remove(HandlerKey key) = 0;
+    // Calls back every request not yet handed to the receiver with status
+    virtual void FailAll(KineticStatus status) = 0;
 };
 
+// Enqueue may be called from any number of threads at once, and does all the
+// per-request work (encoding the packet and computing its HMAC) on the calling
+// thread. Finished requests are handed over through a lock-free queue to the
+// one thread at a time calling Send and Remove, which puts them back into
+// sequence order before writing them.
+//
+// Packets are encoded into strings the sender keeps for reuse once they've
+// been written, so in the steady state encoding doesn't allocate. Given pools,
+// the sender gives each request's Message and Command back to them as soon as
+// the packet is encoded.
 class NonblockingSender : public NonblockingSenderInterface {
     public:
     NonblockingSender(shared_ptr<SocketWrapperInterface> socket_wrapper,
         shared_ptr<NonblockingReceiverInterface> receiver,
         shared_ptr<NonblockingPacketWriterFactoryInterface> packet_writer_factory,
-        HmacProvider hmac_provider, const ConnectionOptions &connection_options);
+        shared_ptr<HmacProviderInterface> hmac_provider, const ConnectionOptions &connection_options,
+        shared_ptr<RequestPools> pools = shared_ptr<RequestPools>());
     ~NonblockingSender();
-    void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
             unique_ptr<HandlerInterface> handler, HandlerKey handler_key);
     NonblockingPacketServiceStatus Send();
     bool Remove(HandlerKey key);
+    void FailAll(KineticStatus status);
 
     private:
     struct Request {
-        unique_ptr<const Message> message;
-        unique_ptr<const Command> command;
-        shared_ptr<const string> value;
+        Request() : packet(), sequence(0), value(shared_ptr<const string>()), handler(), handler_key(0) {}
+        void Clear() {
+            packet.reset();
+            value = PacketValue(shared_ptr<const string>());
+            handler.reset();
+        }
+        // Empty if the request couldn't be encoded
+        unique_ptr<string> packet;
+        int64_t sequence;
+        PacketValue value;
         unique_ptr<HandlerInterface> handler;
         HandlerKey handler_key;
     };
 
+    void TakeSubmissions();
+    void Recycle(unique_ptr<Request> request);
+
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
     shared_ptr<NonblockingReceiverInterface> receiver_;
     shared_ptr<NonblockingPacketWriterFactoryInterface> packet_writer_factory_;
-    HmacProvider hmac_provider_;
+    shared_ptr<HmacProviderInterface> hmac_provider_;
     ConnectionOptions connection_options_;
-    int64_t sequence_number_;
+    shared_ptr<RequestPools> pools_;
+    // Requests and packets are recycled whether or not there are pools for
+    // messages and commands
+    ObjectPool<Request> requests_;
+    ObjectPool<string> packets_;
+    std::atomic<int64_t> sequence_number_;
+    // Requests handed over by Enqueue and not yet taken by Send or Remove
+    MpscQueue<unique_ptr<Request>> submissions_;
+    // Taken requests that overtook an earlier sequence number on the way, by
+    // sequence. A removed request leaves a NULL behind to keep its place.
+    std::map<int64_t, unique_ptr<Request>> out_of_order_;
+    // Sequence number of the next request to join request_queue_
+    int64_t next_sequence_;
     HandlerKey handler_key_;
     unique_ptr<NonblockingPacketWriterInterface> current_writer_;
     shared_ptr<HandlerInterface> handler_;
@@ -25,59 +25,166 @@ using std::unique_ptr;
 using std::move;
 using std::make_pair;
 
+namespace {
+
+// Stands in for a handler whose calls are to go through an executor. The
+// response is re-used once Handle returns, so the handler is given a copy.
+class ExecutorHandler : public HandlerInterface {
+    public:
+    ExecutorHandler(unique_ptr<HandlerInterface> handler, shared_ptr<ExecutorInterface> executor)
+        : handler_(move(handler)), executor_(executor) {}
+
+    void Handle(const Command &response, unique_ptr<const string> value) {
+        shared_ptr<HandlerInterface> handler = handler_;
+        shared_ptr<const Command> response_copy(new Command(response));
+        // std::function has to be copyable, so the value can't be captured
+        // as it is
+        shared_ptr<unique_ptr<const string>> value_holder(new unique_ptr<const string>(move(value)));
+        executor_->Execute([handler, response_copy, value_holder]() {
+            handler->Handle(*response_copy, move(*value_holder));
+        });
+    }
+
+    void Error(KineticStatus error, Command const * const response) {
+        shared_ptr<HandlerInterface> handler = handler_;
+        shared_ptr<const Command> response_copy;
+        if (response != NULL) {
+            response_copy.reset(new Command(*response));
+        }
+        executor_->Execute([handler, error, response_copy]() {
+            handler->Error(error, response_copy.get());
+        });
+    }
+
+    // Values are still read on the thread running the service
+    char* ValueDestination(size_t value_length) {
+        return handler_->ValueDestination(value_length);
+    }
+
+    int ValueFile(size_t value_length, off_t *offset) {
+        return handler_->ValueFile(value_length, offset);
+    }
+
+    private:
+    shared_ptr<HandlerInterface> handler_;
+    shared_ptr<ExecutorInterface> executor_;
+    DISALLOW_COPY_AND_ASSIGN(ExecutorHandler);
+};
+
+} // namespace
+
 NonblockingPacketService::NonblockingPacketService(
         shared_ptr<SocketWrapperInterface> socket_wrapper,
         unique_ptr<NonblockingSenderInterface> sender,
         shared_ptr<NonblockingReceiverInterface> receiver)
     : socket_wrapper_(socket_wrapper), sender_(move(sender)), receiver_(receiver),
-        failed_(false), next_key_(0) {}
+        failed_(false), failed_mutex_(), next_key_(0), submit_listener_(), completion_executor_() {}
 
 NonblockingPacketService::~NonblockingPacketService() {
     CleanUp();
 }
 
 HandlerKey NonblockingPacketService::Submit(unique_ptr<Message> message, unique_ptr<Command> command,
-        const shared_ptr<const string> value, unique_ptr<HandlerInterface> handler) {
-    HandlerKey key = next_key_++;
+        const PacketValue& value, unique_ptr<HandlerInterface> handler) {
+    HandlerKey key = next_key_.fetch_add(1, std::memory_order_relaxed);
+
+    if (completion_executor_) {
+        handler.reset(new ExecutorHandler(move(handler), completion_executor_));
+    }
 
     if (failed_) {
         handler->Error(
                 KineticStatus(StatusCode::CLIENT_SHUTDOWN, "Client already shut down"), NULL);
     } else {
         sender_->Enqueue(move(message), move(command), value, move(handler), key);
+        // The connection may have failed between the check above and the
+        // push, after Fail had already drained the sender. Either Fail sees
+        // the request or this sees failed_.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (failed_) {
+            std::lock_guard<std::recursive_mutex> lock(failed_mutex_);
+            sender_->FailAll(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Connection failed"));
+        } else if (submit_listener_) {
+            submit_listener_();
+        }
     }
 
     return key;
 }
 
+void NonblockingPacketService::SetSubmitListener(std::function<void()> listener) {
+    submit_listener_ = listener;
+}
+
+void NonblockingPacketService::SetCompletionExecutor(shared_ptr<ExecutorInterface> executor) {
+    completion_executor_ = executor;
+}
+
 bool NonblockingPacketService::Run(fd_set *read_fds, fd_set *write_fds, int *nfds) {
+    IoInterest interest;
+    if (!Run(&interest)) {
+        return false;
+    }
+    FD_ZERO(read_fds);
+    FD_ZERO(write_fds);
+    *nfds = 0;
+    if (interest.write) {
+        FD_SET(interest.fd, write_fds);
+        *nfds = interest.fd + 1;
+    }
+    if (interest.read) {
+        FD_SET(interest.fd, read_fds);
+        *nfds = interest.fd + 1;
+    }
+    return true;
+}
+
+bool NonblockingPacketService::Run(IoInterest *interest) {
     if (failed_) {
         return false;
     }
     NonblockingPacketServiceStatus sender_status = sender_->Send();
     if (sender_status == kError) {
-        CleanUp();
+        Fail();
         return false;
     }
+    HandlerKey next_key = next_key_.load(std::memory_order_relaxed);
     NonblockingPacketServiceStatus receiver_status = receiver_->Receive();
     if (receiver_status == kError) {
-        CleanUp();
+        Fail();
         return false;
     }
-    FD_ZERO(read_fds);
-    FD_ZERO(write_fds);
-    *nfds = 0;
-    if (sender_status == kIoWait) {
-        FD_SET(socket_wrapper_->fd(), write_fds);
-        *nfds = socket_wrapper_->fd() + 1;
-    }
-    if (receiver_status == kIoWait) {
-        FD_SET(socket_wrapper_->fd(), read_fds);
-        *nfds = socket_wrapper_->fd() + 1;
+    if (next_key_.load(std::memory_order_relaxed) != next_key) {
+        // Callbacks submitted more while receiving. With edge-triggered
+        // polling nothing would run the connection again to send them, so
+        // send them now
+        sender_status = sender_->Send();
+        if (sender_status == kError) {
+            Fail();
+            return false;
+        }
     }
+    interest->fd = socket_wrapper_->fd();
+    interest->write = sender_status == kIoWait;
+    interest->read = receiver_status == kIoWait;
     return true;
 }
 
+// Whichever side ran into the error has already failed its own requests, but
+// the other side's can't complete on a broken connection either. Marking the
+// service failed first means callbacks submitting more are failed right away
+// rather than queued behind the error.
+void NonblockingPacketService::Fail() {
+    KineticStatus status(StatusCode::CLIENT_IO_ERROR, "Connection failed");
+    {
+        std::lock_guard<std::recursive_mutex> lock(failed_mutex_);
+        CleanUp();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        sender_->FailAll(status);
+    }
+    receiver_->FailAll(status);
+}
+
 // Free all allocated resources and mark the service as having encountered an
 // irrecoverable error. This function exists so that in the event of an error
 // we can close the connection immediately instead of leaving it open until the
@@ -87,6 +194,11 @@ void NonblockingPacketService::CleanUp() {
 }
 
 bool NonblockingPacketService::Remove(HandlerKey handler_key) {
+    // After a failure, submitting threads may be draining the sender too
+    std::unique_lock<std::recursive_mutex> lock(failed_mutex_, std::defer_lock);
+    if (failed_) {
+        lock.lock();
+    }
     return sender_->Remove(handler_key) || receiver_->Remove(handler_key);
 }
 
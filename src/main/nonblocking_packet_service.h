@@ -21,6 +21,8 @@
 #include <sys/select.h>
 #include <cstdint>
 
+#include <atomic>
+#include <mutex>
 #include <queue>
 #include <unordered_map>
 #include <glog/logging.h>
@@ -53,18 +55,30 @@ class NonblockingPacketService : public NonblockingPacketServiceInterface {
         unique_ptr<NonblockingSenderInterface> sender,
         shared_ptr<NonblockingReceiverInterface> receiver);
     ~NonblockingPacketService();
-    // handler instances cannot be reused
-    HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    // handler instances cannot be reused. Submit may be called from several
+    // threads at once, and alongside Run and Remove.
+    HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
         unique_ptr<HandlerInterface> handler);
     bool Run(fd_set *read_fds, fd_set *write_fds, int *nfds);
+    bool Run(IoInterest *interest);
     bool Remove(HandlerKey handler_key);
+    void SetSubmitListener(std::function<void()> listener);
+    void SetCompletionExecutor(shared_ptr<ExecutorInterface> executor);
 
     private:
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
     unique_ptr<NonblockingSenderInterface> sender_;
     shared_ptr<NonblockingReceiverInterface> receiver_;
-    bool failed_;
-    HandlerKey next_key_;
+    std::atomic<bool> failed_;
+    // Once failed_ is set, submitting threads may have to fail what they
+    // queued themselves, so the sender's queue has more than one consumer.
+    // They take turns with this. Recursive since callbacks failed under it
+    // may call Remove.
+    std::recursive_mutex failed_mutex_;
+    std::atomic<HandlerKey> next_key_;
+    std::function<void()> submit_listener_;
+    shared_ptr<ExecutorInterface> completion_executor_;
+    void Fail();
     void CleanUp();
     DISALLOW_COPY_AND_ASSIGN(NonblockingPacketService);
 };
@@ -26,10 +26,24 @@ using std::move;
 using std::string;
 
 unique_ptr<NonblockingPacketWriterInterface> NonblockingPacketWriterFactory::CreateWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
-    unique_ptr<const Message> message, const shared_ptr<const string> value) {
+    unique_ptr<string> packet, const PacketValue& value) {
+    // A factory serves a single connection, so the socket doesn't change
+    if (!record_buffer_ && socket_wrapper->getSSL() && !socket_wrapper->ktls_send()) {
+        record_buffer_ = make_shared<TlsRecordBuffer>(socket_wrapper);
+    }
     return
         unique_ptr<NonblockingPacketWriterInterface>(
-            new NonblockingPacketWriter(socket_wrapper, move(message), value));
+            new NonblockingPacketWriter(socket_wrapper, move(packet), value, zerocopy_, record_buffer_));
+}
+
+NonblockingStringStatus NonblockingPacketWriterFactory::Flush() {
+    return record_buffer_ ? record_buffer_->Flush() : kDone;
+}
+
+void NonblockingPacketWriterFactory::Reap() {
+    if (zerocopy_ && zerocopy_->pending() > 0) {
+        zerocopy_->Reap();
+    }
 }
 
 } // namespace kinetic
@@ -32,19 +32,16 @@ using std::unique_ptr;
 using std::move;
 
 NonblockingStringReader::NonblockingStringReader(shared_ptr<SocketWrapperInterface> socket_wrapper, size_t size, unique_ptr<const string> &s)
-        : socket_wrapper_(socket_wrapper), size_(size), s_(s), buf_(new char[size]), bytes_read_(0) {}
-
-NonblockingStringReader::~NonblockingStringReader() {
-    delete[] buf_;
-}
+        : socket_wrapper_(socket_wrapper), size_(size), s_(s), buf_(new string(size, '\0')), bytes_read_(0) {}
 
 NonblockingStringStatus NonblockingStringReader::Read() {
     while (bytes_read_ < size_) {
         int status = 0;
-        if(socket_wrapper_->getSSL()){
-             status = SSL_read(socket_wrapper_->getSSL(), buf_ + bytes_read_, size_ - bytes_read_);
+        // Where the kernel decrypts what's received, plain reads are all it takes
+        if(socket_wrapper_->getSSL() && !socket_wrapper_->ktls_receive()){
+             status = SSL_read(socket_wrapper_->getSSL(), &(*buf_)[bytes_read_], size_ - bytes_read_);
         }
-        else status = read(socket_wrapper_->fd(), buf_ + bytes_read_, size_ - bytes_read_);
+        else status = read(socket_wrapper_->fd(), &(*buf_)[bytes_read_], size_ - bytes_read_);
         if (status == 0) {
             // Unexpected EOF
             return kFailed;
@@ -63,9 +60,7 @@ NonblockingStringStatus NonblockingStringReader::Read() {
     }
 
     CHECK_EQ(bytes_read_, size_);
-    // it'd be nice if we could use make_unique
-    unique_ptr<const string> p(new string(buf_, size_));
-    s_ = move(p);
+    s_ = move(buf_);
     return kDone;
 }
 
@@ -90,8 +85,10 @@ NonblockingStringStatus NonblockingStringWriter::Write() {
             return kFailed;
         }
         int status;
+        // Where the kernel encrypts sends, plain writes are all it takes
+        bool ssl_write = socket_wrapper_->getSSL() && !socket_wrapper_->ktls_send();
         if (S_ISSOCK(statbuf.st_mode)) {
-            if(socket_wrapper_->getSSL())
+            if(ssl_write)
                 status = SSL_write(socket_wrapper_->getSSL(), s_->data() + bytes_written_, s_->size() - bytes_written_);
             else
             status = send(
@@ -100,7 +97,7 @@ NonblockingStringStatus NonblockingStringWriter::Write() {
                 s_->size() - bytes_written_,
                 flags);
         } else {
-            if(socket_wrapper_->getSSL())
+            if(ssl_write)
                 status = SSL_write(socket_wrapper_->getSSL(), s_->data() + bytes_written_, s_->size() - bytes_written_);
             else
                 status = write(socket_wrapper_->fd(), s_->data() + bytes_written_, s_->size() - bytes_written_);
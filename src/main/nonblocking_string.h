@@ -39,14 +39,14 @@ enum NonblockingStringStatus {
 class NonblockingStringReader {
     public:
     NonblockingStringReader(shared_ptr<SocketWrapperInterface> socket_wrapper, size_t size, unique_ptr<const string> &s);
-    ~NonblockingStringReader();
     NonblockingStringStatus Read();
 
     private:
     shared_ptr<SocketWrapperInterface> socket_wrapper_;
     const size_t size_;
     unique_ptr<const string> &s_;
-    char *const buf_;
+    // Bytes are read straight into the string that is eventually handed back
+    unique_ptr<string> buf_;
     size_t bytes_read_;
     DISALLOW_COPY_AND_ASSIGN(NonblockingStringReader);
 };
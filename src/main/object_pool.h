@@ -0,0 +1,180 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_OBJECT_POOL_H_
+#define KINETIC_CPP_CLIENT_OBJECT_POOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "kinetic/common.h"
+#include "kinetic_client.pb.h"
+
+namespace kinetic {
+
+using com::seagate::kinetic::client::proto::Command;
+using com::seagate::kinetic::client::proto::Message;
+
+// Empties a released object for its next use
+template <typename T>
+inline void ClearForReuse(T *object) {
+    object->Clear();
+}
+
+// Cleared strings keep their capacity
+inline void ClearForReuse(std::string *object) {
+    object->clear();
+}
+
+// Hands out objects that have been used before when it can, instead of new
+// ones. A released object is cleared and kept for the next Acquire; for
+// protobuf messages that keeps the memory of their strings and sub-messages,
+// so building the next request in them mostly doesn't allocate.
+//
+// Objects may be acquired and released from any thread, without taking a
+// lock. At most max_free objects are kept; any more released are destroyed.
+// Kept objects sit in a fixed array of slots, and two lock-free stacks of
+// slot indexes track which slots hold an object and which are unused.
+template <typename T>
+class ObjectPool {
+    public:
+    static const size_t kDefaultMaxFree = 1024;
+
+    explicit ObjectPool(size_t max_free = kDefaultMaxFree)
+        : slots_(new Slot[max_free]), free_(kNoSlot), unused_(kNoSlot), allocations_(0) {
+        for (size_t i = 0; i < max_free; i++) {
+            Push(&unused_, i);
+        }
+    }
+
+    ~ObjectPool() {
+        uint32_t index;
+        while (Pop(&free_, &index)) {
+            delete slots_[index].object;
+        }
+    }
+
+    std::unique_ptr<T> Acquire() {
+        uint32_t index;
+        if (Pop(&free_, &index)) {
+            T *object = slots_[index].object;
+            Push(&unused_, index);
+            return std::unique_ptr<T>(object);
+        }
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        return std::unique_ptr<T>(new T());
+    }
+
+    void Release(std::unique_ptr<T> object) {
+        if (!object) {
+            return;
+        }
+        uint32_t index;
+        if (!Pop(&unused_, &index)) {
+            // The pool is full
+            return;
+        }
+        ClearForReuse(object.get());
+        slots_[index].object = object.release();
+        Push(&free_, index);
+    }
+
+    // Objects handed out are sometimes passed on as const, but the pool still
+    // owns what they are
+    void Release(std::unique_ptr<const T> object) {
+        Release(std::unique_ptr<T>(const_cast<T *>(object.release())));
+    }
+
+    // How many objects the pool has had to create
+    uint64_t allocations() const {
+        return allocations_.load(std::memory_order_relaxed);
+    }
+
+    private:
+    struct Slot {
+        Slot() : object(NULL), next(kNoSlot) {}
+        // Only touched by whoever has taken the slot off a stack
+        T *object;
+        // The slot below this one on whichever stack it's on
+        std::atomic<uint32_t> next;
+    };
+
+    static const uint32_t kNoSlot = 0xffffffff;
+
+    // A stack is the index of its top slot in the low half of a word, and a
+    // count of the changes made to it in the high half. A thread that read
+    // the stack before others popped and pushed the same top back then fails
+    // to swap in its stale next slot.
+    static uint64_t Stack(uint64_t previous, uint32_t top) {
+        return (((previous >> 32) + 1) << 32) | top;
+    }
+
+    void Push(std::atomic<uint64_t> *stack, uint32_t index) {
+        uint64_t head = stack->load(std::memory_order_relaxed);
+        do {
+            slots_[index].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!stack->compare_exchange_weak(head, Stack(head, index), std::memory_order_release,
+            std::memory_order_relaxed));
+    }
+
+    bool Pop(std::atomic<uint64_t> *stack, uint32_t *index) {
+        uint64_t head = stack->load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != kNoSlot) {
+            uint32_t top = static_cast<uint32_t>(head);
+            uint32_t next = slots_[top].next.load(std::memory_order_relaxed);
+            if (stack->compare_exchange_weak(head, Stack(head, next), std::memory_order_acquire,
+                    std::memory_order_acquire)) {
+                *index = top;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    // Slots holding an object ready to hand out
+    std::atomic<uint64_t> free_;
+    // Slots with nothing in them
+    std::atomic<uint64_t> unused_;
+    std::atomic<uint64_t> allocations_;
+    DISALLOW_COPY_AND_ASSIGN(ObjectPool);
+};
+
+template <typename T>
+const size_t ObjectPool<T>::kDefaultMaxFree;
+template <typename T>
+const uint32_t ObjectPool<T>::kNoSlot;
+
+// The pools a connection builds its requests from. The connection acquires a
+// Message and Command for each request and the sender releases them once the
+// request has been written.
+class RequestPools {
+    public:
+    RequestPools() : messages(), commands() {}
+    ObjectPool<Message> messages;
+    ObjectPool<Command> commands;
+
+    private:
+    DISALLOW_COPY_AND_ASSIGN(RequestPools);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_OBJECT_POOL_H_
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "pending_connection.h"
+
+namespace kinetic {
+
+using std::make_shared;
+
+PendingConnection::PendingConnection(const ConnectionOptions& options, shared_ptr<HmacProviderInterface> hmac_provider,
+    shared_ptr<TlsContext> tls_context)
+    : options_(options), hmac_provider_(hmac_provider->ForKey(options.hmac_key)),
+    socket_wrapper_(make_shared<SocketWrapper>(options.host, options.port, options.use_ssl, true,
+        tls_context)),
+    receiver_(), error_() {
+    if (!hmac_provider_) {
+        hmac_provider_ = hmac_provider;
+    }
+    if (options.use_ssl && options.kernel_tls) {
+        socket_wrapper_->EnableKernelTls();
+    }
+}
+
+NonblockingStringStatus PendingConnection::Run(IoInterest *interest) {
+    if (!receiver_) {
+        SocketWrapper::ConnectProgress progress = socket_wrapper_->ConnectNonblocking();
+        interest->fd = socket_wrapper_->fd();
+        interest->read = progress == SocketWrapper::kConnectWantRead;
+        interest->write = progress == SocketWrapper::kConnectWantWrite;
+        if (progress == SocketWrapper::kConnectFailed) {
+            error_ = "Could not connect to socket.";
+            return kFailed;
+        }
+        if (progress != SocketWrapper::kConnectDone) {
+            return kInProgress;
+        }
+        receiver_ = make_shared<NonblockingReceiver>(socket_wrapper_, hmac_provider_, options_, false);
+    }
+
+    interest->fd = socket_wrapper_->fd();
+    interest->read = false;
+    interest->write = false;
+    switch (receiver_->ReceiveHandshake()) {
+        case kIdle:
+            return kDone;
+        case kIoWait:
+            interest->read = true;
+            return kInProgress;
+        default:
+            error_ = "Could not complete handshake.";
+            return kFailed;
+    }
+}
+
+} // namespace kinetic
@@ -0,0 +1,74 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_PENDING_CONNECTION_H_
+#define KINETIC_CPP_CLIENT_PENDING_CONNECTION_H_
+
+#include <memory>
+#include <string>
+
+#include "kinetic/common.h"
+#include "kinetic/connection_options.h"
+#include "kinetic/hmac_provider.h"
+#include "kinetic/nonblocking_packet_service_interface.h"
+
+#include "nonblocking_packet_receiver.h"
+#include "nonblocking_string.h"
+#include "socket_wrapper.h"
+#include "tls_context.h"
+
+namespace kinetic {
+
+using std::shared_ptr;
+using std::string;
+
+// A connection on its way to being opened without blocking: the TCP connect,
+// then the TLS handshake if the options ask for one, then the drive's
+// unsolicited status. Whoever owns it calls Run whenever the socket becomes
+// ready as asked, so many of these can be driven from one event loop.
+class PendingConnection {
+    public:
+    // Throws if SSL can't be set up. TLS connections use tls_context.
+    PendingConnection(const ConnectionOptions& options, shared_ptr<HmacProviderInterface> hmac_provider,
+        shared_ptr<TlsContext> tls_context);
+
+    // Carries on as far as possible without blocking. Returns kInProgress
+    // with interest set to what to wait for before calling again, kDone once
+    // the handshake has been received, or kFailed with error() saying why.
+    NonblockingStringStatus Run(IoInterest *interest);
+
+    const string& error() const { return error_; }
+    // Only set once TCP and TLS connections are up
+    shared_ptr<NonblockingReceiver> receiver() { return receiver_; }
+    shared_ptr<SocketWrapper> socket_wrapper() { return socket_wrapper_; }
+    // What the connection's sender and receiver compute HMACs with, set up
+    // for this connection's key where the provider allows
+    shared_ptr<HmacProviderInterface> hmac_provider() { return hmac_provider_; }
+
+    private:
+    const ConnectionOptions options_;
+    shared_ptr<HmacProviderInterface> hmac_provider_;
+    shared_ptr<SocketWrapper> socket_wrapper_;
+    shared_ptr<NonblockingReceiver> receiver_;
+    string error_;
+    DISALLOW_COPY_AND_ASSIGN(PendingConnection);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_PENDING_CONNECTION_H_
@@ -0,0 +1,225 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "response_decoder.h"
+
+#include <cstdint>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite_inl.h>
+
+namespace kinetic {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+using com::seagate::kinetic::client::proto::Command_Algorithm;
+using com::seagate::kinetic::client::proto::Command_Algorithm_IsValid;
+using com::seagate::kinetic::client::proto::Command_Body;
+using com::seagate::kinetic::client::proto::Command_Header;
+using com::seagate::kinetic::client::proto::Command_KeyValue;
+using com::seagate::kinetic::client::proto::Command_MessageType;
+using com::seagate::kinetic::client::proto::Command_MessageType_IsValid;
+using com::seagate::kinetic::client::proto::Command_Status;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_IsValid;
+
+typedef WireFormatLite::WireType WireType;
+
+static bool ReadInt64(CodedInputStream *input, WireType type, int64_t *value) {
+    google::protobuf::uint64 raw;
+    if (type != WireFormatLite::WIRETYPE_VARINT || !input->ReadVarint64(&raw)) {
+        return false;
+    }
+    *value = static_cast<int64_t>(raw);
+    return true;
+}
+
+// Enum values this build doesn't know would end up among the unknown fields,
+// which only the full parser keeps
+template <typename Enum>
+static bool ReadEnum(CodedInputStream *input, WireType type, bool (*is_valid)(int), Enum *value) {
+    google::protobuf::uint32 raw;
+    if (type != WireFormatLite::WIRETYPE_VARINT || !input->ReadVarint32(&raw) ||
+            !is_valid(static_cast<int>(raw))) {
+        return false;
+    }
+    *value = static_cast<Enum>(raw);
+    return true;
+}
+
+static bool ReadBytes(CodedInputStream *input, WireType type, std::string *value) {
+    return type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED && WireFormatLite::ReadBytes(input, value);
+}
+
+// Reads fields into message until input runs out, handing each to
+// decode_field, which returns false for fields it doesn't handle
+template <typename T>
+static bool DecodeFields(CodedInputStream *input, T *message,
+        bool (*decode_field)(CodedInputStream *, int, WireType, T *)) {
+    while (true) {
+        google::protobuf::uint32 tag = input->ReadTag();
+        if (tag == 0) {
+            // Either the end of the message or something that isn't a tag
+            return input->ConsumedEntireMessage();
+        }
+        if (!decode_field(input, WireFormatLite::GetTagFieldNumber(tag),
+                WireFormatLite::GetTagWireType(tag), message)) {
+            return false;
+        }
+    }
+}
+
+template <typename T>
+static bool DecodeNested(CodedInputStream *input, WireType type, T *message,
+        bool (*decode_field)(CodedInputStream *, int, WireType, T *)) {
+    google::protobuf::uint32 length;
+    if (type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED || !input->ReadVarint32(&length)) {
+        return false;
+    }
+    CodedInputStream::Limit limit = input->PushLimit(length);
+    if (!DecodeFields(input, message, decode_field)) {
+        return false;
+    }
+    input->PopLimit(limit);
+    return true;
+}
+
+static bool DecodeHeaderField(CodedInputStream *input, int field, WireType type, Command_Header *header) {
+    int64_t value;
+    switch (field) {
+        case Command_Header::kClusterVersionFieldNumber:
+            if (!ReadInt64(input, type, &value)) {
+                return false;
+            }
+            header->set_clusterversion(value);
+            return true;
+        case Command_Header::kConnectionIDFieldNumber:
+            if (!ReadInt64(input, type, &value)) {
+                return false;
+            }
+            header->set_connectionid(value);
+            return true;
+        case Command_Header::kSequenceFieldNumber:
+            if (!ReadInt64(input, type, &value)) {
+                return false;
+            }
+            header->set_sequence(value);
+            return true;
+        case Command_Header::kAckSequenceFieldNumber:
+            if (!ReadInt64(input, type, &value)) {
+                return false;
+            }
+            header->set_acksequence(value);
+            return true;
+        case Command_Header::kMessageTypeFieldNumber: {
+            Command_MessageType message_type;
+            if (!ReadEnum(input, type, Command_MessageType_IsValid, &message_type)) {
+                return false;
+            }
+            header->set_messagetype(message_type);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool DecodeKeyValueField(CodedInputStream *input, int field, WireType type,
+        Command_KeyValue *key_value) {
+    switch (field) {
+        case Command_KeyValue::kNewVersionFieldNumber:
+            return ReadBytes(input, type, key_value->mutable_newversion());
+        case Command_KeyValue::kKeyFieldNumber:
+            return ReadBytes(input, type, key_value->mutable_key());
+        case Command_KeyValue::kDbVersionFieldNumber:
+            return ReadBytes(input, type, key_value->mutable_dbversion());
+        case Command_KeyValue::kTagFieldNumber:
+            return ReadBytes(input, type, key_value->mutable_tag());
+        case Command_KeyValue::kAlgorithmFieldNumber: {
+            Command_Algorithm algorithm;
+            if (!ReadEnum(input, type, Command_Algorithm_IsValid, &algorithm)) {
+                return false;
+            }
+            key_value->set_algorithm(algorithm);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool DecodeBodyField(CodedInputStream *input, int field, WireType type, Command_Body *body) {
+    if (field != Command_Body::kKeyValueFieldNumber) {
+        return false;
+    }
+    return DecodeNested(input, type, body->mutable_keyvalue(), DecodeKeyValueField);
+}
+
+static bool DecodeStatusField(CodedInputStream *input, int field, WireType type, Command_Status *status) {
+    switch (field) {
+        case Command_Status::kCodeFieldNumber: {
+            Command_Status_StatusCode code;
+            if (!ReadEnum(input, type, Command_Status_StatusCode_IsValid, &code)) {
+                return false;
+            }
+            status->set_code(code);
+            return true;
+        }
+        case Command_Status::kStatusMessageFieldNumber:
+            return ReadBytes(input, type, status->mutable_statusmessage());
+        case Command_Status::kDetailedMessageFieldNumber:
+            return ReadBytes(input, type, status->mutable_detailedmessage());
+        default:
+            return false;
+    }
+}
+
+static bool DecodeCommandField(CodedInputStream *input, int field, WireType type, Command *command) {
+    switch (field) {
+        case Command::kHeaderFieldNumber:
+            return DecodeNested(input, type, command->mutable_header(), DecodeHeaderField);
+        case Command::kBodyFieldNumber:
+            return DecodeNested(input, type, command->mutable_body(), DecodeBodyField);
+        case Command::kStatusFieldNumber:
+            return DecodeNested(input, type, command->mutable_status(), DecodeStatusField);
+        default:
+            return false;
+    }
+}
+
+bool DecodeHotResponse(const std::string& bytes, Command *command) {
+    command->Clear();
+    CodedInputStream input(reinterpret_cast<const google::protobuf::uint8 *>(bytes.data()), bytes.size());
+    if (!DecodeFields(&input, command, DecodeCommandField)) {
+        return false;
+    }
+
+    switch (command->header().messagetype()) {
+        case com::seagate::kinetic::client::proto::Command_MessageType_GET_RESPONSE:
+        case com::seagate::kinetic::client::proto::Command_MessageType_PUT_RESPONSE:
+        case com::seagate::kinetic::client::proto::Command_MessageType_DELETE_RESPONSE:
+        case com::seagate::kinetic::client::proto::Command_MessageType_GETVERSION_RESPONSE:
+        case com::seagate::kinetic::client::proto::Command_MessageType_NOOP_RESPONSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace kinetic
@@ -0,0 +1,45 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_RESPONSE_DECODER_H_
+#define KINETIC_CPP_CLIENT_RESPONSE_DECODER_H_
+
+#include <string>
+
+#include "kinetic_client.pb.h"
+
+namespace kinetic {
+
+using com::seagate::kinetic::client::proto::Command;
+
+// Decodes the commandBytes of the responses a busy client sees most: GET, PUT,
+// DELETE, GETVERSION and NOOP. Only the fields those carry are understood:
+// the header's sequence numbers, connection id, cluster version and message
+// type, the status, and the key, versions, tag and algorithm of the body's
+// key/value. That spares the generated parser's walk over every field Command
+// might have.
+//
+// Returns false if bytes hold any other field or message type, or aren't
+// valid, leaving command in an unspecified state; parse it with
+// ParseFromString then. When it returns true command is just what
+// ParseFromString would have made of bytes.
+bool DecodeHotResponse(const std::string& bytes, Command *command);
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_RESPONSE_DECODER_H_
@@ -18,34 +18,59 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #include <string>
 #include <exception>
 #include <stdexcept>
 #include "glog/logging.h"
 #include "socket_wrapper.h"
+#include "kernel_tls.h"
 
 namespace kinetic {
 
 using std::string;
 
-SocketWrapper::SocketWrapper(const std::string& host, int port, bool use_ssl, bool nonblocking)
-        : ctx_(NULL), ssl_(NULL), host_(host), port_(port), nonblocking_(nonblocking), fd_(-1) {
+// Hosts starting with this name a Unix domain socket rather than a TCP server
+static const char kUnixPrefix[] = "unix:";
+
+SocketWrapper::SocketWrapper(const std::string& host, int port, bool use_ssl, bool nonblocking,
+        std::shared_ptr<TlsContext> tls_context)
+        : tls_context_(), ssl_(NULL), host_(host), port_(port), nonblocking_(nonblocking), fd_(-1),
+        kernel_tls_(false), ktls_send_(false), ktls_receive_(false), connect_state_(kNotStarted),
+        unix_path_(), addresses_(NULL), next_address_(NULL) {
+    if (host_.compare(0, sizeof(kUnixPrefix) - 1, kUnixPrefix) == 0) {
+        unix_path_ = host_.substr(sizeof(kUnixPrefix) - 1);
+    }
     if(!use_ssl) return;
 
-    SSL_library_init();
-    OpenSSL_add_all_algorithms();
-    ctx_ = SSL_CTX_new(SSLv23_client_method());
-    ssl_ = SSL_new(ctx_);
-    if(!ssl_ || !ctx_)
+    tls_context_ = tls_context ? tls_context : std::make_shared<TlsContext>();
+    ssl_ = tls_context_->NewSSL(host_, port_);
+    if(!ssl_)
         throw std::runtime_error("Failed Setting up SSL environment.");
     SSL_set_mode(ssl_, SSL_MODE_AUTO_RETRY);
 }
 
 SocketWrapper::~SocketWrapper() {
+    if (ssl_ && connect_state_ == kConnected) {
+        // Send close_notify rather than just hanging up. OpenSSL won't let a
+        // session be resumed once a connection using it ends without one.
+        if (ktls_send_) {
+            // OpenSSL's record state is stale once the kernel has sent
+            // anything, so the alert has to go through the kernel too
+            SendKernelTlsCloseNotify(fd_);
+            SSL_set_shutdown(ssl_, SSL_SENT_SHUTDOWN);
+        } else {
+            SSL_shutdown(ssl_);
+        }
+    }
     if (fd_ == -1) {
         LOG(INFO) << "Not connected so no cleanup needed";
     } else {
@@ -54,11 +79,67 @@ SocketWrapper::~SocketWrapper() {
             PLOG(ERROR) << "Error closing socket fd " << fd_;
         }
     }
+    if (addresses_) freeaddrinfo(addresses_);
     if(ssl_) SSL_free(ssl_);
-    if(ctx_) SSL_CTX_free(ctx_);
 }
 
 bool SocketWrapper::Connect() {
+    ConnectProgress progress;
+    while ((progress = ConnectNonblocking()) == kConnectWantRead || progress == kConnectWantWrite) {
+        struct pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = progress == kConnectWantRead ? POLLIN : POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            PLOG(ERROR) << "Failed waiting for connection";
+            return false;
+        }
+    }
+    if (progress == kConnectFailed) {
+        return false;
+    }
+
+    if (!nonblocking_) {
+        int flags = fcntl(fd_, F_GETFL);
+        if (flags == -1 || fcntl(fd_, F_SETFL, flags & ~O_NONBLOCK) != 0) {
+            PLOG(ERROR) << "Failed to set socket blocking";
+            return false;
+        }
+    }
+    return true;
+}
+
+SocketWrapper::ConnectProgress SocketWrapper::ConnectNonblocking() {
+    switch (connect_state_) {
+        case kNotStarted:
+            break;
+        case kSocketConnecting: {
+            int error = 0;
+            socklen_t error_length = sizeof(error);
+            if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &error_length) != 0) {
+                error = errno;
+            }
+            if (error != 0) {
+                errno = error;
+                PLOG(WARNING) << "Unable to connect";
+                close(fd_);
+                fd_ = -1;
+                return ConnectNextAddress();
+            }
+            return FinishConnect();
+        }
+        case kSslConnecting:
+            return ConnectSSL();
+        case kConnected:
+            return kConnectDone;
+        case kFailed:
+            return kConnectFailed;
+    }
+
+    if (!unix_path_.empty()) {
+        return ConnectUnix();
+    }
+
     LOG(INFO) << "Connecting to " << host_ << ":" << port_;
 
     struct addrinfo hints;
@@ -70,19 +151,24 @@ bool SocketWrapper::Connect() {
     hints.ai_protocol = IPPROTO_TCP;
     hints.ai_flags = AI_NUMERICSERV;
 
-    struct addrinfo* result;
-
     string port_str = std::to_string(static_cast<long long>(port_));
 
-    if (int res = getaddrinfo(host_.c_str(), port_str.c_str(), &hints, &result) != 0) {
+    if (int res = getaddrinfo(host_.c_str(), port_str.c_str(), &hints, &addresses_) != 0) {
         LOG(ERROR) << "Could not resolve host " << host_ << " port " << port_ << ": "
                 << gai_strerror(res);
-        return false;
+        addresses_ = NULL;
+        connect_state_ = kFailed;
+        return kConnectFailed;
     }
+    next_address_ = addresses_;
+    return ConnectNextAddress();
+}
+
+SocketWrapper::ConnectProgress SocketWrapper::ConnectNextAddress() {
+    while (next_address_ != NULL) {
+        struct addrinfo* ai = next_address_;
+        next_address_ = ai->ai_next;
 
-    struct addrinfo* ai;
-    int socket_fd;
-    for (ai = result; ai != NULL; ai = ai->ai_next) {
         char host[NI_MAXHOST];
         char service[NI_MAXSERV];
         if (int res = getnameinfo(ai->ai_addr, ai->ai_addrlen, host, sizeof(host), service,
@@ -93,94 +179,205 @@ bool SocketWrapper::Connect() {
             LOG(INFO) << "Trying to connect to " << string(host) << " on " << string(service);
         }
 
-        socket_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-
+        int socket_fd = OpenSocket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
         if (socket_fd == -1) {
-            LOG(WARNING) << "Could not create socket";
             continue;
         }
 
-        // os x won't let us set close-on-exec when creating the socket, so set it separately
-        int current_fd_flags = fcntl(socket_fd, F_GETFD);
-        if (current_fd_flags == -1) {
-            PLOG(ERROR) << "Failed to get socket fd flags";
-            close(socket_fd);
-            continue;
+        fd_ = socket_fd;
+        if (connect(socket_fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            return FinishConnect();
         }
-        if (fcntl(socket_fd, F_SETFD, current_fd_flags | FD_CLOEXEC) == -1) {
-            PLOG(ERROR) << "Failed to set socket close-on-exit";
-            close(socket_fd);
-            continue;
+        if (errno == EINPROGRESS) {
+            connect_state_ = kSocketConnecting;
+            return kConnectWantWrite;
         }
+        PLOG(WARNING) << "Unable to connect";
+        close(socket_fd);
+        fd_ = -1;
+    }
 
-        // On BSD-like systems we can set SO_NOSIGPIPE on the socket to prevent it from sending a
-        // PIPE signal and bringing down the whole application if the server closes the socket
-        // forcibly
-#ifdef SO_NOSIGPIPE
-        int set = 1;
-        int setsockopt_result = setsockopt(socket_fd, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof(set));
-        // Allow ENOTSOCK because it allows tests to use pipes instead of real sockets
-        if (setsockopt_result != 0 && setsockopt_result != ENOTSOCK) {
-            PLOG(ERROR) << "Failed to set SO_NOSIGPIPE on socket";
-            close(socket_fd);
-            continue;
-        }
-#endif
+    // we went through all addresses without finding one we could bind to
+    LOG(ERROR) << "Could not connect to " << host_ << " on port " << port_;
+    if (addresses_) freeaddrinfo(addresses_);
+    addresses_ = NULL;
+    connect_state_ = kFailed;
+    return kConnectFailed;
+}
 
-        if (connect(socket_fd, ai->ai_addr, ai->ai_addrlen) == -1) {
-            PLOG(WARNING) << "Unable to connect";
-            close(socket_fd);
-            continue;
-        }
+SocketWrapper::ConnectProgress SocketWrapper::ConnectUnix() {
+    LOG(INFO) << "Connecting to " << unix_path_;
 
-        if (nonblocking_ && fcntl(socket_fd, F_SETFL, O_NONBLOCK) != 0) {
-            PLOG(ERROR) << "Failed to set socket nonblocking";
-            close(socket_fd);
-            continue;
-        }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (unix_path_.size() >= sizeof(addr.sun_path)) {
+        LOG(ERROR) << "Socket path " << unix_path_ << " is too long";
+        connect_state_ = kFailed;
+        return kConnectFailed;
+    }
+    memcpy(addr.sun_path, unix_path_.c_str(), unix_path_.size() + 1);
+
+    fd_ = OpenSocket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ == -1) {
+        connect_state_ = kFailed;
+        return kConnectFailed;
+    }
+    if (connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0) {
+        return FinishConnect();
+    }
+    if (errno == EINPROGRESS) {
+        connect_state_ = kSocketConnecting;
+        return kConnectWantWrite;
+    }
+    // A full backlog shows up as EAGAIN rather than as a connect to wait on
+    PLOG(ERROR) << "Could not connect to " << unix_path_;
+    close(fd_);
+    fd_ = -1;
+    connect_state_ = kFailed;
+    return kConnectFailed;
+}
 
-        break;
+// Creates a socket set up the way every connection wants it, or returns -1
+int SocketWrapper::OpenSocket(int family, int type, int protocol) {
+    int socket_fd = socket(family, type, protocol);
+    if (socket_fd == -1) {
+        LOG(WARNING) << "Could not create socket";
+        return -1;
     }
 
-    freeaddrinfo(result);
+    // os x won't let us set close-on-exec when creating the socket, so set it separately
+    int current_fd_flags = fcntl(socket_fd, F_GETFD);
+    if (current_fd_flags == -1) {
+        PLOG(ERROR) << "Failed to get socket fd flags";
+        close(socket_fd);
+        return -1;
+    }
+    if (fcntl(socket_fd, F_SETFD, current_fd_flags | FD_CLOEXEC) == -1) {
+        PLOG(ERROR) << "Failed to set socket close-on-exit";
+        close(socket_fd);
+        return -1;
+    }
 
-    if (ai == NULL) {
-        // we went through all addresses without finding one we could bind to
-        LOG(ERROR) << "Could not connect to " << host_ << " on port " << port_;
-        return false;
+    // On BSD-like systems we can set SO_NOSIGPIPE on the socket to prevent it from sending a
+    // PIPE signal and bringing down the whole application if the server closes the socket
+    // forcibly
+#ifdef SO_NOSIGPIPE
+    int set = 1;
+    int setsockopt_result = setsockopt(socket_fd, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof(set));
+    // Allow ENOTSOCK because it allows tests to use pipes instead of real sockets
+    if (setsockopt_result != 0 && setsockopt_result != ENOTSOCK) {
+        PLOG(ERROR) << "Failed to set SO_NOSIGPIPE on socket";
+        close(socket_fd);
+        return -1;
     }
+#endif
 
-    fd_ = socket_fd;
-    if(ssl_) return ConnectSSL();
-    return true;
+    // The socket is nonblocking while connecting even if the caller wants
+    // it blocking in the end, so that connecting can be waited on alongside
+    // other sockets
+    if (fcntl(socket_fd, F_SETFL, O_NONBLOCK) != 0) {
+        PLOG(ERROR) << "Failed to set socket nonblocking";
+        close(socket_fd);
+        return -1;
+    }
+
+    return socket_fd;
+}
+
+SocketWrapper::ConnectProgress SocketWrapper::FinishConnect() {
+    if (addresses_) freeaddrinfo(addresses_);
+    addresses_ = next_address_ = NULL;
+
+    // Packets are handed to the kernel whole, so there's nothing to gain
+    // from Nagle's algorithm delaying the tail of a request
+    int nodelay = 1;
+    if (unix_path_.empty() &&
+            setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+        PLOG(WARNING) << "Failed to set TCP_NODELAY on socket";
+    }
+
+    if (ssl_) {
+        SSL_set_fd(ssl_, fd_);
+        connect_state_ = kSslConnecting;
+        return ConnectSSL();
+    }
+    connect_state_ = kConnected;
+    return kConnectDone;
 }
 
 #include <openssl/err.h>
 
-bool SocketWrapper::ConnectSSL()
+SocketWrapper::ConnectProgress SocketWrapper::ConnectSSL()
 {
-    SSL_set_fd(ssl_,fd_);
     int rtn = SSL_connect(ssl_);
-    if(rtn == 1)
-        return true;
+    if (rtn == 1) {
+        if (SSL_session_reused(ssl_)) {
+            LOG(INFO) << "Resumed TLS session with " << host_ << ":" << port_;
+        }
+        if (kernel_tls_) {
+            StartKernelTls();
+        }
+        connect_state_ = kConnected;
+        return kConnectDone;
+    }
 
     int err = SSL_get_error(ssl_, rtn);
-    if( err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ){
-        fd_set read_fds, write_fds;
-        FD_ZERO(&read_fds); FD_ZERO(&write_fds);
-        if(err == SSL_ERROR_WANT_READ)  FD_SET(fd_, &read_fds);
-        if(err == SSL_ERROR_WANT_WRITE) FD_SET(fd_, &write_fds);
-        struct timeval tv = {1,1};
-        select(fd_+1, &read_fds, &write_fds, NULL, &tv);
-        return ConnectSSL();
-    }
-    return false;
+    if (err == SSL_ERROR_WANT_READ)
+        return kConnectWantRead;
+    if (err == SSL_ERROR_WANT_WRITE)
+        return kConnectWantWrite;
+    LOG(ERROR) << "TLS handshake with " << host_ << " failed";
+    // In case it was the session we offered that the drive objected to
+    tls_context_->ForgetSession(host_, port_);
+    connect_state_ = kFailed;
+    return kConnectFailed;
 }
 
 SSL * SocketWrapper::getSSL(){
     return ssl_;
 }
 
+bool SocketWrapper::is_socket() {
+    return true;
+}
+
+void SocketWrapper::EnableKernelTls() {
+    kernel_tls_ = true;
+    // Anything OpenSSL reads past the end of the handshake would be lost to
+    // the kernel, so only read whole records until then
+    SSL_set_read_ahead(ssl_, 0);
+}
+
+void SocketWrapper::StartKernelTls() {
+    TlsRecordKeys keys;
+    if (!GetTlsRecordKeys(ssl_, &keys)) {
+        LOG(INFO) << "The kernel can't take over TLS with " << host_ << ":" << port_ << " using "
+            << SSL_get_version(ssl_) << " " << SSL_get_cipher_name(ssl_);
+    } else {
+        ktls_send_ = StartKernelTlsSend(fd_, keys);
+        if (ktls_send_ && !keys.read_buffered) {
+            ktls_receive_ = StartKernelTlsReceive(fd_, keys);
+        }
+        if (ktls_send_) {
+            LOG(INFO) << "Kernel TLS enabled for sends " << (ktls_receive_ ? "and receives " : "") << "to "
+                << host_ << ":" << port_;
+        }
+    }
+    if (!ktls_receive_) {
+        // Back to reading ahead as the context has it
+        SSL_set_read_ahead(ssl_, 1);
+    }
+}
+
+bool SocketWrapper::ktls_send() {
+    return ktls_send_;
+}
+
+bool SocketWrapper::ktls_receive() {
+    return ktls_receive_;
+}
+
 int SocketWrapper::fd() {
     return fd_;
 }
@@ -18,29 +18,82 @@
 #ifndef KINETIC_CPP_CLIENT_SOCKET_WRAPPER_H_
 #define KINETIC_CPP_CLIENT_SOCKET_WRAPPER_H_
 
+#include <netdb.h>
+
+#include <memory>
+
 #include "socket_wrapper_interface.h"
 #include "kinetic/connection_options.h"
+#include "tls_context.h"
 
 
 namespace kinetic {
 
 class SocketWrapper : public SocketWrapperInterface {
   public:
-    explicit SocketWrapper(const std::string &host, int port, bool use_ssl, bool nonblocking = false);
+    // How far ConnectNonblocking has got
+    enum ConnectProgress {
+        kConnectDone,
+        kConnectWantRead,   // call again once fd() is readable
+        kConnectWantWrite,  // call again once fd() is writable
+        kConnectFailed
+    };
+
+    // With use_ssl set, the connection shares tls_context's SSL_CTX and
+    // session cache, or has a context of its own if tls_context is NULL
+    explicit SocketWrapper(const std::string &host, int port, bool use_ssl, bool nonblocking = false,
+        std::shared_ptr<TlsContext> tls_context = std::shared_ptr<TlsContext>());
     bool Connect();
+    // Opens the connection without waiting on the network. The first call
+    // resolves the host and starts a TCP connect, or a connect to the Unix
+    // domain socket if host is "unix:" followed by its path, and each later call, made
+    // once fd() is ready as asked, carries on from there through the TLS
+    // handshake if there is one. fd() can change between calls while
+    // addresses are being tried.
+    ConnectProgress ConnectNonblocking();
+    // Hands the connection's record encryption to the kernel once the TLS
+    // handshake is done. Call before connecting, on a connection using SSL.
+    // Whether the kernel and the negotiated cipher allow it is only known
+    // afterwards, see ktls_send and ktls_receive.
+    void EnableKernelTls();
     int  fd();
     SSL *getSSL();
+    bool is_socket();
+    bool ktls_send();
+    bool ktls_receive();
     ~SocketWrapper();
 
   private:
-    bool ConnectSSL();
+    enum ConnectState {
+        kNotStarted,
+        kSocketConnecting,
+        kSslConnecting,
+        kConnected,
+        kFailed
+    };
+
+    ConnectProgress ConnectNextAddress();
+    ConnectProgress ConnectUnix();
+    int OpenSocket(int family, int type, int protocol);
+    ConnectProgress FinishConnect();
+    ConnectProgress ConnectSSL();
+    void StartKernelTls();
 
-    SSL_CTX * ctx_;
+    std::shared_ptr<TlsContext> tls_context_;
     SSL * ssl_;
     std::string host_;
     int port_;
     bool nonblocking_;
     int fd_;
+    bool kernel_tls_;
+    bool ktls_send_;
+    bool ktls_receive_;
+    ConnectState connect_state_;
+    // Set if host_ names a Unix domain socket
+    std::string unix_path_;
+    // Addresses the host resolved to, and the next one to try
+    struct addrinfo *addresses_;
+    struct addrinfo *next_address_;
 };
 
 } // namespace kinetic
@@ -38,6 +38,21 @@ class SocketWrapperInterface {
     /// Returns nullptr if SSL hasn't been initialized.
     virtual SSL* getSSL() = 0;
 
+    /// Returns true if the FD is a socket rather than e.g. a pipe. This is
+    /// fixed when the connection is opened so that the I/O path can pick
+    /// send/recv versus write/read without checking on every call.
+    virtual bool is_socket() = 0;
+
+    /// Returns true if an SSL connection's outgoing records are encrypted by
+    /// the kernel (kTLS), so that plain writes to the FD go out encrypted and
+    /// don't have to go through SSL_write
+    virtual bool ktls_send() = 0;
+
+    /// Returns true if an SSL connection's incoming records are decrypted by
+    /// the kernel, so that plain reads from the FD return what the server sent
+    /// and don't have to go through SSL_read
+    virtual bool ktls_receive() = 0;
+
     /// The destructor should close the FD if it was opened
     /// by connect
     virtual ~SocketWrapperInterface() {}
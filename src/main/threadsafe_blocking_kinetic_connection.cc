@@ -34,31 +34,54 @@ ThreadsafeBlockingKineticConnection::ThreadsafeBlockingKineticConnection(
 ThreadsafeBlockingKineticConnection::~ThreadsafeBlockingKineticConnection() {}
 
 KineticStatus ThreadsafeBlockingKineticConnection::NoOp() {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->NoOp();
 }
 
 void ThreadsafeBlockingKineticConnection::SetClientClusterVersion(int64_t cluster_version) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetClientClusterVersion(cluster_version);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Get(const shared_ptr<const string> key,
     unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Get(key, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Get(const string& key, unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Get(key, record);
 }
 
+KineticStatus ThreadsafeBlockingKineticConnection::GetInto(const shared_ptr<const string> key, char *buffer,
+    size_t capacity, size_t *value_size) {
+    return connection_->GetInto(key, buffer, capacity, value_size);
+}
+
+KineticStatus ThreadsafeBlockingKineticConnection::GetInto(const string& key, char *buffer, size_t capacity,
+    size_t *value_size) {
+    return connection_->GetInto(key, buffer, capacity, value_size);
+}
+
+KineticStatus ThreadsafeBlockingKineticConnection::GetInto(const shared_ptr<const string> key, string *value) {
+    return connection_->GetInto(key, value);
+}
+
+KineticStatus ThreadsafeBlockingKineticConnection::GetInto(const string& key, string *value) {
+    return connection_->GetInto(key, value);
+}
+
+KineticStatus ThreadsafeBlockingKineticConnection::GetToFile(const shared_ptr<const string> key, int fd,
+    off_t offset, size_t *value_size) {
+    return connection_->GetToFile(key, fd, offset, value_size);
+}
+
+KineticStatus ThreadsafeBlockingKineticConnection::GetToFile(const string& key, int fd, off_t offset,
+    size_t *value_size) {
+    return connection_->GetToFile(key, fd, offset, value_size);
+}
+
 KineticStatus ThreadsafeBlockingKineticConnection::Put(const shared_ptr<const string> key,
         const shared_ptr<const string> current_version, WriteMode mode,
         const shared_ptr<const KineticRecord> record,
         PersistMode persistMode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Put(key, current_version, mode, record, persistMode);
 }
 
@@ -66,168 +89,138 @@ KineticStatus ThreadsafeBlockingKineticConnection::Put(const string& key,
         const string& current_version, WriteMode mode,
         const KineticRecord& record,
         PersistMode persistMode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Put(key, current_version, mode, record, persistMode);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Put(const shared_ptr<const string> key,
         const shared_ptr<const string> current_version, WriteMode mode,
         const shared_ptr<const KineticRecord> record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Put(key, current_version, mode, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Put(const string& key,
         const string& current_version, WriteMode mode,
         const KineticRecord& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Put(key, current_version, mode, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Delete(const shared_ptr<const string> key,
             const shared_ptr<const string> version, WriteMode mode, PersistMode persistMode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Delete(key, version, mode, persistMode);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Delete(const string& key, const string& version,
             WriteMode mode, PersistMode persistMode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Delete(key, version, mode, persistMode);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Delete(const shared_ptr<const string> key,
             const shared_ptr<const string> version, WriteMode mode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Delete(key, version, mode);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::Delete(const string& key, const string& version, WriteMode mode) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->Delete(key, version, mode);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::InstantErase(const shared_ptr<string> pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->InstantErase(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::InstantErase(const string& pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->InstantErase(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SecureErase(const shared_ptr<string> pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->InstantErase(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SecureErase(const string& pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->InstantErase(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetClusterVersion(int64_t new_cluster_version) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetClusterVersion(new_cluster_version);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetLog(unique_ptr<DriveLog>& drive_log) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetLog(drive_log);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetLog(const vector<Command_GetLog_Type>& types, unique_ptr<DriveLog>& drive_log) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetLog(types, drive_log);
 }
 
 
 KineticStatus ThreadsafeBlockingKineticConnection::UpdateFirmware(const shared_ptr<const string>
         new_firmware) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->UpdateFirmware(new_firmware);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetACLs(const shared_ptr<const list<ACL>> acls) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetACLs(acls);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetErasePIN(const shared_ptr<const string> new_pin,
     const shared_ptr<const string> current_pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetErasePIN(new_pin, current_pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetErasePIN(const string& new_pin, const string& current_pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetErasePIN(new_pin, current_pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetLockPIN(const shared_ptr<const string> new_pin,
     const shared_ptr<const string> current_pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetLockPIN(new_pin, current_pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::SetLockPIN(const string& new_pin, const string& current_pin) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->SetLockPIN(new_pin, current_pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::LockDevice(const shared_ptr<string> pin){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->LockDevice(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::LockDevice(const string& pin){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->LockDevice(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::UnlockDevice(const shared_ptr<string> pin){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->UnlockDevice(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::UnlockDevice(const string& pin){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->UnlockDevice(pin);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetNext(const shared_ptr<const string> key,
         unique_ptr<string>& actual_key, unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetNext(key, actual_key, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetNext( const string& key, unique_ptr<string>& actual_key, unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetNext(key, actual_key, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetPrevious(const shared_ptr<const string> key,
         unique_ptr<string>& actual_key, unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetPrevious(key, actual_key, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetPrevious(const string& key,
         unique_ptr<string>& actual_key,
         unique_ptr<KineticRecord>& record) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetPrevious(key, actual_key, record);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetVersion(const shared_ptr<const string> key,
         unique_ptr<string>& version) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetVersion(key, version);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::GetVersion(const string& key, unique_ptr<string>& version){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetVersion(key, version);
 }
 
@@ -238,7 +231,6 @@ KineticStatus ThreadsafeBlockingKineticConnection::GetKeyRange(const shared_ptr<
         bool reverse_results,
         int32_t max_results,
         unique_ptr<vector<string>>& keys) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetKeyRange(start_key,
             start_key_inclusive,
             end_key,
@@ -255,7 +247,6 @@ KineticStatus ThreadsafeBlockingKineticConnection::GetKeyRange(const string& sta
         bool reverse_results,
         int32_t max_results,
         unique_ptr<vector<string>>& keys) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->GetKeyRange(start_key,
             start_key_inclusive,
             end_key,
@@ -271,7 +262,6 @@ KeyRangeIterator ThreadsafeBlockingKineticConnection::IterateKeyRange(
         const shared_ptr<const string> end_key,
         bool end_key_inclusive,
         unsigned int frame_size) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->IterateKeyRange(start_key,
             start_key_inclusive,
             end_key,
@@ -284,7 +274,6 @@ KeyRangeIterator ThreadsafeBlockingKineticConnection::IterateKeyRange(const stri
         const string& end_key,
         bool end_key_inclusive,
         unsigned int frame_size){
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->IterateKeyRange(start_key,
             start_key_inclusive,
             end_key,
@@ -295,13 +284,11 @@ KeyRangeIterator ThreadsafeBlockingKineticConnection::IterateKeyRange(const stri
 KineticStatus ThreadsafeBlockingKineticConnection::P2PPush(
         const shared_ptr<const P2PPushRequest> push_request,
         unique_ptr<vector<KineticStatus>>& operation_statuses) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->P2PPush(push_request, operation_statuses);
 }
 
 KineticStatus ThreadsafeBlockingKineticConnection::P2PPush(const P2PPushRequest& push_request,
         unique_ptr<vector<KineticStatus>>& operation_statuses) {
-    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return connection_->P2PPush(push_request, operation_statuses);
 }
 
@@ -0,0 +1,135 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "tls_context.h"
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+using std::lock_guard;
+using std::mutex;
+
+static std::once_flag ssl_init_flag;
+// Index of the ex_data slot holding the host:port key of each SSL's drive
+static int key_index = -1;
+
+static void FreeKey(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl, void *argp) {
+    delete static_cast<string *>(ptr);
+}
+
+static void InitSSL() {
+    SSL_library_init();
+    OpenSSL_add_all_algorithms();
+    key_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, FreeKey);
+}
+
+TlsContext::TlsContext() : ctx_(NULL), mutex_(), sessions_() {
+    std::call_once(ssl_init_flag, InitSSL);
+    ctx_ = SSL_CTX_new(SSLv23_client_method());
+    if (ctx_ == NULL) {
+        LOG(ERROR) << "Failed to create SSL context";
+        return;
+    }
+    SSL_CTX_set_app_data(ctx_, this);
+    // OpenSSL only hands sessions to the callback with client caching on. The
+    // internal store is for servers looking sessions up by id, which a client
+    // never does.
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, NewSessionCallback);
+    // Let each read from the socket pick up as many records as have arrived
+    // rather than just the one being decrypted. Readers keep calling SSL_read
+    // until it wants more, so nothing is left stranded in OpenSSL's buffer.
+    SSL_CTX_set_read_ahead(ctx_, 1);
+}
+
+TlsContext::~TlsContext() {
+    for (auto it = sessions_.begin(); it != sessions_.end(); ++it) {
+        SSL_SESSION_free(it->second);
+    }
+    if (ctx_ != NULL) {
+        SSL_CTX_free(ctx_);
+    }
+}
+
+SSL *TlsContext::NewSSL(const string &host, int port) {
+    if (ctx_ == NULL) {
+        return NULL;
+    }
+    SSL *ssl = SSL_new(ctx_);
+    if (ssl == NULL) {
+        return NULL;
+    }
+    string *key = new string(Key(host, port));
+    if (!SSL_set_ex_data(ssl, key_index, key)) {
+        delete key;
+        SSL_free(ssl);
+        return NULL;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    auto it = sessions_.find(*key);
+    if (it != sessions_.end()) {
+        // Takes its own reference, so the session can be replaced meanwhile
+        SSL_set_session(ssl, it->second);
+    }
+    return ssl;
+}
+
+void TlsContext::ForgetSession(const string &host, int port) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = sessions_.find(Key(host, port));
+    if (it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        sessions_.erase(it);
+    }
+}
+
+size_t TlsContext::sessions() {
+    lock_guard<mutex> lock(mutex_);
+    return sessions_.size();
+}
+
+int TlsContext::NewSessionCallback(SSL *ssl, SSL_SESSION *session) {
+    TlsContext *context = static_cast<TlsContext *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    string *key = static_cast<string *>(SSL_get_ex_data(ssl, key_index));
+    if (context == NULL || key == NULL) {
+        return 0;
+    }
+    context->SaveSession(*key, session);
+    // Tells OpenSSL we've kept the reference it passed us
+    return 1;
+}
+
+string TlsContext::Key(const string &host, int port) {
+    return host + ":" + std::to_string(static_cast<long long>(port));
+}
+
+void TlsContext::SaveSession(const string &key, SSL_SESSION *session) {
+    lock_guard<mutex> lock(mutex_);
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+    } else {
+        sessions_[key] = session;
+    }
+}
+
+} // namespace kinetic
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_TLS_CONTEXT_H_
+#define KINETIC_CPP_CLIENT_TLS_CONTEXT_H_
+
+#include <openssl/ssl.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "kinetic/common.h"
+
+namespace kinetic {
+
+using std::string;
+using std::unordered_map;
+
+// The SSL_CTX shared by all the TLS connections a KineticConnectionFactory
+// opens, along with the most recent session for each drive. A connection to a
+// drive that has been connected to before offers that session, so the drive
+// can resume it instead of doing a full handshake. Safe to use from several
+// threads.
+class TlsContext {
+    public:
+    TlsContext();
+    ~TlsContext();
+
+    // NULL if OpenSSL couldn't set up a context
+    SSL_CTX *ctx() { return ctx_; }
+
+    // Creates an SSL for connecting to the drive at host:port, set up to
+    // resume the last session with it if there is one. Returns NULL on failure.
+    SSL *NewSSL(const string &host, int port);
+
+    // Drops the session kept for host:port, for when resuming it failed
+    void ForgetSession(const string &host, int port);
+
+    // Number of drives with a session kept
+    size_t sessions();
+
+    private:
+    static int NewSessionCallback(SSL *ssl, SSL_SESSION *session);
+    static string Key(const string &host, int port);
+    void SaveSession(const string &key, SSL_SESSION *session);
+
+    SSL_CTX *ctx_;
+    std::mutex mutex_;
+    unordered_map<string, SSL_SESSION *> sessions_;
+    DISALLOW_COPY_AND_ASSIGN(TlsContext);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_TLS_CONTEXT_H_
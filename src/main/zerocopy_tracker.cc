@@ -0,0 +1,106 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include "zerocopy_tracker.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#include "glog/logging.h"
+
+namespace kinetic {
+
+ZerocopyTracker::ZerocopyTracker(int fd, size_t threshold)
+    : fd_(fd), threshold_(threshold), copied_(false), next_id_(0), pending_() {}
+
+bool ZerocopyTracker::Enable() {
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    int one = 1;
+    if (setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+        PLOG(WARNING) << "Failed to enable SO_ZEROCOPY";
+        return false;
+    }
+    return true;
+#else
+    LOG(WARNING) << "MSG_ZEROCOPY isn't supported on this platform";
+    return false;
+#endif
+}
+
+bool ZerocopyTracker::ShouldUse(size_t value_size) const {
+    return !copied_ && value_size >= threshold_;
+}
+
+void ZerocopyTracker::Sent(const PacketValue& value) {
+    pending_.push_back(std::make_pair(next_id_++, value));
+}
+
+void ZerocopyTracker::Reap() {
+#if defined(__linux__) && defined(SO_EE_ORIGIN_ZEROCOPY)
+    while (!pending_.empty()) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        // Reading the error queue never blocks; it fails with EAGAIN when empty
+        if (recvmsg(fd_, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool is_recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!is_recverr) {
+                continue;
+            }
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                copied_ = true;
+            }
+            Complete(err.ee_info, err.ee_data);
+        }
+    }
+#endif
+}
+
+void ZerocopyTracker::Complete(uint32_t first, uint32_t last) {
+    // Completions usually arrive in order, so this normally only looks at the
+    // front of the queue. The comparison copes with the ids wrapping.
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (it->first - first <= last - first) {
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace kinetic
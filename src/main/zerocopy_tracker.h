@@ -0,0 +1,79 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_ZEROCOPY_TRACKER_H_
+#define KINETIC_CPP_CLIENT_ZEROCOPY_TRACKER_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <utility>
+
+#include "kinetic/common.h"
+#include "kinetic/packet_value.h"
+
+namespace kinetic {
+
+using std::deque;
+using std::pair;
+
+// Keeps track of values sent on one socket with MSG_ZEROCOPY. The kernel
+// sends such values straight out of their pages, so they have to stay alive
+// until it reports on the socket's error queue that it's finished with them.
+// The kernel numbers zerocopy sends on a socket 0, 1, 2... and reports
+// completions as ranges of those numbers.
+class ZerocopyTracker {
+    public:
+    // Values of at least threshold bytes are sent with MSG_ZEROCOPY
+    ZerocopyTracker(int fd, size_t threshold);
+
+    // Turns on SO_ZEROCOPY for the socket. Returns false if the platform or
+    // socket doesn't support it, in which case the tracker mustn't be used.
+    bool Enable();
+
+    // Whether a value of value_size bytes should be sent with MSG_ZEROCOPY.
+    // Once the kernel reports that it had to copy a send anyway (which it
+    // does over loopback, for example) there's nothing to gain, so this is
+    // always false from then on.
+    bool ShouldUse(size_t value_size) const;
+
+    // Records a successful send with MSG_ZEROCOPY of part of value, which is
+    // held until the kernel is done with that send
+    void Sent(const PacketValue& value);
+
+    // Releases values whose sends the kernel has finished with. Never blocks.
+    void Reap();
+
+    // Number of sends the kernel hasn't reported on yet
+    size_t pending() const { return pending_.size(); }
+
+    private:
+    void Complete(uint32_t first, uint32_t last);
+
+    const int fd_;
+    const size_t threshold_;
+    bool copied_;
+    // The number the kernel will give the next zerocopy send
+    uint32_t next_id_;
+    deque<pair<uint32_t, PacketValue>> pending_;
+    DISALLOW_COPY_AND_ASSIGN(ZerocopyTracker);
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_ZEROCOPY_TRACKER_H_
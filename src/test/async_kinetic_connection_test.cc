@@ -0,0 +1,116 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "stand_in_drive.h"
+
+namespace kinetic {
+
+using std::future;
+using std::make_shared;
+using std::string;
+using std::vector;
+
+class AsyncKineticConnectionTest : public ::testing::Test {
+    protected:
+    AsyncKineticConnectionTest() : drive_(100, true) {}
+
+    void SetUp() {
+        drive_.Expect();
+        KineticConnectionFactory factory = NewKineticConnectionFactory();
+        shared_ptr<NonblockingKineticConnection> connection;
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive_.options(), connection).ok());
+        connection_.reset(new AsyncKineticConnection(connection));
+    }
+
+    StandInDrive drive_;
+    unique_ptr<AsyncKineticConnection> connection_;
+};
+
+TEST_F(AsyncKineticConnectionTest, FuturesCarryResults) {
+    future<KineticStatus> noop = connection_->NoOp();
+    future<GetResult> get = connection_->Get("key");
+    ASSERT_TRUE(connection_->Wait(get, 10000));
+    // Requests go out in order, so the NoOp is done too
+    ASSERT_TRUE(noop.get().ok());
+
+    GetResult result = get.get();
+    ASSERT_TRUE(result.status.ok());
+    ASSERT_EQ(string(100, 'v'), *result.record->value());
+}
+
+TEST_F(AsyncKineticConnectionTest, WhenAllCollectsFannedOutRequests) {
+    auto record = make_shared<KineticRecord>("value", "version", "tag",
+        com::seagate::kinetic::client::proto::Command_Algorithm_SHA1);
+    vector<future<KineticStatus>> puts;
+    for (int i = 0; i < 32; i++) {
+        puts.push_back(connection_->Put("key" + std::to_string(i), "", WriteMode::IGNORE_VERSION, record));
+    }
+    future<vector<KineticStatus>> all = connection_->WhenAll(std::move(puts));
+    ASSERT_TRUE(connection_->Wait(all, 10000));
+
+    vector<KineticStatus> statuses = all.get();
+    ASSERT_EQ(32u, statuses.size());
+    for (auto it = statuses.begin(); it != statuses.end(); ++it) {
+        ASSERT_TRUE(it->ok());
+    }
+}
+
+TEST_F(AsyncKineticConnectionTest, WhenAllOfFinishedFuturesIsReady) {
+    vector<future<KineticStatus>> noops;
+    noops.push_back(connection_->NoOp());
+    noops.push_back(connection_->NoOp());
+    ASSERT_TRUE(connection_->WaitAll(noops, 10000));
+
+    future<vector<KineticStatus>> all = connection_->WhenAll(std::move(noops));
+    ASSERT_EQ(std::future_status::ready, all.wait_for(std::chrono::seconds(0)));
+    ASSERT_EQ(2u, all.get().size());
+}
+
+TEST_F(AsyncKineticConnectionTest, WhenAllIsReadyWhenTheConnectionFails) {
+    vector<future<KineticStatus>> noops;
+    noops.push_back(connection_->NoOp());
+    noops.push_back(connection_->NoOp());
+    future<vector<KineticStatus>> all = connection_->WhenAll(std::move(noops));
+
+    auto connection = connection_->connection();
+    connection_.reset();
+    connection.reset();
+    ASSERT_EQ(std::future_status::ready, all.wait_for(std::chrono::seconds(0)));
+    vector<KineticStatus> statuses = all.get();
+    ASSERT_EQ(2u, statuses.size());
+    ASSERT_FALSE(statuses[0].ok());
+    ASSERT_FALSE(statuses[1].ok());
+}
+
+TEST_F(AsyncKineticConnectionTest, FuturesFailWithTheConnection) {
+    auto connection = connection_->connection();
+    future<KineticStatus> noop = connection_->NoOp();
+    connection_.reset();
+    // Dropping the last reference to the connection fails what it still has
+    connection.reset();
+    ASSERT_FALSE(noop.get().ok());
+}
+
+} // namespace kinetic
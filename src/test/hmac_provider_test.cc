@@ -15,6 +15,10 @@
  * See www.openkinetic.org for more project information
  */
 
+#include <arpa/inet.h>
+
+#include <openssl/hmac.h>
+
 #include "gtest/gtest.h"
 
 #include "kinetic_client.pb.h"
@@ -126,5 +130,49 @@ TEST(HmacProviderTest, ValidateHmacReturnsFalseOnInvalidHmac) {
     EXPECT_FALSE(hmac_provider.ValidateHmac(message, "asdfasdf"));
 }
 
+TEST(HmacProviderTest, ProvidersForAKeyMatchOpenssl) {
+    HmacProvider hmac_provider;
+    std::string command_bytes("command");
+    std::string prefixed(4, '\0');
+    uint32_t length = htonl(command_bytes.size());
+    memcpy(&prefixed[0], &length, sizeof(length));
+    prefixed += command_bytes;
+
+    // Keys of all sizes, some longer than a SHA1 block, each used more than
+    // once with the state saved for it
+    for (int i = 0; i < 100; i++) {
+        std::string key(i + 1, 'a' + i % 26);
+        std::shared_ptr<HmacProviderInterface> keyed = hmac_provider.ForKey(key);
+        for (int pass = 0; pass < 2; pass++) {
+            unsigned char expected[EVP_MAX_MD_SIZE];
+            unsigned int expected_length;
+            HMAC(EVP_sha1(), key.data(), key.size(), reinterpret_cast<const unsigned char *>(prefixed.data()),
+                prefixed.size(), expected, &expected_length);
+            ASSERT_EQ(std::string(reinterpret_cast<char *>(expected), expected_length),
+                keyed->ComputeCommandHmac(command_bytes.data(), command_bytes.size(), key));
+        }
+    }
+}
+
+TEST(HmacProviderTest, ProvidersForAKeyComputeTheSameHmacs) {
+    HmacProvider hmac_provider;
+    std::shared_ptr<HmacProviderInterface> keyed = hmac_provider.ForKey("asdfasdf");
+    ASSERT_TRUE(keyed.get() != NULL);
+
+    Message message;
+    Command command;
+    command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+    message.set_commandbytes(command.SerializeAsString());
+    for (int i = 0; i < 2; i++) {
+        EXPECT_EQ(hmac_provider.ComputeHmac(message, "asdfasdf"), keyed->ComputeHmac(message, "asdfasdf"));
+    }
+    // Any other key is still honoured, just without the saved state
+    EXPECT_EQ(hmac_provider.ComputeHmac(message, "other"), keyed->ComputeHmac(message, "other"));
+    EXPECT_NE(keyed->ComputeHmac(message, "asdfasdf"), keyed->ComputeHmac(message, "other"));
+
+    message.mutable_hmacauth()->set_hmac(hmac_provider.ComputeHmac(message, "asdfasdf"));
+    EXPECT_TRUE(keyed->ValidateHmac(message, "asdfasdf"));
+    EXPECT_FALSE(keyed->ValidateHmac(message, "other"));
+}
 
 } // namespace kinetic
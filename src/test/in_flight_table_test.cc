@@ -0,0 +1,161 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "gmock/gmock.h"
+
+#include "in_flight_table.h"
+#include "nonblocking_packet_service.h"
+#include "mock_nonblocking_packet_service.h"
+
+namespace kinetic {
+
+using std::make_shared;
+
+TEST(InFlightTableTest, FindsHandlersBySequenceAndKey) {
+    InFlightTable table(4);
+    auto handler1 = make_shared<MockHandler>();
+    auto handler2 = make_shared<MockHandler>();
+    ASSERT_TRUE(table.Insert(10, 0, handler1));
+    ASSERT_TRUE(table.Insert(11, 1, handler2));
+    ASSERT_EQ(2u, table.size());
+
+    HandlerKey key;
+    ASSERT_EQ(handler2.get(), table.Find(11, &key));
+    ASSERT_EQ(1u, key);
+    ASSERT_TRUE(table.Remove(1));
+    ASSERT_EQ(NULL, table.Find(11, &key));
+    ASSERT_FALSE(table.Remove(1));
+
+    ASSERT_EQ(handler1, table.Take(10));
+    ASSERT_EQ(NULL, table.Take(10).get());
+    ASSERT_TRUE(table.empty());
+}
+
+TEST(InFlightTableTest, RejectsSequencesAndKeysInUse) {
+    InFlightTable table;
+    ASSERT_TRUE(table.Insert(33, 0, make_shared<MockHandler>()));
+    ASSERT_FALSE(table.Insert(33, 1, make_shared<MockHandler>()));
+    ASSERT_FALSE(table.Insert(34, 0, make_shared<MockHandler>()));
+    ASSERT_EQ(1u, table.size());
+    // Neither refused insert took a key or sequence
+    ASSERT_TRUE(table.Insert(34, 1, make_shared<MockHandler>()));
+}
+
+TEST(InFlightTableTest, StaleLookupsMissReusedSlots) {
+    InFlightTable table(4);
+    ASSERT_TRUE(table.Insert(1, 1, make_shared<MockHandler>()));
+    ASSERT_TRUE(table.Take(1) != NULL);
+    auto handler = make_shared<MockHandler>();
+    ASSERT_TRUE(table.Insert(5, 5, handler));
+    ASSERT_EQ(4u, table.capacity());
+
+    HandlerKey key;
+    ASSERT_EQ(NULL, table.Find(1, &key));
+    ASSERT_EQ(NULL, table.Take(1).get());
+    ASSERT_FALSE(table.Remove(1));
+    ASSERT_EQ(handler.get(), table.Find(5, &key));
+}
+
+TEST(InFlightTableTest, GrowsWhenSlotsCollide) {
+    InFlightTable table(4);
+    // The handshake sits at -1 alongside ordinary requests
+    ASSERT_TRUE(table.Insert(-1, -1, make_shared<MockHandler>()));
+    for (int64_t i = 0; i < 100; i++) {
+        ASSERT_TRUE(table.Insert(i, i, make_shared<MockHandler>()));
+    }
+    ASSERT_EQ(101u, table.size());
+    ASSERT_LE(128u, table.capacity());
+
+    HandlerKey key;
+    for (int64_t i = -1; i < 100; i++) {
+        ASSERT_TRUE(table.Find(i, &key) != NULL);
+        ASSERT_EQ(static_cast<HandlerKey>(i), key);
+    }
+}
+
+TEST(InFlightTableTest, StuckRequestDoesNotGrowTheTable) {
+    InFlightTable table(8);
+    auto stuck = make_shared<MockHandler>();
+    ASSERT_TRUE(table.Insert(0, 0, stuck));
+    // Requests after it come and go a few at a time, lapping its slot many
+    // times over
+    for (int64_t i = 1; i < 10000; i++) {
+        ASSERT_TRUE(table.Insert(i, i, make_shared<MockHandler>()));
+        if (i >= 3) {
+            ASSERT_TRUE(table.Take(i - 2) != NULL);
+        }
+    }
+    ASSERT_EQ(8u, table.capacity());
+    ASSERT_EQ(3u, table.size());
+    ASSERT_GE(1u, table.overflowed());
+
+    // Everything can still be found, and the stuck request can still finish
+    HandlerKey key;
+    ASSERT_EQ(stuck.get(), table.Find(0, &key));
+    ASSERT_TRUE(table.Find(9998, &key) != NULL);
+    ASSERT_EQ(9998u, key);
+    ASSERT_TRUE(table.Remove(9999));
+    ASSERT_FALSE(table.Insert(9998, 20000, make_shared<MockHandler>()));
+    ASSERT_EQ(stuck, table.Take(0));
+    ASSERT_TRUE(table.Take(9998) != NULL);
+    ASSERT_TRUE(table.empty());
+}
+
+TEST(InFlightTableTest, OverflowedRequestsAreFoundAndTakenInOrder) {
+    InFlightTable table(4);
+    auto handlers = vector<shared_ptr<HandlerInterface>>();
+    for (int i = 0; i < 3; i++) {
+        handlers.push_back(make_shared<MockHandler>());
+    }
+    ASSERT_TRUE(table.Insert(0, 0, handlers[0]));
+    // Lands on the slot 0 has, with too few requests in flight to grow for
+    ASSERT_TRUE(table.Insert(4, 4, handlers[1]));
+    ASSERT_EQ(1u, table.overflowed());
+    ASSERT_FALSE(table.Insert(4, 5, make_shared<MockHandler>()));
+    ASSERT_FALSE(table.Insert(5, 4, make_shared<MockHandler>()));
+    ASSERT_TRUE(table.Insert(5, 5, handlers[2]));
+
+    HandlerKey key;
+    ASSERT_EQ(handlers[1].get(), table.Find(4, &key));
+    ASSERT_EQ(4u, key);
+    vector<shared_ptr<HandlerInterface>> taken = table.TakeAll();
+    ASSERT_EQ(handlers, taken);
+    ASSERT_EQ(0u, table.overflowed());
+    ASSERT_TRUE(table.empty());
+}
+
+TEST(InFlightTableTest, TakeAllReturnsHandlersInSequenceOrder) {
+    InFlightTable table;
+    auto handler1 = make_shared<MockHandler>();
+    auto handler2 = make_shared<MockHandler>();
+    auto handler3 = make_shared<MockHandler>();
+    ASSERT_TRUE(table.Insert(7, 0, handler2));
+    ASSERT_TRUE(table.Insert(70, 1, handler3));
+    ASSERT_TRUE(table.Insert(-1, -1, handler1));
+
+    vector<shared_ptr<HandlerInterface>> handlers = table.TakeAll();
+    ASSERT_EQ(3u, handlers.size());
+    ASSERT_EQ(handler1, handlers[0]);
+    ASSERT_EQ(handler2, handlers[1]);
+    ASSERT_EQ(handler3, handlers[2]);
+    ASSERT_TRUE(table.empty());
+    ASSERT_TRUE(table.Insert(7, 0, handler2));
+}
+
+} // namespace kinetic
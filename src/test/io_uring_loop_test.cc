@@ -0,0 +1,138 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "mock_callbacks.h"
+#include "stand_in_drive.h"
+
+namespace kinetic {
+
+using ::testing::StrictMock;
+using ::testing::_;
+
+using std::make_shared;
+using std::string;
+using std::vector;
+
+// Opens a connection to drive through loop
+static shared_ptr<NonblockingKineticConnection> Connect(StandInDrive *drive, IoUringLoop *loop) {
+    drive->Expect();
+    shared_ptr<NonblockingKineticConnection> connection;
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    CHECK(factory.NewIoUringConnection(drive->options(), *loop, connection).ok());
+    return connection;
+}
+
+class IoUringLoopTest : public ::testing::Test {
+    protected:
+    void SetUp() {
+        if (!loop_.available()) {
+            LOG(INFO) << "io_uring isn't available here, skipping";
+        }
+    }
+
+    IoUringLoop loop_;
+};
+
+TEST_F(IoUringLoopTest, RunsRequestsOnSeveralConnections) {
+    if (!loop_.available()) {
+        return;
+    }
+    // Big enough values that neither direction fits in one receive buffer or
+    // one socket buffer
+    StandInDrive drive(1024 * 1024, true);
+    vector<shared_ptr<NonblockingKineticConnection>> connections;
+    for (int i = 0; i < 3; i++) {
+        connections.push_back(Connect(&drive, &loop_));
+    }
+    ASSERT_EQ(3u, loop_.size());
+
+    auto noop_callback = make_shared<StrictMock<MockSimpleCallback>>();
+    auto put_callback = make_shared<StrictMock<MockPutCallback>>();
+    auto get_callback = make_shared<StrictMock<MockGetCallback>>();
+    connections[0]->NoOp(noop_callback);
+    auto record = make_shared<KineticRecord>(string(4 * 1024 * 1024, 'p'), "version", "tag",
+        com::seagate::kinetic::client::proto::Command_Algorithm_SHA1);
+    connections[1]->Put("key", "", WriteMode::IGNORE_VERSION, record, put_callback);
+    connections[2]->Get("key", get_callback);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(loop_.Flush(connections[i]));
+    }
+
+    bool get_done = false, put_done = false, noop_done = false;
+    EXPECT_CALL(*noop_callback, Success()).WillOnce(::testing::Assign(&noop_done, true));
+    EXPECT_CALL(*put_callback, Success()).WillOnce(::testing::Assign(&put_done, true));
+    EXPECT_CALL(*get_callback, Success_("", ::testing::Truly([](KineticRecord *record) {
+        return *record->value() == string(1024 * 1024, 'v');
+    }))).WillOnce(::testing::Assign(&get_done, true));
+    for (int i = 0; i < 200 && !(get_done && put_done && noop_done); i++) {
+        ASSERT_GE(loop_.RunOnce(1000), 0);
+    }
+    ASSERT_TRUE(get_done && put_done && noop_done);
+    ASSERT_EQ(4u * 1024 * 1024, drive.largest_value());
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(loop_.Remove(connections[i]));
+    }
+    ASSERT_EQ(0u, loop_.size());
+}
+
+TEST_F(IoUringLoopTest, RemovesFailedConnections) {
+    if (!loop_.available()) {
+        return;
+    }
+    StandInDrive drive(0, false);
+    auto connection = Connect(&drive, &loop_);
+
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    ASSERT_TRUE(loop_.Flush(connection));
+
+    EXPECT_CALL(*callback, Failure(_));
+    for (int i = 0; i < 20 && loop_.size() > 0; i++) {
+        ASSERT_GE(loop_.RunOnce(1000), 0);
+    }
+    ASSERT_EQ(0u, loop_.size());
+    ASSERT_FALSE(loop_.Remove(connection));
+}
+
+TEST_F(IoUringLoopTest, RemoveCancelsOutstandingIo) {
+    if (!loop_.available()) {
+        return;
+    }
+    StandInDrive drive(0, true);
+    auto connection = Connect(&drive, &loop_);
+
+    // Leave a receive waiting in the kernel
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    ASSERT_TRUE(loop_.Flush(connection));
+    loop_.RunOnce(0);
+
+    ASSERT_TRUE(loop_.Remove(connection));
+    ASSERT_EQ(0u, loop_.size());
+    // The connection fails from then on, whether or not the response arrived
+    EXPECT_CALL(*callback, Failure(_));
+    IoInterest interest;
+    ASSERT_FALSE(connection->Run(&interest));
+}
+
+} // namespace kinetic
@@ -0,0 +1,306 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <string>
+#include <thread>
+
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+
+#include "kernel_tls.h"
+
+namespace kinetic {
+
+using std::string;
+using std::thread;
+
+// A TLS 1.2 connection over TCP loopback using the given cipher suite, with
+// a throwaway self-signed certificate. The server's side is run on a thread
+// of its own.
+class TlsPair {
+    public:
+    explicit TlsPair(const char *cipher) : client_fd_(-1), client_(NULL), server_(NULL) {
+        client_ctx_ = NewContext(SSLv23_client_method(), cipher);
+        server_ctx_ = NewContext(SSLv23_server_method(), cipher);
+        EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+        CHECK(key_ctx != NULL);
+        CHECK_EQ(1, EVP_PKEY_keygen_init(key_ctx));
+        EVP_PKEY *key = NULL;
+        CHECK_EQ(1, EVP_PKEY_keygen(key_ctx, &key));
+        EVP_PKEY_CTX_free(key_ctx);
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_get_notBefore(cert), 0);
+        X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_set_issuer_name(cert, X509_get_subject_name(cert));
+        CHECK_NE(0, X509_sign(cert, key, EVP_sha256()));
+        CHECK_EQ(1, SSL_CTX_use_certificate(server_ctx_, cert));
+        CHECK_EQ(1, SSL_CTX_use_PrivateKey(server_ctx_, key));
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK_NE(-1, listen_fd);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK_EQ(0, bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+        CHECK_EQ(0, listen(listen_fd, 1));
+        socklen_t addr_length = sizeof(addr);
+        CHECK_EQ(0, getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_length));
+        client_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK_EQ(0, connect(client_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+        int server_fd = accept(listen_fd, NULL, NULL);
+        CHECK_NE(-1, server_fd);
+        close(listen_fd);
+
+        client_ = SSL_new(client_ctx_);
+        SSL_set_fd(client_, client_fd_);
+        server_ = SSL_new(server_ctx_);
+        SSL_set_fd(server_, server_fd);
+    }
+
+    ~TlsPair() {
+        if (server_thread_.joinable()) {
+            server_thread_.join();
+        }
+        int server_fd = SSL_get_fd(server_);
+        SSL_free(server_);
+        close(server_fd);
+        SSL_free(client_);
+        close(client_fd_);
+        SSL_CTX_free(server_ctx_);
+        SSL_CTX_free(client_ctx_);
+    }
+
+    // Completes the handshake, then has the server receive expected and
+    // answer with reply
+    void Connect(const string &expected, const string &reply) {
+        server_thread_ = thread(&TlsPair::Serve, this, expected, reply);
+        CHECK_EQ(1, SSL_connect(client_));
+    }
+
+    void Finish() {
+        server_thread_.join();
+    }
+
+    int client_fd() {
+        return client_fd_;
+    }
+
+    SSL *client() {
+        return client_;
+    }
+
+    string received() {
+        return received_;
+    }
+
+    private:
+    static SSL_CTX *NewContext(const SSL_METHOD *method, const char *cipher) {
+        SSL_CTX *ctx = SSL_CTX_new(method);
+        CHECK(ctx != NULL);
+        // Some builds of OpenSSL 1.0 compress records, which the kernel can't
+        SSL_CTX_set_options(ctx, SSL_OP_NO_COMPRESSION);
+#ifdef SSL_OP_NO_TLSv1_3
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TLSv1_3);
+#endif
+        CHECK_EQ(1, SSL_CTX_set_cipher_list(ctx, cipher));
+        return ctx;
+    }
+
+    void Serve(string expected, string reply) {
+        CHECK_EQ(1, SSL_accept(server_));
+        received_.assign(expected.size(), '\0');
+        size_t length = 0;
+        while (length < expected.size()) {
+            int n = SSL_read(server_, &received_[length], expected.size() - length);
+            if (n <= 0) {
+                received_.resize(length);
+                return;
+            }
+            length += n;
+        }
+        if (!reply.empty()) {
+            CHECK_EQ(static_cast<int>(reply.size()), SSL_write(server_, reply.data(), reply.size()));
+        }
+    }
+
+    SSL_CTX *client_ctx_;
+    SSL_CTX *server_ctx_;
+    int client_fd_;
+    SSL *client_;
+    SSL *server_;
+    thread server_thread_;
+    string received_;
+};
+
+static const EVP_CIPHER *GcmCipher(const TlsRecordKeys &keys) {
+    return keys.key_size == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+}
+
+// The additional data a TLS 1.2 AES-GCM record is authenticated with
+static string AdditionalData(const unsigned char *sequence, size_t length) {
+    unsigned char header[] = {SSL3_RT_APPLICATION_DATA, 3, 3, static_cast<unsigned char>(length >> 8),
+        static_cast<unsigned char>(length)};
+    return string(reinterpret_cast<const char *>(sequence), 8) +
+        string(reinterpret_cast<char *>(header), sizeof(header));
+}
+
+// Encrypts plaintext into an application data record the way the kernel
+// would, using the sequence number as the nonce's explicit part
+static string SealRecord(const TlsRecordKeys &keys, const string &plaintext) {
+    unsigned char nonce[12];
+    memcpy(nonce, keys.write_salt, 4);
+    memcpy(nonce + 4, keys.write_sequence, 8);
+    string aad = AdditionalData(keys.write_sequence, plaintext.size());
+    string ciphertext(plaintext.size(), '\0');
+    unsigned char tag[16];
+    int length;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    CHECK_EQ(1, EVP_EncryptInit_ex(ctx, GcmCipher(keys), NULL, keys.write_key, nonce));
+    CHECK_EQ(1, EVP_EncryptUpdate(ctx, NULL, &length, reinterpret_cast<const unsigned char *>(aad.data()),
+        aad.size()));
+    CHECK_EQ(1, EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char *>(&ciphertext[0]), &length,
+        reinterpret_cast<const unsigned char *>(plaintext.data()), plaintext.size()));
+    CHECK_EQ(1, EVP_EncryptFinal_ex(ctx, NULL, &length));
+    CHECK_EQ(1, EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, sizeof(tag), tag));
+    EVP_CIPHER_CTX_free(ctx);
+
+    size_t body_length = 8 + ciphertext.size() + sizeof(tag);
+    unsigned char header[] = {SSL3_RT_APPLICATION_DATA, 3, 3, static_cast<unsigned char>(body_length >> 8),
+        static_cast<unsigned char>(body_length)};
+    return string(reinterpret_cast<char *>(header), sizeof(header)) +
+        string(reinterpret_cast<const char *>(keys.write_sequence), 8) + ciphertext +
+        string(reinterpret_cast<char *>(tag), sizeof(tag));
+}
+
+static bool ReadFully(int fd, char *buf, size_t length) {
+    while (length > 0) {
+        ssize_t n = read(fd, buf, length);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        length -= n;
+    }
+    return true;
+}
+
+// Reads the next record from fd and decrypts it, returning false if it isn't
+// an application data record that authenticates
+static bool OpenRecord(int fd, const TlsRecordKeys &keys, string *plaintext) {
+    unsigned char header[5];
+    if (!ReadFully(fd, reinterpret_cast<char *>(header), sizeof(header)) ||
+            header[0] != SSL3_RT_APPLICATION_DATA) {
+        return false;
+    }
+    string body((header[3] << 8) | header[4], '\0');
+    if (body.size() < 8 + 16 || !ReadFully(fd, &body[0], body.size())) {
+        return false;
+    }
+    unsigned char nonce[12];
+    memcpy(nonce, keys.read_salt, 4);
+    memcpy(nonce + 4, body.data(), 8);
+    plaintext->assign(body.size() - 8 - 16, '\0');
+    string aad = AdditionalData(keys.read_sequence, plaintext->size());
+    int length;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    CHECK_EQ(1, EVP_DecryptInit_ex(ctx, GcmCipher(keys), NULL, keys.read_key, nonce));
+    CHECK_EQ(1, EVP_DecryptUpdate(ctx, NULL, &length, reinterpret_cast<const unsigned char *>(aad.data()),
+        aad.size()));
+    CHECK_EQ(1, EVP_DecryptUpdate(ctx, reinterpret_cast<unsigned char *>(&(*plaintext)[0]), &length,
+        reinterpret_cast<const unsigned char *>(body.data()) + 8, plaintext->size()));
+    CHECK_EQ(1, EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, 16, &body[body.size() - 16]));
+    bool ok = EVP_DecryptFinal_ex(ctx, NULL, &length) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+// Checks the keys derived for a connection using cipher by exchanging a
+// record each way that OpenSSL never sees on the client's side
+static void ExpectKeysWork(const char *cipher, size_t key_size) {
+    TlsPair pair(cipher);
+    pair.Connect("to the server", "to the client");
+    TlsRecordKeys keys;
+    ASSERT_TRUE(GetTlsRecordKeys(pair.client(), &keys));
+    ASSERT_EQ(key_size, keys.key_size);
+    ASSERT_FALSE(keys.read_buffered);
+
+    string record = SealRecord(keys, "to the server");
+    ASSERT_EQ(static_cast<ssize_t>(record.size()), write(pair.client_fd(), record.data(), record.size()));
+    string reply;
+    ASSERT_TRUE(OpenRecord(pair.client_fd(), keys, &reply));
+    pair.Finish();
+    ASSERT_EQ("to the server", pair.received());
+    ASSERT_EQ("to the client", reply);
+}
+
+TEST(KernelTlsTest, DerivesAes128GcmKeys) {
+    ExpectKeysWork("AES128-GCM-SHA256", 16);
+}
+
+TEST(KernelTlsTest, DerivesAes256GcmKeys) {
+    ExpectKeysWork("AES256-GCM-SHA384", 32);
+}
+
+TEST(KernelTlsTest, LeavesOtherCiphersToOpenssl) {
+    TlsPair pair("AES128-SHA");
+    pair.Connect("", "");
+    TlsRecordKeys keys;
+    ASSERT_FALSE(GetTlsRecordKeys(pair.client(), &keys));
+}
+
+TEST(KernelTlsTest, KernelTakesOverRecordsWhereItCan) {
+    TlsPair pair("AES128-GCM-SHA256");
+    pair.Connect("to the server", "to the client");
+    TlsRecordKeys keys;
+    ASSERT_TRUE(GetTlsRecordKeys(pair.client(), &keys));
+    if (!StartKernelTlsSend(pair.client_fd(), keys)) {
+        // The server's still waiting for its request
+        shutdown(pair.client_fd(), SHUT_WR);
+        LOG(INFO) << "This kernel can't encrypt TLS records; skipping";
+        return;
+    }
+    ASSERT_EQ(13, write(pair.client_fd(), "to the server", 13));
+    bool receive = StartKernelTlsReceive(pair.client_fd(), keys);
+    string reply(13, '\0');
+    if (receive) {
+        ASSERT_TRUE(ReadFully(pair.client_fd(), &reply[0], reply.size()));
+    } else {
+        ASSERT_TRUE(OpenRecord(pair.client_fd(), keys, &reply));
+    }
+    pair.Finish();
+    ASSERT_EQ("to the server", pair.received());
+    ASSERT_EQ("to the client", reply);
+    SendKernelTlsCloseNotify(pair.client_fd());
+}
+
+} // namespace kinetic
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "stand_in_drive.h"
+
+namespace kinetic {
+
+using std::make_shared;
+using std::thread;
+using std::vector;
+
+namespace {
+
+// Counts completions and lets the test wait for them
+class CountingCallback : public SimpleCallbackInterface {
+    public:
+    CountingCallback() : successes_(0), failures_(0) {}
+
+    void Success() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        successes_++;
+        threads_.push_back(std::this_thread::get_id());
+        changed_.notify_all();
+    }
+
+    void Failure(KineticStatus error) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        failures_++;
+        changed_.notify_all();
+    }
+
+    bool WaitFor(int completions) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return changed_.wait_for(lock, std::chrono::seconds(10),
+            [this, completions]() { return successes_ + failures_ >= completions; });
+    }
+
+    int successes() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return successes_;
+    }
+
+    vector<std::thread::id> threads() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return threads_;
+    }
+
+    private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    int successes_;
+    int failures_;
+    vector<std::thread::id> threads_;
+};
+
+// Queues tasks until the test runs them
+class QueueingExecutor : public ExecutorInterface {
+    public:
+    void Execute(std::function<void()> task) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        tasks_.push_back(task);
+    }
+
+    // Runs whatever has been queued, and returns how many tasks that was
+    int RunQueued() {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            tasks.swap(tasks_);
+        }
+        for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+            (*it)();
+        }
+        return tasks.size();
+    }
+
+    private:
+    std::mutex mutex_;
+    std::deque<std::function<void()>> tasks_;
+};
+
+shared_ptr<NonblockingKineticConnectionInterface> Connect(StandInDrive *drive) {
+    drive->Expect();
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    shared_ptr<ThreadsafeNonblockingKineticConnection> connection;
+    CHECK(factory.NewThreadsafeNonblockingConnection(drive->options(), connection).ok());
+    return connection;
+}
+
+} // namespace
+
+TEST(KineticClientRuntimeTest, SendsRequestsSubmittedFromAnyThread) {
+    StandInDrive drive(0, true);
+    KineticClientRuntime runtime(2);
+    auto connection = Connect(&drive);
+    ASSERT_TRUE(runtime.Add(connection));
+
+    // Nothing but the runtime runs the connection, so these only go out
+    // because submitting wakes it up
+    auto callback = make_shared<CountingCallback>();
+    vector<thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.push_back(thread([connection, callback]() {
+            for (int j = 0; j < 25; j++) {
+                connection->NoOp(callback);
+            }
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    ASSERT_TRUE(callback->WaitFor(100));
+    ASSERT_EQ(100, callback->successes());
+    ASSERT_EQ(1u, runtime.size());
+}
+
+TEST(KineticClientRuntimeTest, NoSubmissionIsLostUnderContention) {
+    const int kConnections = 4;
+    const int kThreads = 16;
+    const int kRequestsPerThread = 200;
+    StandInDrive drive(0, true);
+    KineticClientRuntime runtime(1);
+    vector<shared_ptr<NonblockingKineticConnectionInterface>> connections;
+    for (int i = 0; i < kConnections; i++) {
+        connections.push_back(Connect(&drive));
+        ASSERT_TRUE(runtime.Add(connections[i]));
+    }
+
+    // Submitting in small bursts from many threads keeps the I/O thread
+    // clearing its wakeup while other pushes are half done
+    auto callback = make_shared<CountingCallback>();
+    vector<thread> threads;
+    for (int i = 0; i < kThreads; i++) {
+        threads.push_back(thread([i, &connections, callback]() {
+            for (int j = 0; j < kRequestsPerThread; j++) {
+                connections[(i + j) % connections.size()]->NoOp(callback);
+                if (j % 8 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    ASSERT_TRUE(callback->WaitFor(kThreads * kRequestsPerThread));
+    ASSERT_EQ(kThreads * kRequestsPerThread, callback->successes());
+}
+
+TEST(KineticClientRuntimeTest, CallbacksGoThroughTheExecutor) {
+    StandInDrive drive(0, true);
+    auto executor = make_shared<QueueingExecutor>();
+    KineticClientRuntime runtime(1, executor);
+    auto connection = Connect(&drive);
+    ASSERT_TRUE(runtime.Add(connection));
+
+    auto callback = make_shared<CountingCallback>();
+    connection->NoOp(callback);
+    connection->NoOp(callback);
+
+    int run = 0;
+    for (int i = 0; i < 1000 && run < 2; i++) {
+        run += executor->RunQueued();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(2, run);
+    ASSERT_EQ(2, callback->successes());
+    vector<std::thread::id> callback_threads = callback->threads();
+    for (auto it = callback_threads.begin(); it != callback_threads.end(); ++it) {
+        ASSERT_EQ(std::this_thread::get_id(), *it);
+    }
+}
+
+TEST(KineticClientRuntimeTest, RemovedConnectionsAreLetGo) {
+    StandInDrive drive(0, true);
+    KineticClientRuntime runtime(2);
+    auto first = Connect(&drive);
+    auto second = Connect(&drive);
+    ASSERT_TRUE(runtime.Add(first));
+    ASSERT_TRUE(runtime.Add(second));
+    ASSERT_EQ(2u, runtime.size());
+
+    ASSERT_TRUE(runtime.Remove(first));
+    ASSERT_FALSE(runtime.Remove(first));
+    ASSERT_EQ(1u, runtime.size());
+
+    // The one still added carries on as before
+    auto callback = make_shared<CountingCallback>();
+    second->NoOp(callback);
+    ASSERT_TRUE(callback->WaitFor(1));
+    ASSERT_EQ(1, callback->successes());
+}
+
+} // namespace kinetic
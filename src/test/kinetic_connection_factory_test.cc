@@ -0,0 +1,339 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "mock_callbacks.h"
+#include "stand_in_drive.h"
+
+namespace kinetic {
+
+using ::testing::_;
+using ::testing::StrictMock;
+
+using std::make_shared;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+class MockConnectCallback : public ConnectCallbackInterface {
+    public:
+    MOCK_METHOD2(Success, void(size_t index, shared_ptr<NonblockingKineticConnection> connection));
+    MOCK_METHOD2(Failure, void(size_t index, Status status));
+};
+
+// Opens a loopback port that completes TCP connects but never says anything
+static int ListenSilently(int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_NE(-1, fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK_EQ(0, bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    CHECK_EQ(0, listen(fd, 16));
+    socklen_t addr_len = sizeof(addr);
+    CHECK_EQ(0, getsockname(fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len));
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+TEST(KineticConnectionFactoryTest, NewNonblockingConnectionCompletesHandshake) {
+    StandInDrive drive(0, true);
+    drive.Expect();
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    shared_ptr<NonblockingKineticConnection> connection;
+    ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    bool done = false;
+    EXPECT_CALL(*callback, Success()).WillOnce(::testing::Assign(&done, true));
+    for (int i = 0; i < 1000 && !done; i++) {
+        fd_set read_fds, write_fds;
+        int nfds;
+        ASSERT_TRUE(connection->Run(&read_fds, &write_fds, &nfds));
+        struct timeval tv = {0, 10000};
+        select(nfds, &read_fds, &write_fds, NULL, &tv);
+    }
+    ASSERT_TRUE(done);
+}
+
+// Counts the HMACs it computes for requests and checks for responses. It has
+// no per-key providers, so connections have to use it directly.
+class CountingHmacProvider : public HmacProviderInterface {
+    public:
+    CountingHmacProvider() : computed(0), validated(0), hmac_provider_() {}
+    std::string ComputeHmac(const Message& message, const std::string& key) const {
+        return ComputeCommandHmac(message.commandbytes().data(), message.commandbytes().size(), key);
+    }
+    std::string ComputeCommandHmac(const char *command_bytes, size_t length, const std::string& key) const {
+        computed++;
+        return hmac_provider_.ComputeCommandHmac(command_bytes, length, key);
+    }
+    bool ValidateHmac(const Message& message, const std::string& key) const {
+        validated++;
+        computed++;
+        return hmac_provider_.ValidateHmac(message, key);
+    }
+    mutable std::atomic<int> computed;
+    mutable std::atomic<int> validated;
+
+    private:
+    HmacProvider hmac_provider_;
+};
+
+TEST(KineticConnectionFactoryTest, ConnectionsUseTheFactorysHmacProvider) {
+    StandInDrive drive(0, true);
+    drive.Expect();
+    auto hmac_provider = make_shared<CountingHmacProvider>();
+    KineticConnectionFactory factory = NewKineticConnectionFactory(hmac_provider);
+    shared_ptr<NonblockingKineticConnection> connection;
+    ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    bool done = false;
+    EXPECT_CALL(*callback, Success()).WillOnce(::testing::Assign(&done, true));
+    for (int i = 0; i < 1000 && !done; i++) {
+        fd_set read_fds, write_fds;
+        int nfds;
+        ASSERT_TRUE(connection->Run(&read_fds, &write_fds, &nfds));
+        struct timeval tv = {0, 10000};
+        select(nfds, &read_fds, &write_fds, NULL, &tv);
+    }
+    ASSERT_TRUE(done);
+    // One HMAC for the request and one to check the response's against
+    ASSERT_EQ(2, hmac_provider->computed.load());
+    ASSERT_EQ(1, hmac_provider->validated.load());
+}
+
+TEST(KineticConnectionFactoryTest, ConnectsOverUnixDomainSockets) {
+    char dir[] = "/tmp/kinetic_unix_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    string path = string(dir) + "/drive.sock";
+    {
+        StandInDrive drive(100 * 1024, true, path);
+        drive.Expect();
+        drive.Expect();
+        KineticConnectionFactory factory = NewKineticConnectionFactory();
+
+        unique_ptr<BlockingKineticConnection> blocking;
+        ASSERT_TRUE(factory.NewBlockingConnection(drive.options(), blocking, 10).ok());
+        unique_ptr<KineticRecord> record;
+        ASSERT_TRUE(blocking->Get("key", record).ok());
+        ASSERT_EQ(string(100 * 1024, 'v'), *record->value());
+
+        shared_ptr<NonblockingKineticConnection> connection;
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+        auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+        connection->NoOp(callback);
+        bool done = false;
+        EXPECT_CALL(*callback, Success()).WillOnce(::testing::Assign(&done, true));
+        for (int i = 0; i < 1000 && !done; i++) {
+            fd_set read_fds, write_fds;
+            int nfds;
+            ASSERT_TRUE(connection->Run(&read_fds, &write_fds, &nfds));
+            struct timeval tv = {0, 10000};
+            select(nfds, &read_fds, &write_fds, NULL, &tv);
+        }
+        ASSERT_TRUE(done);
+    }
+    rmdir(dir);
+
+    // Nothing listens there any more
+    ConnectionOptions options;
+    options.host = "unix:" + path;
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    shared_ptr<NonblockingKineticConnection> connection;
+    ASSERT_FALSE(factory.NewNonblockingConnection(options, connection).ok());
+}
+
+TEST(KineticConnectionFactoryTest, ThreadsafeBlockingConnectionTakesCallsFromManyThreads) {
+    StandInDrive drive(1000, true);
+    drive.Expect();
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    unique_ptr<ThreadsafeBlockingKineticConnection> connection;
+    ASSERT_TRUE(factory.NewThreadsafeBlockingConnection(drive.options(), connection, 10).ok());
+
+    std::atomic<int> succeeded(0);
+    vector<thread> threads;
+    for (int i = 0; i < 16; i++) {
+        threads.push_back(thread([&connection, &succeeded, i]() {
+            for (int j = 0; j < 50; j++) {
+                unique_ptr<KineticRecord> record;
+                string key = "key" + std::to_string(i);
+                if (connection->Get(key, record).ok() && *record->value() == string(1000, 'v')) {
+                    succeeded++;
+                }
+            }
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+    ASSERT_EQ(16 * 50, succeeded);
+}
+
+TEST(KineticConnectionFactoryTest, BlockingCallsTimeOutDespiteNewCalls) {
+    StandInDrive drive(0, true);
+    drive.Expect();
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    unique_ptr<ThreadsafeBlockingKineticConnection> connection;
+    ASSERT_TRUE(factory.NewThreadsafeBlockingConnection(drive.options(), connection, 1).ok());
+    drive.Silence();
+
+    // Every new call wakes whichever thread is waiting on the socket, which
+    // mustn't stop the first call from timing out
+    auto started = std::chrono::steady_clock::now();
+    std::atomic<bool> first_done(false);
+    KineticStatus first_status(StatusCode::OK, "");
+    std::chrono::steady_clock::duration first_took;
+    thread first([&]() {
+        first_status = connection->NoOp();
+        first_took = std::chrono::steady_clock::now() - started;
+        first_done = true;
+    });
+    vector<thread> later;
+    while (std::chrono::steady_clock::now() - started < std::chrono::seconds(3) && !first_done) {
+        later.push_back(thread([&connection]() { connection->NoOp(); }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    first.join();
+    for (auto it = later.begin(); it != later.end(); ++it) {
+        it->join();
+    }
+
+    ASSERT_EQ(StatusCode::CLIENT_IO_ERROR, first_status.statusCode());
+    ASSERT_LT(first_took, std::chrono::milliseconds(2500));
+}
+
+TEST(KineticConnectionFactoryTest, NewNonblockingConnectionsOpensConnectionsConcurrently) {
+    StandInDrive drive(0, true);
+    vector<ConnectionOptions> options;
+    for (int i = 0; i < 8; i++) {
+        drive.Expect();
+        options.push_back(drive.options());
+    }
+    // Nothing listens on this one
+    int port;
+    int fd = ListenSilently(&port);
+    close(fd);
+    ConnectionOptions refused = drive.options();
+    refused.port = port;
+    options.push_back(refused);
+
+    StrictMock<MockConnectCallback> callback;
+    for (size_t i = 0; i < 8; i++) {
+        EXPECT_CALL(callback, Success(i, ::testing::NotNull()));
+    }
+    EXPECT_CALL(callback, Failure(8, _));
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    factory.NewNonblockingConnections(options, 10, callback);
+}
+
+TEST(KineticConnectionFactoryTest, PendingConnectionsCanBeDrivenFromAnEventLoop) {
+    StandInDrive drive(0, true);
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    vector<unique_ptr<PendingKineticConnection>> pending(2);
+    vector<IoInterest> interests(2);
+    for (size_t i = 0; i < pending.size(); i++) {
+        drive.Expect();
+        ASSERT_TRUE(factory.StartNonblockingConnection(drive.options(), pending[i]).ok());
+        ASSERT_TRUE(pending[i]->Continue(&interests[i]));
+        ASSERT_FALSE(pending[i]->status().ok());
+        ASSERT_TRUE(pending[i]->connection() == NULL);
+    }
+
+    // Stands in for the application's own event loop
+    KineticReactor reactor;
+    vector<shared_ptr<NonblockingKineticConnection>> connections;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (connections.size() < pending.size()) {
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        vector<struct pollfd> pollfds;
+        for (size_t i = 0; i < pending.size(); i++) {
+            struct pollfd pfd;
+            pfd.fd = pending[i] ? interests[i].fd : -1;
+            pfd.events = (interests[i].read ? POLLIN : 0) | (interests[i].write ? POLLOUT : 0);
+            pfd.revents = 0;
+            pollfds.push_back(pfd);
+        }
+        ASSERT_LE(0, poll(&pollfds[0], pollfds.size(), 1000));
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (pollfds[i].revents == 0 || pending[i]->Continue(&interests[i])) {
+                continue;
+            }
+            ASSERT_TRUE(pending[i]->status().ok());
+            connections.push_back(pending[i]->connection());
+            ASSERT_TRUE(connections.back() != NULL);
+            ASSERT_TRUE(pending[i]->connection() == NULL);
+            pending[i].reset();
+            ASSERT_TRUE(reactor.Add(connections.back()));
+        }
+    }
+
+    // The connections work like any others
+    int answered = 0;
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    EXPECT_CALL(*callback, Success()).Times(2).WillRepeatedly(::testing::Invoke([&answered]() {
+        answered++;
+    }));
+    for (auto it = connections.begin(); it != connections.end(); ++it) {
+        (*it)->NoOp(callback);
+        ASSERT_TRUE(reactor.Flush(*it));
+    }
+    for (int i = 0; i < 100 && answered < 2; i++) {
+        reactor.RunOnce(100);
+    }
+    ASSERT_EQ(2, answered);
+}
+
+TEST(KineticConnectionFactoryTest, NewNonblockingConnectionsTimesOutWaitingForHandshake) {
+    int port;
+    int fd = ListenSilently(&port);
+    vector<ConnectionOptions> options(2);
+    for (auto it = options.begin(); it != options.end(); ++it) {
+        it->host = "127.0.0.1";
+        it->port = port;
+    }
+
+    StrictMock<MockConnectCallback> callback;
+    EXPECT_CALL(callback, Failure(0, _));
+    EXPECT_CALL(callback, Failure(1, _));
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    auto start = std::chrono::steady_clock::now();
+    factory.NewNonblockingConnections(options, 1, callback);
+    // Both waited out the same second rather than one after the other
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    close(fd);
+}
+
+} // namespace kinetic
@@ -0,0 +1,139 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "kinetic/kinetic_coroutines.h"
+
+// The test binary is built as C++11, so this file is only compiled as C++20
+// when the compiler supports it; otherwise there's nothing to test
+#ifdef KINETIC_HAVE_COROUTINES
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "stand_in_drive.h"
+
+namespace kinetic {
+
+using coro::Operation;
+using coro::Scheduler;
+using coro::Task;
+using std::make_shared;
+using std::string;
+using std::vector;
+
+class KineticCoroutinesTest : public ::testing::Test {
+    protected:
+    KineticCoroutinesTest() : drive_(100, true), scheduler_(&reactor_) {}
+
+    void SetUp() {
+        drive_.Expect();
+        KineticConnectionFactory factory = NewKineticConnectionFactory();
+        shared_ptr<NonblockingKineticConnection> connection;
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive_.options(), connection).ok());
+        connection_ = connection;
+        ASSERT_TRUE(reactor_.Add(connection_));
+    }
+
+    // Runs the scheduler until *done is set, for at most ten seconds
+    bool RunUntil(const bool *done) {
+        for (int i = 0; i < 100 && !*done; i++) {
+            if (scheduler_.RunOnce(100) < 0) {
+                return false;
+            }
+        }
+        return *done;
+    }
+
+    StandInDrive drive_;
+    KineticReactor reactor_;
+    Scheduler scheduler_;
+    shared_ptr<NonblockingKineticConnectionInterface> connection_;
+};
+
+TEST_F(KineticCoroutinesTest, AwaitsOperationsOneAfterAnother) {
+    bool done = false;
+    KineticStatus noop_status(StatusCode::CLIENT_INTERNAL_ERROR, "");
+    string value;
+    auto body = [&]() -> Task {
+        // Each request after the first is submitted from inside Run, when
+        // the previous one completes
+        noop_status = co_await scheduler_.NoOp(connection_);
+        auto record = make_shared<KineticRecord>("value", "version", "tag",
+            com::seagate::kinetic::client::proto::Command_Algorithm_SHA1);
+        KineticStatus put_status = co_await scheduler_.Put(connection_, "key", "",
+            WriteMode::IGNORE_VERSION, record);
+        EXPECT_TRUE(put_status.ok());
+        GetResult get = co_await scheduler_.Get(connection_, "key");
+        EXPECT_TRUE(get.status.ok());
+        value = *get.record->value();
+        done = true;
+    };
+    body();
+
+    ASSERT_TRUE(RunUntil(&done));
+    ASSERT_TRUE(noop_status.ok());
+    ASSERT_EQ(string(100, 'v'), value);
+}
+
+TEST_F(KineticCoroutinesTest, FannedOutOperationsAreAllInFlight) {
+    bool done = false;
+    size_t ok = 0;
+    auto body = [&]() -> Task {
+        vector<Operation<GetResult>> gets;
+        for (int i = 0; i < 64; i++) {
+            gets.push_back(scheduler_.Get(connection_, "key" + std::to_string(i)));
+        }
+        for (auto it = gets.begin(); it != gets.end(); ++it) {
+            GetResult result = co_await *it;
+            if (result.status.ok()) {
+                ok++;
+            }
+        }
+        done = true;
+    };
+    body();
+
+    ASSERT_TRUE(RunUntil(&done));
+    ASSERT_EQ(64u, ok);
+}
+
+TEST_F(KineticCoroutinesTest, OperationsFailWithTheConnection) {
+    bool done = false;
+    KineticStatus status(StatusCode::OK, "");
+    auto body = [&]() -> Task {
+        status = co_await coro::NoOp(*connection_);
+        done = true;
+    };
+    body();
+
+    ASSERT_FALSE(done);
+    // Dropping the last reference to the connection fails what it still has,
+    // which resumes the coroutine
+    ASSERT_TRUE(reactor_.Remove(connection_));
+    connection_.reset();
+    ASSERT_TRUE(done);
+    ASSERT_FALSE(status.ok());
+}
+
+} // namespace kinetic
+
+#endif  // KINETIC_HAVE_COROUTINES
@@ -0,0 +1,289 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "kinetic/kinetic_reactor.h"
+#include "nonblocking_packet_service.h"
+#include "mock_socket_wrapper_interface.h"
+#include "mock_callbacks.h"
+
+namespace kinetic {
+
+using ::testing::Invoke;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::StrictMock;
+using ::testing::_;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_SUCCESS;
+using com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH;
+using com::seagate::kinetic::client::proto::Message_AuthType_UNSOLICITEDSTATUS;
+
+using std::make_shared;
+using std::string;
+using std::vector;
+
+// The drive end of a connection, answering requests over a socketpair
+class FakeDrive {
+    public:
+    FakeDrive() {
+        int fds[2];
+        CHECK_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        client_fd_ = fds[0];
+        drive_fd_ = fds[1];
+        CHECK_EQ(0, fcntl(client_fd_, F_SETFL, O_NONBLOCK));
+
+        Message handshake;
+        Command command;
+        handshake.set_authtype(Message_AuthType_UNSOLICITEDSTATUS);
+        command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+        WritePacket(&handshake, command);
+    }
+
+    ~FakeDrive() {
+        close(client_fd_);
+        if (drive_fd_ != -1) {
+            close(drive_fd_);
+        }
+    }
+
+    // Reads one request and answers it with success
+    void Respond() {
+        char header[9];
+        ReadFully(header, sizeof(header));
+        uint32_t message_length, value_length;
+        memcpy(&message_length, header + 1, 4);
+        memcpy(&value_length, header + 5, 4);
+        string request(ntohl(message_length) + ntohl(value_length), '\0');
+        ReadFully(&request[0], request.size());
+
+        Message message;
+        CHECK(message.ParseFromArray(request.data(), ntohl(message_length)));
+        Command command;
+        CHECK(command.ParseFromString(message.commandbytes()));
+
+        Message response;
+        Command response_command;
+        response_command.mutable_header()->set_acksequence(command.header().sequence());
+        response_command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+        WritePacket(&response, response_command);
+    }
+
+    // Whether a request arrives within timeout_ms milliseconds
+    bool WaitForRequest(int timeout_ms) {
+        struct pollfd pfd;
+        pfd.fd = drive_fd_;
+        pfd.events = POLLIN;
+        return poll(&pfd, 1, timeout_ms) == 1;
+    }
+
+    void Hangup() {
+        close(drive_fd_);
+        drive_fd_ = -1;
+    }
+
+    int client_fd() {
+        return client_fd_;
+    }
+
+    private:
+    void WritePacket(Message *message, const Command &command) {
+        message->set_commandbytes(command.SerializeAsString());
+        if (!message->has_authtype()) {
+            message->set_authtype(Message_AuthType_HMACAUTH);
+            message->mutable_hmacauth()->set_identity(3);
+            message->mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(*message, "key"));
+        }
+        string serialized = message->SerializeAsString();
+        uint32_t message_length = htonl(serialized.size());
+        uint32_t value_length = 0;
+        string packet = "F" + string(reinterpret_cast<char *>(&message_length), 4) +
+            string(reinterpret_cast<char *>(&value_length), 4) + serialized;
+        CHECK_EQ(static_cast<ssize_t>(packet.size()), write(drive_fd_, packet.data(), packet.size()));
+    }
+
+    void ReadFully(char *buf, size_t length) {
+        while (length > 0) {
+            ssize_t n = read(drive_fd_, buf, length);
+            CHECK_GT(n, 0);
+            buf += n;
+            length -= n;
+        }
+    }
+
+    int client_fd_;
+    int drive_fd_;
+    HmacProvider hmac_provider_;
+};
+
+class KineticReactorTest : public ::testing::Test {
+    protected:
+    KineticReactorTest() : hmac_provider_(make_shared<HmacProvider>()) {}
+
+    shared_ptr<NonblockingKineticConnection> Connect(FakeDrive *drive) {
+        auto socket_wrapper = make_shared<NiceMock<MockSocketWrapperInterface>>();
+        ON_CALL(*socket_wrapper, fd()).WillByDefault(Return(drive->client_fd()));
+        ON_CALL(*socket_wrapper, getSSL()).WillByDefault(Return((SSL*) 0));
+        ON_CALL(*socket_wrapper, is_socket()).WillByDefault(Return(true));
+        ConnectionOptions options;
+        options.user_id = 3;
+        options.hmac_key = "key";
+        auto receiver = make_shared<NonblockingReceiver>(socket_wrapper, hmac_provider_, options);
+        unique_ptr<NonblockingSenderInterface> sender(new NonblockingSender(socket_wrapper, receiver,
+            make_shared<NonblockingPacketWriterFactory>(), hmac_provider_, options));
+        return make_shared<NonblockingKineticConnection>(
+            new NonblockingPacketService(socket_wrapper, move(sender), receiver));
+    }
+
+    shared_ptr<HmacProvider> hmac_provider_;
+};
+
+TEST_F(KineticReactorTest, RunsConnectionsWhoseSocketsAreReady) {
+    KineticReactor reactor;
+    FakeDrive drives[3];
+    vector<shared_ptr<NonblockingKineticConnection>> connections;
+    vector<shared_ptr<StrictMock<MockSimpleCallback>>> callbacks;
+    for (int i = 0; i < 3; i++) {
+        connections.push_back(Connect(&drives[i]));
+        ASSERT_TRUE(reactor.Add(connections[i]));
+        callbacks.push_back(make_shared<StrictMock<MockSimpleCallback>>());
+    }
+    ASSERT_EQ(3u, reactor.size());
+
+    // Once the sockets' initial readiness has been taken, nothing happens
+    // until something arrives
+    reactor.RunOnce(0);
+    ASSERT_EQ(0, reactor.RunOnce(0));
+
+    for (int i = 0; i < 3; i++) {
+        connections[i]->NoOp(callbacks[i]);
+        ASSERT_TRUE(reactor.Flush(connections[i]));
+    }
+
+    // Only the connection whose drive answered has anything to do
+    drives[1].Respond();
+    EXPECT_CALL(*callbacks[1], Success());
+    ASSERT_EQ(1, reactor.RunOnce(1000));
+    testing::Mock::VerifyAndClearExpectations(callbacks[1].get());
+
+    drives[0].Respond();
+    drives[2].Respond();
+    EXPECT_CALL(*callbacks[0], Success());
+    EXPECT_CALL(*callbacks[2], Success());
+    int run = 0;
+    for (int i = 0; i < 10 && run < 2; i++) {
+        run += reactor.RunOnce(1000);
+    }
+    ASSERT_EQ(2, run);
+}
+
+TEST_F(KineticReactorTest, RemovesFailedConnections) {
+    KineticReactor reactor;
+    FakeDrive drive;
+    auto connection = Connect(&drive);
+    ASSERT_TRUE(reactor.Add(connection));
+
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    ASSERT_TRUE(reactor.Flush(connection));
+
+    EXPECT_CALL(*callback, Failure(_));
+    drive.Hangup();
+    ASSERT_EQ(1, reactor.RunOnce(1000));
+    ASSERT_EQ(0u, reactor.size());
+    ASSERT_FALSE(reactor.Remove(connection));
+}
+
+TEST_F(KineticReactorTest, TracksConnectionsByIdentity) {
+    KineticReactor reactor;
+    FakeDrive drive;
+    auto connection = Connect(&drive);
+    ASSERT_FALSE(reactor.Flush(connection));
+    ASSERT_TRUE(reactor.Add(connection));
+    ASSERT_FALSE(reactor.Add(connection));
+    ASSERT_EQ(1u, reactor.size());
+    ASSERT_TRUE(reactor.Flush(connection));
+    ASSERT_TRUE(reactor.Remove(connection));
+    ASSERT_FALSE(reactor.Flush(connection));
+    ASSERT_FALSE(reactor.Remove(connection));
+    // It can come back once removed
+    ASSERT_TRUE(reactor.Add(connection));
+    ASSERT_TRUE(reactor.Flush(connection));
+}
+
+TEST_F(KineticReactorTest, SendsRequestsSubmittedByCallbacks) {
+    KineticReactor reactor;
+    FakeDrive drive;
+    auto connection = Connect(&drive);
+    ASSERT_TRUE(reactor.Add(connection));
+    // Take the initial readiness events
+    reactor.RunOnce(0);
+
+    auto first = make_shared<StrictMock<MockSimpleCallback>>();
+    auto second = make_shared<StrictMock<MockSimpleCallback>>();
+    EXPECT_CALL(*first, Success()).WillOnce(Invoke([&connection, &second]() {
+        connection->NoOp(second);
+    }));
+    connection->NoOp(first);
+    ASSERT_TRUE(reactor.Flush(connection));
+
+    drive.Respond();
+    ASSERT_EQ(1, reactor.RunOnce(1000));
+
+    // The follow-up goes out without another Flush
+    ASSERT_TRUE(drive.WaitForRequest(1000));
+    drive.Respond();
+    EXPECT_CALL(*second, Success());
+    ASSERT_EQ(1, reactor.RunOnce(1000));
+}
+
+#ifdef __linux__
+TEST_F(KineticReactorTest, FdIsReadableWhenThereIsWork) {
+    KineticReactor reactor;
+    FakeDrive drive;
+    auto connection = Connect(&drive);
+    ASSERT_TRUE(reactor.Add(connection));
+    auto callback = make_shared<StrictMock<MockSimpleCallback>>();
+    connection->NoOp(callback);
+    ASSERT_TRUE(reactor.Flush(connection));
+    // Take the initial readiness events
+    reactor.RunOnce(0);
+
+    struct pollfd pfd;
+    pfd.fd = reactor.fd();
+    pfd.events = POLLIN;
+    ASSERT_EQ(0, poll(&pfd, 1, 0));
+
+    drive.Respond();
+    ASSERT_EQ(1, poll(&pfd, 1, 1000));
+    EXPECT_CALL(*callback, Success());
+    ASSERT_EQ(1, reactor.RunOnce(0));
+
+    ASSERT_TRUE(reactor.Remove(connection));
+    ASSERT_EQ(0u, reactor.size());
+}
+#endif
+
+} // namespace kinetic
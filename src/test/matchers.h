@@ -22,6 +22,8 @@
 
 #include "gmock/gmock.h"
 
+#include "kinetic/packet_value.h"
+
 namespace kinetic {
 
 using std::shared_ptr;
@@ -55,6 +57,43 @@ inline Matcher<shared_ptr<const string>> StringSharedPtrEq(const string s) {
     return MakeMatcher(new StringSharedPtrMatcher(s));
 };
 
+class PacketValueMatcher : public MatcherInterface<const PacketValue&> {
+    public:
+    PacketValueMatcher(const std::string s) : s_(s) {}
+
+    virtual bool MatchAndExplain(const PacketValue& other,
+        testing::MatchResultListener *listener) const {
+        if (other.is_file()) {
+            *listener << "expected = <" << s_ << ">, actual = file value";
+            return false;
+        }
+        std::string actual;
+        if (other.is_slices()) {
+            for (auto it = other.slices().begin(); it != other.slices().end(); ++it) {
+                actual.append(it->data, it->length);
+            }
+        } else {
+            actual = *other.string_value();
+        }
+        if (s_ == actual) {
+            return true;
+        }
+        *listener << "expected = <" << s_ << ">, actual = <" << actual << ">";
+        return false;
+    }
+
+    virtual void DescribeTo(::std::ostream *os) const {
+        *os << "s=" << s_;
+    }
+
+    private:
+    const std::string s_;
+};
+
+inline Matcher<const PacketValue&> PacketValueEq(const string s) {
+    return MakeMatcher(new PacketValueMatcher(s));
+};
+
 class VectorStringPtrMatcher : public MatcherInterface<vector<string>*> {
     public:
     VectorStringPtrMatcher(vector<string> v) : v_(v) {}
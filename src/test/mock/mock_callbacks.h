@@ -51,6 +51,13 @@ class MockGetCallback : public GetCallbackInterface {
     MOCK_METHOD1(Failure, void(KineticStatus error));
 };
 
+class MockGetIntoCallback : public GetIntoCallbackInterface {
+    public:
+    MOCK_METHOD5(Success, void(const string &key, size_t value_size, const string &version,
+        const string &tag, Command_Algorithm algorithm));
+    MOCK_METHOD1(Failure, void(KineticStatus error));
+};
+
 class MockGetVersionCallback : public GetVersionCallbackInterface {
     public:
     MOCK_METHOD1(Success, void(const string &version));
@@ -47,18 +47,20 @@ class MockNonblockingReceiver : public NonblockingReceiverInterface {
     MOCK_METHOD0(Receive, NonblockingPacketServiceStatus());
     MOCK_METHOD0(connection_id, int64_t());
     MOCK_METHOD1(Remove, bool(HandlerKey key));
+    MOCK_METHOD1(FailAll, void(KineticStatus status));
 };
 
 class MockNonblockingSender : public NonblockingSenderInterface {
     public:
-    void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    void Enqueue(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
         unique_ptr<HandlerInterface> handler, HandlerKey handler_key) {
         Enqueue_(*message, *command, value, handler.get(), handler_key);
     }
-    MOCK_METHOD5(Enqueue_, void(const Message& message, const Command& command, const shared_ptr<const string> value,
+    MOCK_METHOD5(Enqueue_, void(const Message& message, const Command& command, const PacketValue& value,
         HandlerInterface *handler, HandlerKey handler_key));
     MOCK_METHOD0(Send, NonblockingPacketServiceStatus());
     MOCK_METHOD1(Remove, bool(HandlerKey key));
+    MOCK_METHOD1(FailAll, void(KineticStatus status));
 };
 
 class MockNonblockingPacketWriter : public NonblockingPacketWriterInterface {
@@ -69,24 +71,29 @@ class MockNonblockingPacketWriter : public NonblockingPacketWriterInterface {
 class MockNonblockingPacketWriterFactory : public NonblockingPacketWriterFactoryInterface {
     public:
     unique_ptr<NonblockingPacketWriterInterface> CreateWriter(shared_ptr<SocketWrapperInterface> socket_wrapper,
-        unique_ptr<const Message> message, const shared_ptr<const string> value) {
+        unique_ptr<string> packet, const PacketValue& value) {
+        // Expectations are easier to write against the message than the
+        // bytes, so skip the 9-byte header and parse the rest
+        Message message;
+        message.ParseFromArray(packet->data() + 9, packet->size() - 9);
         return unique_ptr<NonblockingPacketWriterInterface>(
-            CreateWriter_(socket_wrapper, *message, value));
+            CreateWriter_(socket_wrapper, message, value));
     }
 
     MOCK_METHOD3(CreateWriter_,  NonblockingPacketWriterInterface* (shared_ptr<SocketWrapperInterface> socket_wrapper,
-        const Message& message, const shared_ptr<const string> value));
+        const Message& message, const PacketValue& value));
 };
 
 class MockNonblockingPacketService : public NonblockingPacketServiceInterface {
     public:
-    HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const shared_ptr<const string> value,
+    HandlerKey Submit(unique_ptr<Message> message, unique_ptr<Command> command, const PacketValue& value,
             unique_ptr<HandlerInterface> handler) {
         return Submit_(*message, *command, value, handler.get());
     }
-    MOCK_METHOD4(Submit_, HandlerKey(const Message &message, const Command &command, const shared_ptr<const string> value,
+    MOCK_METHOD4(Submit_, HandlerKey(const Message &message, const Command &command, const PacketValue& value,
     HandlerInterface* handler));
     MOCK_METHOD3(Run, bool(fd_set *read_fds, fd_set *write_fds, int *nfds));
+    MOCK_METHOD1(Run, bool(IoInterest *interest));
     MOCK_METHOD1(Remove, bool(HandlerKey handler_key));
 };
 
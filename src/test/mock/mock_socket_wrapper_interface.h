@@ -30,6 +30,9 @@ class MockSocketWrapperInterface : public SocketWrapperInterface {
     MOCK_METHOD0(Connect, bool());
     MOCK_METHOD0(fd, int());
     MOCK_METHOD0(getSSL, SSL*());
+    MOCK_METHOD0(is_socket, bool());
+    MOCK_METHOD0(ktls_send, bool());
+    MOCK_METHOD0(ktls_receive, bool());
 };
 
 }  // namespace kinetic
@@ -93,7 +93,7 @@ class NonblockingKineticConnectionTest : public ::testing::Test {
 
 TEST_F(NonblockingKineticConnectionTest, NoOpWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _))
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _))
             .WillOnce(DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<SimpleCallbackInterface> callback;
     connection_.NoOp(callback);
@@ -103,7 +103,7 @@ TEST_F(NonblockingKineticConnectionTest, NoOpWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, GetWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _))
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _))
             .WillOnce(DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<GetCallbackInterface> callback;
     connection_.Get("key", callback);
@@ -116,7 +116,7 @@ TEST_F(NonblockingKineticConnectionTest, GetWorks) {
 TEST_F(NonblockingKineticConnectionTest, GetWithClusterVersionWorks) {
     connection_.SetClientClusterVersion(123);
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _))
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _))
             .WillOnce(DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<GetCallbackInterface> callback;
     connection_.Get("key", callback);
@@ -128,7 +128,7 @@ TEST_F(NonblockingKineticConnectionTest, GetWithClusterVersionWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, GetNextWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<GetCallbackInterface> callback;
     connection_.GetNext("key", callback);
@@ -139,7 +139,7 @@ TEST_F(NonblockingKineticConnectionTest, GetNextWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, GetPreviousWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.GetPrevious("key", shared_ptr<GetCallbackInterface>());
 
@@ -149,7 +149,7 @@ TEST_F(NonblockingKineticConnectionTest, GetPreviousWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, GetVersionWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.GetVersion("key", shared_ptr<GetVersionCallbackInterface>());
 
@@ -159,7 +159,7 @@ TEST_F(NonblockingKineticConnectionTest, GetVersionWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, DeleteWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.Delete("key", "version", WriteMode::IGNORE_VERSION, shared_ptr<SimpleCallbackInterface>());
 
@@ -172,7 +172,7 @@ TEST_F(NonblockingKineticConnectionTest, DeleteWorks) {
 
 TEST_F(NonblockingKineticConnectionTest, PutWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq("value"), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq("value"), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     auto record = make_shared<KineticRecord>("value", "new_version", "tag", Command_Algorithm_SHA1);
     shared_ptr<PutCallbackInterface> callback;
@@ -189,9 +189,24 @@ TEST_F(NonblockingKineticConnectionTest, PutWorks) {
     ASSERT_EQ(Command_Synchronization_WRITEBACK, message.body().keyvalue().synchronization());
 }
 
+TEST_F(NonblockingKineticConnectionTest, PutSendsSlicedValueWithoutJoiningIt) {
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq("headerpayloadtrailer"), _)).WillOnce(
+            Return(0));
+    std::vector<ValueSlice> slices;
+    slices.push_back(ValueSlice(make_shared<string>("header")));
+    slices.push_back(ValueSlice(make_shared<string>("payload")));
+    slices.push_back(ValueSlice(make_shared<string>("trailer")));
+    auto record = make_shared<KineticRecord>(PacketValue(slices), make_shared<string>("new_version"),
+            make_shared<string>("tag"), Command_Algorithm_SHA1);
+    ASSERT_FALSE(record->value());
+    shared_ptr<PutCallbackInterface> callback;
+    connection_.Put(make_shared<string>("key"), make_shared<string>("old_version"), WriteMode::IGNORE_VERSION,
+            record, callback);
+}
+
 TEST_F(NonblockingKineticConnectionTest, GetKeyRangeWorks) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.GetKeyRange("first", true, "last", false, true, 1234, shared_ptr<GetKeyRangeCallbackInterface>());
 
@@ -226,7 +241,7 @@ TEST_F(NonblockingKineticConnectionTest, GetKeyRangeParsesResult) {
 
 TEST_F(NonblockingKineticConnectionTest, InstantEraseWorksWithNullPin) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<string> null_ptr;
     shared_ptr<MockSimpleCallback> null_callback;
@@ -239,7 +254,7 @@ TEST_F(NonblockingKineticConnectionTest, InstantEraseWorksWithNullPin) {
 TEST_F(NonblockingKineticConnectionTest, InstantEraseWorksWithNonNullPin) {
     const std::string pin("1234");
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<MockSimpleCallback> null_callback;
     connection_.InstantErase(pin, shared_ptr<SimpleCallbackInterface>());
@@ -250,7 +265,7 @@ TEST_F(NonblockingKineticConnectionTest, InstantEraseWorksWithNonNullPin) {
 
 TEST_F(NonblockingKineticConnectionTest, SetClusterVersionSendsCorrectVersion) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.SetClusterVersion(1234, shared_ptr<SimpleCallbackInterface>());
 
@@ -273,7 +288,7 @@ TEST_F(NonblockingKineticConnectionTest, SetClusterVersionReturnsTrueForSuccess)
 
 TEST_F(NonblockingKineticConnectionTest, GetLogBuildsCorrectMessage) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.GetLog(shared_ptr<GetLogCallbackInterface>());
 
@@ -373,7 +388,7 @@ TEST_F(NonblockingKineticConnectionTest, GetLogParsesMessageCorrectly) {
 
 TEST_F(NonblockingKineticConnectionTest, FirmwareUpdateSendsFirmwareContents) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq("the new firmware"), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq("the new firmware"), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     connection_.UpdateFirmware(make_shared<string>("the new firmware"), shared_ptr<SimpleCallbackInterface>());
 
@@ -411,7 +426,7 @@ TEST_F(NonblockingKineticConnectionTest, SetACLsBuildsCorrectMessage) {
     acls->push_back(acl2);
 
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<MockSimpleCallback> null_callback;
     connection_.SetACLs(acls, null_callback);
@@ -459,7 +474,7 @@ TEST_F(NonblockingKineticConnectionTest, SetACLsBuildsCorrectMessage) {
 
 TEST_F(NonblockingKineticConnectionTest, SetErasePinBuildsCorrectMessageForNoCurrentPin) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<MockSimpleCallback> null_callback;
     shared_ptr<string> null_str;
@@ -473,7 +488,7 @@ TEST_F(NonblockingKineticConnectionTest, SetErasePinBuildsCorrectMessageForNoCur
 TEST_F(NonblockingKineticConnectionTest, SetErasePinBuildsCorrectMessageIfCurrentPin) {
     auto oldpin = "oldoldold";
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
     shared_ptr<MockSimpleCallback> null_callback;
     connection_.SetErasePIN("newnewnew", oldpin, null_callback);
@@ -486,7 +501,7 @@ TEST_F(NonblockingKineticConnectionTest, SetErasePinBuildsCorrectMessageIfCurren
 
 TEST_F(NonblockingKineticConnectionTest, P2PPushBuildsCorrectMessage) {
     Command message;
-    EXPECT_CALL(*packet_service_, Submit_(_, _, StringSharedPtrEq(""), _)).WillOnce(
+    EXPECT_CALL(*packet_service_, Submit_(_, _, PacketValueEq(""), _)).WillOnce(
             DoAll(SaveArg<1>(&message), Return(0)));
 
 
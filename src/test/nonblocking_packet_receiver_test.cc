@@ -16,6 +16,7 @@
  */
 
 #include <arpa/inet.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include "gmock/gmock.h"
@@ -24,6 +25,7 @@
 #include "nonblocking_packet_service.h"
 #include "mock_socket_wrapper_interface.h"
 #include "mock_nonblocking_packet_service.h"
+#include "mock_callbacks.h"
 #include "matchers.h"
 
 #include <fcntl.h>
@@ -51,6 +53,8 @@ using std::make_shared;
 
 class NonblockingReceiverTest : public ::testing::Test {
     protected:
+    NonblockingReceiverTest() : hmac_provider_(make_shared<HmacProvider>()) {}
+
     // Create a pipe that we can use to feed data to the NonblockingReceiver
     void SetUp() {
         ASSERT_EQ(0, pipe(fds_));
@@ -75,7 +79,7 @@ class NonblockingReceiverTest : public ::testing::Test {
         if(!message.has_authtype()){
             message.set_authtype(Message_AuthType_HMACAUTH);
             message.mutable_hmacauth()->set_identity(3);
-            message.mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(message, "key"));
+            message.mutable_hmacauth()->set_hmac(hmac_provider_->ComputeHmac(message, "key"));
         }
 
         std::string serialized_message;
@@ -91,7 +95,7 @@ class NonblockingReceiverTest : public ::testing::Test {
     }
 
     int fds_[2];
-    HmacProvider hmac_provider_;
+    shared_ptr<HmacProvider> hmac_provider_;
 
     void defaultReceiverSetup(Command &command,
             shared_ptr<MockSocketWrapperInterface> socket_wrapper, ConnectionOptions &options) {
@@ -129,6 +133,86 @@ TEST_F(NonblockingReceiverTest, SimpleMessageAndValue) {
     ASSERT_EQ(kIdle, receiver.Receive());
 }
 
+TEST_F(NonblockingReceiverTest, ReceivesValueIntoHandlerBuffer) {
+    Command command;
+    Message message;
+    command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+    command.mutable_header()->set_acksequence(33);
+    command.mutable_body()->mutable_keyvalue()->set_key("key");
+    WritePacket(message, command, "value");
+
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+
+    ConnectionOptions options;
+    options.user_id = 3;
+    options.hmac_key = "key";
+    NonblockingReceiver receiver(socket_wrapper, hmac_provider_, options);
+
+    char buffer[16];
+    auto callback = make_shared<StrictMock<MockGetIntoCallback>>();
+    EXPECT_CALL(*callback, Success("key", 5, _, _, _));
+    ASSERT_TRUE(receiver.Enqueue(make_shared<GetIntoHandler>(buffer, sizeof(buffer), callback), 33, 0));
+    ASSERT_EQ(kIdle, receiver.Receive());
+    ASSERT_EQ("value", string(buffer, 5));
+}
+
+TEST_F(NonblockingReceiverTest, GetIntoFailsWhenValueDoesNotFit) {
+    Command command;
+    Message message;
+    command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+    command.mutable_header()->set_acksequence(33);
+    WritePacket(message, command, "value");
+
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+
+    ConnectionOptions options;
+    options.user_id = 3;
+    options.hmac_key = "key";
+    NonblockingReceiver receiver(socket_wrapper, hmac_provider_, options);
+
+    char buffer[4];
+    auto callback = make_shared<StrictMock<MockGetIntoCallback>>();
+    EXPECT_CALL(*callback, Failure(_));
+    ASSERT_TRUE(receiver.Enqueue(make_shared<GetIntoHandler>(buffer, sizeof(buffer), callback), 33, 0));
+    ASSERT_EQ(kIdle, receiver.Receive());
+}
+
+TEST_F(NonblockingReceiverTest, ReceivesValueIntoHandlerFile) {
+    Command command;
+    Message message;
+    command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+    command.mutable_header()->set_acksequence(33);
+    command.mutable_body()->mutable_keyvalue()->set_key("key");
+    WritePacket(message, command, "value");
+
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+
+    ConnectionOptions options;
+    options.user_id = 3;
+    options.hmac_key = "key";
+    NonblockingReceiver receiver(socket_wrapper, hmac_provider_, options);
+
+    char path[] = "/tmp/kinetic_get_to_file_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_NE(-1, file_fd);
+    ASSERT_EQ(0, unlink(path));
+    auto callback = make_shared<StrictMock<MockGetIntoCallback>>();
+    EXPECT_CALL(*callback, Success("key", 5, _, _, _));
+    ASSERT_TRUE(receiver.Enqueue(make_shared<GetIntoHandler>(file_fd, 2, callback), 33, 0));
+    ASSERT_EQ(kIdle, receiver.Receive());
+
+    char contents[8];
+    ASSERT_EQ(7, pread(file_fd, contents, sizeof(contents), 0));
+    ASSERT_EQ(string("\0\0value", 7), string(contents, 7));
+    ASSERT_EQ(0, close(file_fd));
+}
+
 TEST_F(NonblockingReceiverTest, ReceiveResponsesOutOfOrder) {
     Command command;
     Message message;
@@ -226,7 +310,7 @@ TEST_F(NonblockingReceiverTest, HandlesHmacError) {
     message.set_commandbytes(command.SerializeAsString());
     message.set_authtype(Message_AuthType_HMACAUTH);
     message.mutable_hmacauth()->set_identity(options.user_id);
-    message.mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(message, "wrong_hmac"));
+    message.mutable_hmacauth()->set_hmac(hmac_provider_->ComputeHmac(message, "wrong_hmac"));
     WritePacket(message, command,  "");
     auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
     EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[0]));
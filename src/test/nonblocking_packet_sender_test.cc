@@ -18,6 +18,9 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include <thread>
+#include <vector>
+
 #include "gmock/gmock.h"
 
 #include "kinetic/kinetic.h"
@@ -38,10 +41,12 @@ using com::seagate::kinetic::client::proto::Command_Status_StatusCode_SUCCESS;
 using std::string;
 using std::make_shared;
 using std::unique_ptr;
+using std::thread;
+using std::vector;
 
 class NonblockingSenderTest : public ::testing::Test {
     protected:
-    NonblockingSenderTest() : closed_read_end_(false),
+    NonblockingSenderTest() : closed_read_end_(false), hmac_provider_(make_shared<HmacProvider>()),
     writer_factory_(unique_ptr<NonblockingPacketWriterFactoryInterface>(
         new NonblockingPacketWriterFactory())) {}
     // Create a pipe that we can use to feed data to the NonblockingReceiver
@@ -58,7 +63,7 @@ class NonblockingSenderTest : public ::testing::Test {
 
     int fds_[2];
     bool closed_read_end_;
-    HmacProvider hmac_provider_;
+    shared_ptr<HmacProvider> hmac_provider_;
     shared_ptr<NonblockingPacketWriterFactoryInterface> writer_factory_;
 };
 
@@ -77,11 +82,13 @@ TEST_F(NonblockingSenderTest, SimpleMessageAndValue) {
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, writer_factory_, hmac_provider_,
         options);
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>("value"), move(handler), 0);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("value")), move(handler), 0);
     ASSERT_EQ(kIdle, sender.Send());
 
     // Check that the pipe now contains what it's supposed to
@@ -126,15 +133,46 @@ TEST_F(NonblockingSenderTest, CallsErrorWhenCannotEnqueueHandler) {
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
 
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>("value"), move(handler), 0);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("value")), move(handler), 0);
     ASSERT_EQ(kIdle, sender.Send());
 }
 
+TEST_F(NonblockingSenderTest, RecyclesMessagesAndCommands) {
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    auto receiver = make_shared<NiceMock<MockNonblockingReceiver>>();
+    EXPECT_CALL(*receiver, Enqueue_(_, _, _)).WillRepeatedly(Return(true));
+    ConnectionOptions options;
+    options.user_id = 3;
+    options.hmac_key = "key";
+    auto pools = make_shared<RequestPools>();
+    NonblockingSender sender(socket_wrapper, receiver, writer_factory_, hmac_provider_, options, pools);
+
+    // Each request's message and command are back in the pools by the time
+    // the next one is built
+    for (int i = 0; i < 20; i++) {
+        unique_ptr<Message> message = pools->messages.Acquire();
+        message->set_authtype(com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH);
+        unique_ptr<Command> command = pools->commands.Acquire();
+        command->mutable_header()->set_messagetype(
+            com::seagate::kinetic::client::proto::Command_MessageType_NOOP);
+        sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")),
+            unique_ptr<HandlerInterface>(new MockHandler()), i);
+        ASSERT_EQ(kIdle, sender.Send());
+    }
+    ASSERT_EQ(1u, pools->messages.allocations());
+    ASSERT_EQ(1u, pools->commands.allocations());
+}
+
 TEST_F(NonblockingSenderTest, UsesCorrectConnectionId) {
     auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
     EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[1]));
@@ -146,11 +184,12 @@ TEST_F(NonblockingSenderTest, UsesCorrectConnectionId) {
     EXPECT_CALL(*receiver, Enqueue_(handler.get(), 0, 0)).WillOnce(Return(true));
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(42));
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>(""), move(handler), 0);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler), 0);
     ASSERT_EQ(kIdle, sender.Send());
 
     // Check that the resulting message has the right connection id
@@ -190,6 +229,8 @@ TEST_F(NonblockingSenderTest, HandlesWriteError) {
     auto receiver = make_shared<NiceMock<MockNonblockingReceiver>>();
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
 
@@ -198,7 +239,7 @@ TEST_F(NonblockingSenderTest, HandlesWriteError) {
             StatusCode::CLIENT_IO_ERROR, "I/O write error"), NULL));
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>(""), move(handler), 0);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler), 0);
     ASSERT_EQ(kError, sender.Send());
 }
 
@@ -217,7 +258,7 @@ TEST_F(NonblockingSenderTest, MaintainsCorrectHandlerKeyWhenWriteDoesntCompleteO
     EXPECT_CALL(*receiver, Enqueue_(handler3.get(), 2, 2)).WillOnce(Return(true));
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
 
-    auto value = make_shared<string>("value");
+    PacketValue value(make_shared<string>("value"));
 
     auto mock_writer1 = new StrictMock<MockNonblockingPacketWriter>();
     EXPECT_CALL(*mock_writer1, Write())
@@ -244,6 +285,8 @@ TEST_F(NonblockingSenderTest, MaintainsCorrectHandlerKeyWhenWriteDoesntCompleteO
         .WillOnce(Return(mock_writer3));
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver,
         shared_ptr<NonblockingPacketWriterFactoryInterface>(mock_factory), hmac_provider_,
         options);
@@ -271,6 +314,7 @@ TEST_F(NonblockingSenderTest, ErrorCausesAllEnqueuedRequestsToFail) {
     options.hmac_key = "key";
     auto receiver = make_shared<NiceMock<MockNonblockingReceiver>>();
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
 
@@ -282,10 +326,10 @@ TEST_F(NonblockingSenderTest, ErrorCausesAllEnqueuedRequestsToFail) {
             StatusCode::CLIENT_IO_ERROR, "I/O write error"), NULL));
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>(""), move(handler1), 0);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler1), 0);
     message.reset(new Message());
     command.reset(new Command());
-    sender.Enqueue(move(message), move(command), make_shared<string>(""), move(handler2), 1);
+    sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler2), 1);
     ASSERT_EQ(kError, sender.Send());
 }
 
@@ -297,6 +341,7 @@ TEST_F(NonblockingSenderTest, DestructorDeletesOutstandingRequests) {
     options.hmac_key = "key";
     auto receiver = make_shared<NiceMock<MockNonblockingReceiver>>();
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender *sender = new NonblockingSender(socket_wrapper, receiver,
         move(writer_factory_), hmac_provider_, options);
 
@@ -308,10 +353,10 @@ TEST_F(NonblockingSenderTest, DestructorDeletesOutstandingRequests) {
         "Sender shutdown"), NULL));
     unique_ptr<Message> message(new Message());
     unique_ptr<Command> command(new Command());
-    sender->Enqueue(move(message), move(command), make_shared<string>(""), move(handler1), 0);
+    sender->Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler1), 0);
     message.reset(new Message());
     command.reset(new Command());
-    sender->Enqueue(move(message), move(command), make_shared<string>(""), move(handler2), 1);
+    sender->Enqueue(move(message), move(command), PacketValue(make_shared<string>("")), move(handler2), 1);
 
     delete sender;
 }
@@ -326,6 +371,8 @@ TEST_F(NonblockingSenderTest, EnqueueAndRemoveDoesntInvoke) {
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
 
@@ -339,8 +386,8 @@ TEST_F(NonblockingSenderTest, EnqueueAndRemoveDoesntInvoke) {
     // message sequence 1 means 2nd handler
     EXPECT_CALL(*receiver, Enqueue_(handler2.get(), 1, 1)).WillOnce(Return(true));
 
-    sender.Enqueue(move(message1), move(command1), make_shared<string>(""), move(handler1), 0);
-    sender.Enqueue(move(message2), move(command2), make_shared<string>(""), move(handler2), 1);
+    sender.Enqueue(move(message1), move(command1), PacketValue(make_shared<string>("")), move(handler1), 0);
+    sender.Enqueue(move(message2), move(command2), PacketValue(make_shared<string>("")), move(handler2), 1);
 
     // first handler should not get called
     ASSERT_TRUE(sender.Remove(0));
@@ -348,6 +395,51 @@ TEST_F(NonblockingSenderTest, EnqueueAndRemoveDoesntInvoke) {
     ASSERT_EQ(kIdle, sender.Send());
 }
 
+TEST_F(NonblockingSenderTest, ConcurrentEnqueuesAreSentInSequenceOrder) {
+    const int kThreads = 8;
+    const int kRequestsPerThread = 50;
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[1]));
+    ConnectionOptions options;
+    options.user_id = 3;
+    options.hmac_key = "key";
+    auto receiver = make_shared<StrictMock<MockNonblockingReceiver>>();
+    EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
+    vector<google::int64> sequences;
+    EXPECT_CALL(*receiver, Enqueue_(_, _, _)).Times(kThreads * kRequestsPerThread).WillRepeatedly(
+        ::testing::DoAll(::testing::Invoke([&sequences](HandlerInterface *handler,
+            google::int64 sequence, HandlerKey handler_key) { sequences.push_back(sequence); }),
+        Return(true)));
+
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
+        options);
+
+    vector<thread> threads;
+    for (int i = 0; i < kThreads; i++) {
+        threads.push_back(thread([&sender, i, kRequestsPerThread]() {
+            for (int j = 0; j < kRequestsPerThread; j++) {
+                unique_ptr<Message> message(new Message());
+                unique_ptr<Command> command(new Command());
+                unique_ptr<HandlerInterface> handler(new NiceMock<MockHandler>());
+                sender.Enqueue(move(message), move(command), PacketValue(make_shared<string>("")),
+                    move(handler), i * kRequestsPerThread + j);
+            }
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    ASSERT_EQ(kIdle, sender.Send());
+    ASSERT_EQ(static_cast<size_t>(kThreads * kRequestsPerThread), sequences.size());
+    for (size_t i = 0; i < sequences.size(); i++) {
+        ASSERT_EQ(static_cast<google::int64>(i), sequences[i]);
+    }
+}
+
 TEST_F(NonblockingSenderTest, RemoveInvalidKeyReturnsFalse) {
     auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
     EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds_[1]));
@@ -358,6 +450,8 @@ TEST_F(NonblockingSenderTest, RemoveInvalidKeyReturnsFalse) {
     EXPECT_CALL(*receiver, connection_id()).WillRepeatedly(Return(1));
 
     EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*)0));
+
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
     NonblockingSender sender(socket_wrapper, receiver, move(writer_factory_), hmac_provider_,
         options);
 
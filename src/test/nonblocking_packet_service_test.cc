@@ -47,6 +47,9 @@ TEST(NonblockingPacketServiceTest, HandlesSenderFailure) {
     auto receiver = make_shared<StrictMock<MockNonblockingReceiver>>();
     auto socket_wrapper = make_shared<StrictMock<MockSocketWrapperInterface>>();
     EXPECT_CALL(*sender, Send()).WillOnce(Return(kError));
+    EXPECT_CALL(*sender, FailAll(_));
+    // Requests waiting for responses won't get them now
+    EXPECT_CALL(*receiver, FailAll(KineticStatusEq(StatusCode::CLIENT_IO_ERROR, "Connection failed")));
 
     NonblockingPacketService service(socket_wrapper, unique_ptr<NonblockingSenderInterface>(sender),
         receiver);
@@ -64,6 +67,8 @@ TEST(NonblockingPacketServiceTest, SubmitAfterFailureInvokesErrorOnCallback) {
     auto receiver = make_shared<StrictMock<MockNonblockingReceiver>>();
     auto socket_wrapper = make_shared<StrictMock<MockSocketWrapperInterface>>();
     EXPECT_CALL(*sender, Send()).WillOnce(Return(kError));
+    EXPECT_CALL(*sender, FailAll(_));
+    EXPECT_CALL(*receiver, FailAll(_));
 
     NonblockingPacketService service(socket_wrapper, unique_ptr<NonblockingSenderInterface>(sender),
         receiver);
@@ -77,10 +82,34 @@ TEST(NonblockingPacketServiceTest, SubmitAfterFailureInvokesErrorOnCallback) {
     EXPECT_CALL(*handler, Error(KineticStatusEq(StatusCode::CLIENT_SHUTDOWN,
         "Client already shut down"), NULL));
 
-    service.Submit(unique_ptr<Message>(), unique_ptr<Command>(), make_shared<string>("zomg"),
+    service.Submit(unique_ptr<Message>(), unique_ptr<Command>(), PacketValue(make_shared<string>("zomg")),
         unique_ptr<HandlerInterface>(handler));
 }
 
+TEST(NonblockingPacketServiceTest, FailsSubmissionQueuedAsTheConnectionFails) {
+    // The connection fails after Submit has checked for that but before the
+    // request reaches the sender, so the sender's FailAll has already run
+    auto sender = new MockNonblockingSender();
+    auto receiver = make_shared<StrictMock<MockNonblockingReceiver>>();
+    auto socket_wrapper = make_shared<StrictMock<MockSocketWrapperInterface>>();
+    NonblockingPacketService service(socket_wrapper, unique_ptr<NonblockingSenderInterface>(sender),
+        receiver);
+
+    EXPECT_CALL(*sender, Send()).WillOnce(Return(kError));
+    EXPECT_CALL(*sender, Enqueue_(_, _, _, _, _)).WillOnce(::testing::InvokeWithoutArgs([&service]() {
+        fd_set read_fds, write_fds;
+        int nfds;
+        ASSERT_FALSE(service.Run(&read_fds, &write_fds, &nfds));
+    }));
+    EXPECT_CALL(*receiver, FailAll(_));
+    // Once for the failure and once more for the request that missed it
+    EXPECT_CALL(*sender, FailAll(KineticStatusEq(StatusCode::CLIENT_IO_ERROR, "Connection failed")))
+        .Times(2);
+
+    service.Submit(unique_ptr<Message>(new Message()), unique_ptr<Command>(new Command()),
+        PacketValue(make_shared<string>("zomg")), unique_ptr<HandlerInterface>(new MockHandler()));
+}
+
 TEST(NonblockingPacketServiceTest, CanRemoveHandlerAfterError) {
     // If the sender fails, the service should return an error and subsequent
     // calls should fail immediately without even attempting I/O.
@@ -90,6 +119,8 @@ TEST(NonblockingPacketServiceTest, CanRemoveHandlerAfterError) {
 
     EXPECT_CALL(*sender, Remove(42)).WillOnce(Return(false));
     EXPECT_CALL(*sender, Send()).WillOnce(Return(kError));
+    EXPECT_CALL(*sender, FailAll(_));
+    EXPECT_CALL(*receiver, FailAll(_));
     EXPECT_CALL(*receiver, Remove(42)).WillOnce(Return(false));
 
     NonblockingPacketService service(socket_wrapper, unique_ptr<NonblockingSenderInterface>(sender),
@@ -163,6 +194,9 @@ TEST(NonblockingPacketServiceTest, HandlesReceiverFailure) {
 
     EXPECT_CALL(*sender, Send()).WillOnce(Return(kIdle));
     EXPECT_CALL(*receiver, Receive()).WillOnce(Return(kError));
+    // Requests still waiting to be sent can't be now
+    EXPECT_CALL(*sender, FailAll(KineticStatusEq(StatusCode::CLIENT_IO_ERROR, "Connection failed")));
+    EXPECT_CALL(*receiver, FailAll(KineticStatusEq(StatusCode::CLIENT_IO_ERROR, "Connection failed")));
 
     NonblockingPacketService service(socket_wrapper, unique_ptr<NonblockingSenderInterface>(sender),
         receiver);
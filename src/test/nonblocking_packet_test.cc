@@ -15,8 +15,16 @@
  * See www.openkinetic.org for more project information
  */
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <stdlib.h>
 #include <unistd.h>
 
+#include "glog/logging.h"
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "kinetic/kinetic.h"
@@ -31,6 +39,7 @@ using std::make_shared;
 using std::unique_ptr;
 using std::move;
 using std::string;
+using std::vector;
 using ::testing::Return;
 
 TEST(NonblockingPacketWriterTest, EmptyMessageAndValue) {
@@ -40,7 +49,9 @@ TEST(NonblockingPacketWriterTest, EmptyMessageAndValue) {
     auto value = make_shared<string>("");
     auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
     EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
-    NonblockingPacketWriter request(socket_wrapper, move(message), move(value));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, move(message), PacketValue(value));
     ASSERT_EQ(kDone, request.Write());
     ASSERT_EQ(0, close(fds[1]));
 
@@ -56,6 +67,347 @@ TEST(NonblockingPacketWriterTest, EmptyMessageAndValue) {
     ASSERT_EQ(0, close(fds[0]));
 }
 
+TEST(NonblockingPacketWriterTest, ResumesAfterPartialWrite) {
+    // Use a value bigger than the pipe buffer so that the first Write can only
+    // send part of the packet
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    unique_ptr<Message> message(new Message());
+    message->set_commandbytes("command");
+    string expected_message;
+    ASSERT_TRUE(message->SerializeToString(&expected_message));
+    auto value = make_shared<string>(1024 * 1024, 'v');
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, move(message), PacketValue(value));
+
+    string received;
+    char buf[65536];
+    NonblockingStringStatus status;
+    while ((status = request.Write()) == kInProgress) {
+        ssize_t n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+    }
+    ASSERT_EQ(kDone, status);
+    ASSERT_EQ(0, close(fds[1]));
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        received.append(buf, n);
+    }
+    ASSERT_EQ(0, close(fds[0]));
+
+    ASSERT_EQ(9 + expected_message.size() + value->size(), received.size());
+    ASSERT_EQ('F', received[0]);
+    ASSERT_EQ(expected_message.size(), ntohl(*reinterpret_cast<const uint32_t *>(received.data() + 1)));
+    ASSERT_EQ(value->size(), ntohl(*reinterpret_cast<const uint32_t *>(received.data() + 5)));
+    ASSERT_EQ(expected_message, received.substr(9, expected_message.size()));
+    ASSERT_TRUE(*value == received.substr(9 + expected_message.size()));
+}
+
+TEST(NonblockingPacketWriterTest, SendsSlicedValue) {
+    // More slices than fit in one writev, some of them empty and some larger
+    // than the pipe buffer
+    vector<ValueSlice> slices;
+    string expected_value;
+    for (int i = 0; i < 100; i++) {
+        auto piece = make_shared<string>(i % 3 == 0 ? 0 : (i % 7 == 0 ? 100000 : i), 'a' + i % 26);
+        slices.push_back(ValueSlice(piece));
+        expected_value += *piece;
+    }
+    // A slice pointing into the middle of a buffer
+    auto buffer = make_shared<vector<char>>(10, 'z');
+    slices.push_back(ValueSlice(buffer, buffer->data() + 2, 5));
+    expected_value += "zzzzz";
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    unique_ptr<Message> message(new Message());
+    message->set_commandbytes("command");
+    string expected_message;
+    ASSERT_TRUE(message->SerializeToString(&expected_message));
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, move(message), PacketValue(slices));
+
+    string received;
+    char buf[65536];
+    NonblockingStringStatus status;
+    while ((status = request.Write()) == kInProgress) {
+        ssize_t n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+    }
+    ASSERT_EQ(kDone, status);
+    ASSERT_EQ(0, close(fds[1]));
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        received.append(buf, n);
+    }
+    ASSERT_EQ(0, close(fds[0]));
+
+    ASSERT_EQ(9 + expected_message.size() + expected_value.size(), received.size());
+    ASSERT_EQ(expected_value.size(), ntohl(*reinterpret_cast<const uint32_t *>(received.data() + 5)));
+    ASSERT_EQ(expected_message, received.substr(9, expected_message.size()));
+    ASSERT_TRUE(expected_value == received.substr(9 + expected_message.size()));
+}
+
+// Connects two TCP sockets over loopback, since MSG_ZEROCOPY needs a real socket
+static void ConnectLoopback(int *client_fd, int *server_fd) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, listen_fd);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, listen(listen_fd, 1));
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(0, getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len));
+
+    *client_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, *client_fd);
+    ASSERT_EQ(0, connect(*client_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    *server_fd = accept(listen_fd, NULL, NULL);
+    ASSERT_NE(-1, *server_fd);
+    ASSERT_EQ(0, close(listen_fd));
+    ASSERT_EQ(0, fcntl(*client_fd, F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(*server_fd, F_SETFL, O_NONBLOCK));
+}
+
+TEST(NonblockingPacketWriterTest, KeepsZerocopyValueUntilKernelIsDone) {
+    int client_fd, server_fd;
+    ConnectLoopback(&client_fd, &server_fd);
+    auto zerocopy = make_shared<ZerocopyTracker>(client_fd, 64 * 1024);
+    if (!zerocopy->Enable()) {
+        LOG(INFO) << "MSG_ZEROCOPY isn't supported here, skipping";
+        ASSERT_EQ(0, close(client_fd));
+        ASSERT_EQ(0, close(server_fd));
+        return;
+    }
+
+    unique_ptr<Message> message(new Message());
+    message->set_commandbytes("command");
+    string expected_message;
+    ASSERT_TRUE(message->SerializeToString(&expected_message));
+    auto value = make_shared<string>(1024 * 1024, 'v');
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(client_fd));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(true));
+    unique_ptr<NonblockingPacketWriter> request(
+        new NonblockingPacketWriter(socket_wrapper, move(message), PacketValue(value), zerocopy));
+
+    string received;
+    char buf[65536];
+    NonblockingStringStatus status;
+    while ((status = request->Write()) == kInProgress) {
+        ssize_t n;
+        while ((n = read(server_fd, buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+    }
+    ASSERT_EQ(kDone, status);
+    request.reset();
+    ASSERT_LT(0u, zerocopy->pending());
+    ASSERT_LT(1, value.use_count());
+
+    // Completions arrive once the data has been acknowledged
+    for (int i = 0; i < 1000 && (zerocopy->pending() > 0 || received.size() <
+            9 + expected_message.size() + value->size()); i++) {
+        ssize_t n;
+        while ((n = read(server_fd, buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+        zerocopy->Reap();
+        usleep(1000);
+    }
+    ASSERT_EQ(0u, zerocopy->pending());
+    ASSERT_EQ(1, value.use_count());
+    ASSERT_EQ(9 + expected_message.size() + value->size(), received.size());
+    ASSERT_EQ(expected_message, received.substr(9, expected_message.size()));
+    ASSERT_TRUE(*value == received.substr(9 + expected_message.size()));
+
+    ASSERT_EQ(0, close(client_fd));
+    ASSERT_EQ(0, close(server_fd));
+}
+
+TEST(NonblockingPacketWriterTest, FactoryReapsZerocopyCompletionsWhenIdle) {
+    int client_fd, server_fd;
+    ConnectLoopback(&client_fd, &server_fd);
+    auto zerocopy = make_shared<ZerocopyTracker>(client_fd, 64 * 1024);
+    if (!zerocopy->Enable()) {
+        LOG(INFO) << "MSG_ZEROCOPY isn't supported here, skipping";
+        ASSERT_EQ(0, close(client_fd));
+        ASSERT_EQ(0, close(server_fd));
+        return;
+    }
+
+    auto value = make_shared<string>(1024 * 1024, 'v');
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(client_fd));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(true));
+    NonblockingPacketWriterFactory factory(zerocopy);
+    Message envelope;
+    Command command;
+    unique_ptr<string> packet(new string());
+    ASSERT_TRUE(EncodeRequest(envelope, command, value->size(), 1, HmacProvider(), "key", packet.get()));
+    unique_ptr<NonblockingPacketWriterInterface> writer =
+        factory.CreateWriter(socket_wrapper, move(packet), PacketValue(value));
+
+    size_t received = 0;
+    char buf[65536];
+    NonblockingStringStatus status;
+    while ((status = writer->Write()) == kInProgress) {
+        ssize_t n;
+        while ((n = read(server_fd, buf, sizeof(buf))) > 0) {
+            received += n;
+        }
+    }
+    ASSERT_EQ(kDone, status);
+    writer.reset();
+
+    // With no more sends to make, it's the factory that picks up the
+    // completion. Until then the socket reports an error to anyone polling it.
+    for (int i = 0; i < 1000 && zerocopy->pending() > 0; i++) {
+        ssize_t n;
+        while ((n = read(server_fd, buf, sizeof(buf))) > 0) {
+            received += n;
+        }
+        factory.Reap();
+        usleep(1000);
+    }
+    ASSERT_EQ(0u, zerocopy->pending());
+    ASSERT_EQ(1, value.use_count());
+    struct pollfd pfd = {client_fd, 0, 0};
+    ASSERT_EQ(0, poll(&pfd, 1, 0));
+
+    ASSERT_EQ(0, close(client_fd));
+    ASSERT_EQ(0, close(server_fd));
+}
+
+TEST(NonblockingPacketWriterTest, SendsValueFromFile) {
+    // Put the value in the middle of a file to check that only the given
+    // range is sent
+    char path[] = "/tmp/kinetic_file_value_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_NE(-1, file_fd);
+    ASSERT_EQ(0, unlink(path));
+    string value(200 * 1024 + 3, 'v');
+    string contents = "prefix" + value + "suffix";
+    ASSERT_EQ(static_cast<ssize_t>(contents.size()), write(file_fd, contents.data(), contents.size()));
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    unique_ptr<Message> message(new Message());
+    message->set_commandbytes("command");
+    string expected_message;
+    ASSERT_TRUE(message->SerializeToString(&expected_message));
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, move(message), PacketValue(file_fd, 6, value.size()));
+
+    string received;
+    char buf[65536];
+    NonblockingStringStatus status;
+    while ((status = request.Write()) == kInProgress) {
+        ssize_t n;
+        while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+            received.append(buf, n);
+        }
+    }
+    ASSERT_EQ(kDone, status);
+    ASSERT_EQ(0, close(fds[1]));
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        received.append(buf, n);
+    }
+    ASSERT_EQ(0, close(fds[0]));
+    ASSERT_EQ(0, close(file_fd));
+
+    ASSERT_EQ(9 + expected_message.size() + value.size(), received.size());
+    ASSERT_EQ(value.size(), ntohl(*reinterpret_cast<const uint32_t *>(received.data() + 5)));
+    ASSERT_EQ(expected_message, received.substr(9, expected_message.size()));
+    ASSERT_TRUE(value == received.substr(9 + expected_message.size()));
+}
+
+TEST(NonblockingPacketWriterTest, FailsWhenFileIsShorterThanValue) {
+    char path[] = "/tmp/kinetic_file_value_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_NE(-1, file_fd);
+    ASSERT_EQ(0, unlink(path));
+    ASSERT_EQ(5, write(file_fd, "value", 5));
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, unique_ptr<Message>(new Message()),
+        PacketValue(file_fd, 0, 10));
+    ASSERT_EQ(kFailed, request.Write());
+
+    ASSERT_EQ(0, close(fds[0]));
+    ASSERT_EQ(0, close(fds[1]));
+    ASSERT_EQ(0, close(file_fd));
+}
+
+TEST(NonblockingPacketWriterTest, WritesEncodedRequest) {
+    Message envelope;
+    envelope.set_authtype(com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH);
+    Command command;
+    command.mutable_header()->set_sequence(5);
+    command.mutable_header()->set_messagetype(com::seagate::kinetic::client::proto::Command_MessageType_NOOP);
+    HmacProvider hmac_provider;
+    unique_ptr<string> packet(new string("left over from the last request"));
+    ASSERT_TRUE(EncodeRequest(envelope, command, 5, 7, hmac_provider, "key", packet.get()));
+    string encoded(*packet);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[1]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    EXPECT_CALL(*socket_wrapper, is_socket()).WillRepeatedly(Return(false));
+    NonblockingPacketWriter request(socket_wrapper, move(packet), PacketValue(make_shared<string>("value")));
+    ASSERT_EQ(kDone, request.Write());
+    // The packet comes back for reuse with what was written still in it
+    packet = request.TakePacket();
+    ASSERT_TRUE(packet != NULL);
+    ASSERT_EQ(encoded, *packet);
+    ASSERT_EQ(0, close(fds[1]));
+
+    string received(encoded.size() + 5, '\0');
+    ASSERT_EQ(static_cast<ssize_t>(received.size()), read(fds[0], &received[0], received.size()));
+    ASSERT_EQ(encoded + "value", received);
+    ASSERT_EQ('F', received[0]);
+    ASSERT_EQ(encoded.size() - 9, ntohl(*reinterpret_cast<uint32_t *>(&received[1])));
+    ASSERT_EQ(5u, ntohl(*reinterpret_cast<uint32_t *>(&received[5])));
+
+    Message message;
+    ASSERT_TRUE(message.ParseFromArray(&received[9], encoded.size() - 9));
+    ASSERT_EQ(command.SerializeAsString(), message.commandbytes());
+    ASSERT_EQ(7, message.hmacauth().identity());
+    ASSERT_TRUE(hmac_provider.ValidateHmac(message, "key"));
+    ASSERT_EQ(0, close(fds[0]));
+}
+
 TEST(NonblockingPacketReaderTest, EmptyMessageAndValue) {
     // Create a pipe and write the 9-byte header into it
     int fds[2];
@@ -69,11 +421,200 @@ TEST(NonblockingPacketReaderTest, EmptyMessageAndValue) {
     unique_ptr<const string> value;
     auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
     EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[0]));
-    NonblockingPacketReader response(socket_wrapper, &message, value);
+    NonblockingPacketReader response(socket_wrapper, &message, value, NULL);
+    ASSERT_EQ(kDone, response.Read());
+    ASSERT_EQ("", *value);
+
+    ASSERT_EQ(0, close(fds[0]));
+}
+
+static string MakePacket(const string &commandbytes, const string &value) {
+    Message message;
+    message.set_commandbytes(commandbytes);
+    string serialized = message.SerializeAsString();
+    uint32_t message_length = htonl(serialized.size());
+    uint32_t value_length = htonl(value.size());
+    return "F" + string(reinterpret_cast<char *>(&message_length), 4) +
+        string(reinterpret_cast<char *>(&value_length), 4) + serialized + value;
+}
+
+TEST(NonblockingPacketReaderTest, ReadsEveryBufferedPacket) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    string packets = MakePacket("first", "value1") + MakePacket("second", "") +
+        MakePacket("third", "value3");
+    // Leave the last packet incomplete
+    size_t partial = packets.size() - 3;
+    ASSERT_EQ((ssize_t) partial, write(fds[1], packets.data(), partial));
+
+    Message message;
+    unique_ptr<const string> value;
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    NonblockingPacketReader response(socket_wrapper, &message, value, NULL);
+
     ASSERT_EQ(kDone, response.Read());
+    ASSERT_EQ("first", message.commandbytes());
+    ASSERT_EQ("value1", *value);
+    ASSERT_EQ(kDone, response.Read());
+    ASSERT_EQ("second", message.commandbytes());
     ASSERT_EQ("", *value);
+    ASSERT_EQ(kInProgress, response.Read());
+
+    ASSERT_EQ(3, write(fds[1], packets.data() + partial, 3));
+    ASSERT_EQ(kDone, response.Read());
+    ASSERT_EQ("third", message.commandbytes());
+    ASSERT_EQ("value3", *value);
+    ASSERT_EQ(kInProgress, response.Read());
+
+    ASSERT_EQ(0, close(fds[1]));
+    ASSERT_EQ(kFailed, response.Read());
+    ASSERT_EQ(0, close(fds[0]));
+}
+
+TEST(NonblockingPacketReaderTest, ReadsValueLargerThanReceiveBuffer) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    string large_value(1024 * 1024 + 7, 'v');
+    string packets = MakePacket("large", large_value) + MakePacket("small", "value");
+
+    Message message;
+    unique_ptr<const string> value;
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    NonblockingPacketReader response(socket_wrapper, &message, value, NULL);
 
+    // Feed the packets through the pipe as fast as it will take them
+    size_t written = 0;
+    NonblockingStringStatus status;
+    while ((status = response.Read()) == kInProgress) {
+        ASSERT_LT(written, packets.size());
+        ssize_t n = write(fds[1], packets.data() + written, packets.size() - written);
+        ASSERT_GT(n, 0);
+        written += n;
+    }
+    ASSERT_EQ(kDone, status);
+    ASSERT_EQ("large", message.commandbytes());
+    ASSERT_TRUE(large_value == *value);
+
+    while ((status = response.Read()) == kInProgress) {
+        ASSERT_LT(written, packets.size());
+        ssize_t n = write(fds[1], packets.data() + written, packets.size() - written);
+        ASSERT_GT(n, 0);
+        written += n;
+    }
+    ASSERT_EQ(kDone, status);
+    ASSERT_EQ("small", message.commandbytes());
+    ASSERT_EQ("value", *value);
+
+    ASSERT_EQ(0, close(fds[1]));
+    ASSERT_EQ(0, close(fds[0]));
+}
+
+// Sends every value with a non-empty key to the given file, one after another
+class FileValueSinkProvider : public ValueSinkProviderInterface {
+    public:
+    explicit FileValueSinkProvider(int fd) : fd_(fd), next_offset_(0) {}
+
+    bool GetValueSink(const Message &message, size_t value_length, ValueSink *sink) {
+        if (message.commandbytes().empty()) {
+            return false;
+        }
+        sink->fd = fd_;
+        sink->file_offset = next_offset_;
+        next_offset_ += value_length;
+        return true;
+    }
+
+    private:
+    int fd_;
+    off_t next_offset_;
+};
+
+TEST(NonblockingPacketReaderTest, ReadsValuesIntoFile) {
+    char path[] = "/tmp/kinetic_get_to_file_XXXXXX";
+    int file_fd = mkstemp(path);
+    ASSERT_NE(-1, file_fd);
+    ASSERT_EQ(0, unlink(path));
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    ASSERT_EQ(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    // The large value gets spliced, the small one fits in the receive buffer
+    // and the last one isn't wanted in the file at all
+    string large_value(1024 * 1024 + 7, 'v');
+    string packets = MakePacket("large", large_value) + MakePacket("small", "value") +
+        MakePacket("", "memory");
+
+    Message message;
+    unique_ptr<const string> value;
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    FileValueSinkProvider provider(file_fd);
+    NonblockingPacketReader response(socket_wrapper, &message, value, &provider);
+
+    size_t written = 0;
+    const char *expected[] = { "large", "small", "" };
+    for (const char *commandbytes : expected) {
+        NonblockingStringStatus status;
+        while ((status = response.Read()) == kInProgress) {
+            ASSERT_LT(written, packets.size());
+            ssize_t n = write(fds[1], packets.data() + written, packets.size() - written);
+            ASSERT_GT(n, 0);
+            written += n;
+        }
+        ASSERT_EQ(kDone, status);
+        ASSERT_EQ(commandbytes, message.commandbytes());
+        ASSERT_FALSE(response.value_sink_failed());
+    }
+    ASSERT_EQ("memory", *value);
+
+    string contents(large_value.size() + 6, '\0');
+    ASSERT_EQ(static_cast<ssize_t>(large_value.size() + 5),
+        pread(file_fd, &contents[0], contents.size(), 0));
+    ASSERT_TRUE(large_value + "value" == contents.substr(0, large_value.size() + 5));
+
+    ASSERT_EQ(0, close(fds[1]));
+    ASSERT_EQ(0, close(fds[0]));
+    ASSERT_EQ(0, close(file_fd));
+}
+
+TEST(NonblockingPacketReaderTest, ReportsValueFileWriteFailure) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    string packets = MakePacket("first", "value1") + MakePacket("", "value2");
+    ASSERT_EQ((ssize_t) packets.size(), write(fds[1], packets.data(), packets.size()));
+
+    // A read-only descriptor can't take the value, but the packet after it
+    // must still be read correctly
+    int file_fd = open("/dev/null", O_RDONLY);
+    ASSERT_NE(-1, file_fd);
+    Message message;
+    unique_ptr<const string> value;
+    auto socket_wrapper = make_shared<MockSocketWrapperInterface>();
+    EXPECT_CALL(*socket_wrapper, fd()).WillRepeatedly(Return(fds[0]));
+    EXPECT_CALL(*socket_wrapper, getSSL()).WillRepeatedly(Return((SSL*) 0));
+    FileValueSinkProvider provider(file_fd);
+    NonblockingPacketReader response(socket_wrapper, &message, value, &provider);
+
+    ASSERT_EQ(kDone, response.Read());
+    ASSERT_EQ("first", message.commandbytes());
+    ASSERT_TRUE(response.value_sink_failed());
+    ASSERT_EQ(kDone, response.Read());
+    ASSERT_FALSE(response.value_sink_failed());
+    ASSERT_EQ("value2", *value);
+
+    ASSERT_EQ(0, close(fds[1]));
     ASSERT_EQ(0, close(fds[0]));
+    ASSERT_EQ(0, close(file_fd));
 }
 
 }// namespace kinetic
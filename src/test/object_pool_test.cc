@@ -0,0 +1,100 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "object_pool.h"
+
+namespace kinetic {
+
+using std::move;
+using std::string;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+TEST(ObjectPoolTest, HandsOutReleasedObjectsCleared) {
+    ObjectPool<string> pool;
+    unique_ptr<string> object = pool.Acquire();
+    object->assign(100, 'x');
+    string *address = object.get();
+    pool.Release(move(object));
+
+    object = pool.Acquire();
+    ASSERT_EQ(address, object.get());
+    ASSERT_TRUE(object->empty());
+    ASSERT_LE(100u, object->capacity());
+    ASSERT_EQ(1u, pool.allocations());
+}
+
+TEST(ObjectPoolTest, KeepsAtMostMaxFree) {
+    ObjectPool<string> pool(2);
+    vector<unique_ptr<string>> objects;
+    for (int i = 0; i < 3; i++) {
+        objects.push_back(pool.Acquire());
+    }
+    for (int i = 0; i < 3; i++) {
+        pool.Release(move(objects[i]));
+    }
+    objects.clear();
+    for (int i = 0; i < 3; i++) {
+        objects.push_back(pool.Acquire());
+    }
+    // Only two came back out of the pool
+    ASSERT_EQ(4u, pool.allocations());
+}
+
+// Knows whether more than one thread has it at once
+struct Shared {
+    Shared() : users(0) {}
+    void Clear() {}
+    std::atomic<int> users;
+};
+
+TEST(ObjectPoolTest, NeverHandsOutAnObjectTwiceUnderContention) {
+    ObjectPool<Shared> pool(16);
+    std::atomic<bool> shared_use(false);
+    vector<thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.push_back(thread([&pool, &shared_use]() {
+            for (int i = 0; i < 20000; i++) {
+                unique_ptr<Shared> first = pool.Acquire();
+                unique_ptr<Shared> second = pool.Acquire();
+                if (first->users.fetch_add(1) != 0 || second->users.fetch_add(1) != 0) {
+                    shared_use = true;
+                }
+                first->users.fetch_sub(1);
+                second->users.fetch_sub(1);
+                pool.Release(move(first));
+                pool.Release(move(second));
+            }
+        }));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+    ASSERT_FALSE(shared_use);
+    // The pool kept up rather than allocating for most acquires
+    ASSERT_GT(2u * 8 * 20000 / 10, pool.allocations());
+}
+
+} // namespace kinetic
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+
+#include "gtest/gtest.h"
+
+#include "response_decoder.h"
+
+namespace kinetic {
+
+using std::string;
+using com::seagate::kinetic::client::proto::Command_Algorithm_SHA1;
+using com::seagate::kinetic::client::proto::Command_MessageType_GET_RESPONSE;
+using com::seagate::kinetic::client::proto::Command_MessageType_GETLOG_RESPONSE;
+using com::seagate::kinetic::client::proto::Command_MessageType_NOOP_RESPONSE;
+using com::seagate::kinetic::client::proto::Command_Priority_HIGHER;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_NOT_FOUND;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_SUCCESS;
+
+static Command GetResponse() {
+    Command command;
+    command.mutable_header()->set_clusterversion(3);
+    command.mutable_header()->set_connectionid(9);
+    command.mutable_header()->set_acksequence(7);
+    command.mutable_header()->set_messagetype(Command_MessageType_GET_RESPONSE);
+    command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+    command.mutable_status()->set_statusmessage("ok");
+    command.mutable_body()->mutable_keyvalue()->set_key("key");
+    command.mutable_body()->mutable_keyvalue()->set_dbversion("version");
+    command.mutable_body()->mutable_keyvalue()->set_tag("tag");
+    command.mutable_body()->mutable_keyvalue()->set_algorithm(Command_Algorithm_SHA1);
+    return command;
+}
+
+TEST(ResponseDecoderTest, DecodesHotResponsesLikeTheFullParser) {
+    string bytes = GetResponse().SerializeAsString();
+    Command decoded;
+    // Whatever was there before is cleared
+    decoded.mutable_body()->mutable_range()->set_startkey("stale");
+    ASSERT_TRUE(DecodeHotResponse(bytes, &decoded));
+    ASSERT_EQ(bytes, decoded.SerializeAsString());
+
+    Command noop;
+    noop.mutable_header()->set_acksequence(8);
+    noop.mutable_header()->set_messagetype(Command_MessageType_NOOP_RESPONSE);
+    noop.mutable_status()->set_code(Command_Status_StatusCode_NOT_FOUND);
+    noop.mutable_status()->set_detailedmessage("detail");
+    bytes = noop.SerializeAsString();
+    ASSERT_TRUE(DecodeHotResponse(bytes, &decoded));
+    ASSERT_EQ(bytes, decoded.SerializeAsString());
+}
+
+TEST(ResponseDecoderTest, LeavesOtherResponsesToTheFullParser) {
+    Command command;
+    command.mutable_header()->set_acksequence(7);
+    command.mutable_header()->set_messagetype(Command_MessageType_GETLOG_RESPONSE);
+    Command decoded;
+    ASSERT_FALSE(DecodeHotResponse(command.SerializeAsString(), &decoded));
+
+    command = GetResponse();
+    command.mutable_body()->mutable_range()->set_startkey("start");
+    ASSERT_FALSE(DecodeHotResponse(command.SerializeAsString(), &decoded));
+
+    command = GetResponse();
+    command.mutable_header()->set_priority(Command_Priority_HIGHER);
+    ASSERT_FALSE(DecodeHotResponse(command.SerializeAsString(), &decoded));
+
+    // No message type at all
+    command.Clear();
+    command.mutable_header()->set_acksequence(7);
+    ASSERT_FALSE(DecodeHotResponse(command.SerializeAsString(), &decoded));
+}
+
+TEST(ResponseDecoderTest, RejectsTruncatedResponses) {
+    string bytes = GetResponse().SerializeAsString();
+    Command decoded;
+    for (size_t length = 1; length < bytes.size(); length++) {
+        string truncated = bytes.substr(0, length);
+        if (DecodeHotResponse(truncated, &decoded)) {
+            // Cutting between fields still leaves a valid message, which must
+            // then agree with the full parser
+            Command parsed;
+            ASSERT_TRUE(parsed.ParseFromString(truncated));
+            ASSERT_EQ(parsed.SerializeAsString(), decoded.SerializeAsString());
+        }
+    }
+    ASSERT_FALSE(DecodeHotResponse(bytes.substr(0, bytes.size() - 1), &decoded));
+}
+
+} // namespace kinetic
@@ -0,0 +1,213 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#ifndef KINETIC_CPP_CLIENT_STAND_IN_DRIVE_H_
+#define KINETIC_CPP_CLIENT_STAND_IN_DRIVE_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+
+#include "kinetic/kinetic.h"
+
+namespace kinetic {
+
+using com::seagate::kinetic::client::proto::Command_MessageType_GET;
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_SUCCESS;
+using com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH;
+using com::seagate::kinetic::client::proto::Message_AuthType_UNSOLICITEDSTATUS;
+
+using std::string;
+using std::thread;
+using std::vector;
+
+// Stands in for a drive on a loopback TCP port, or on a Unix domain socket at
+// unix_path if one is given. Each connection, announced
+// with Expect, is served on its own thread: GETs are answered with a value of value_size
+// bytes, and anything else with plain success. With answer unset the drive
+// hangs up on the first request instead.
+class StandInDrive {
+    public:
+    StandInDrive(size_t value_size, bool answer, const string &unix_path = "") : value_size_(value_size),
+        answer_(answer), unix_path_(unix_path), largest_value_(0), silent_(false), port_(0) {
+        if (!unix_path_.empty()) {
+            listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+            CHECK_NE(-1, listen_fd_);
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            CHECK_LT(unix_path_.size(), sizeof(addr.sun_path));
+            memcpy(addr.sun_path, unix_path_.c_str(), unix_path_.size() + 1);
+            unlink(unix_path_.c_str());
+            CHECK_EQ(0, bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+            CHECK_EQ(0, listen(listen_fd_, 16));
+            return;
+        }
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK_NE(-1, listen_fd_);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK_EQ(0, bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+        CHECK_EQ(0, listen(listen_fd_, 16));
+        socklen_t addr_len = sizeof(addr);
+        CHECK_EQ(0, getsockname(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), &addr_len));
+        port_ = ntohs(addr.sin_port);
+    }
+
+    ~StandInDrive() {
+        close(listen_fd_);
+        if (!unix_path_.empty()) {
+            unlink(unix_path_.c_str());
+        }
+        for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+            it->join();
+        }
+    }
+
+    // Serves the next connection made to the drive
+    void Expect() {
+        threads_.push_back(thread(&StandInDrive::Serve, this));
+    }
+
+    // Options for connecting to the drive
+    ConnectionOptions options() const {
+        ConnectionOptions options;
+        options.host = unix_path_.empty() ? "127.0.0.1" : "unix:" + unix_path_;
+        options.port = port_;
+        options.user_id = 3;
+        options.hmac_key = "key";
+        return options;
+    }
+
+    // From now on requests are read but never answered, as by a drive that
+    // has stopped responding without closing its connections
+    void Silence() {
+        silent_ = true;
+    }
+
+    // Largest request value received so far. Only meaningful once the
+    // request has been answered.
+    size_t largest_value() {
+        return largest_value_;
+    }
+
+    private:
+    void Serve() {
+        int fd = accept(listen_fd_, NULL, NULL);
+        CHECK_NE(-1, fd);
+
+        Message handshake;
+        Command command;
+        handshake.set_authtype(Message_AuthType_UNSOLICITEDSTATUS);
+        command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+        WritePacket(fd, &handshake, command, "");
+
+        while (true) {
+            char header[9];
+            if (!ReadFully(fd, header, sizeof(header))) {
+                break;
+            }
+            uint32_t message_length, value_length;
+            memcpy(&message_length, header + 1, 4);
+            memcpy(&value_length, header + 5, 4);
+            string request(ntohl(message_length) + ntohl(value_length), '\0');
+            CHECK(ReadFully(fd, &request[0], request.size()));
+            if (!answer_) {
+                break;
+            }
+            if (silent_) {
+                continue;
+            }
+            largest_value_ = std::max<size_t>(largest_value_, ntohl(value_length));
+
+            Message message;
+            CHECK(message.ParseFromArray(request.data(), ntohl(message_length)));
+            CHECK(command.ParseFromString(message.commandbytes()));
+            Message response;
+            Command response_command;
+            response_command.mutable_header()->set_acksequence(command.header().sequence());
+            response_command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+            bool get = command.header().messagetype() == Command_MessageType_GET;
+            WritePacket(fd, &response, response_command, get ? string(value_size_, 'v') : "");
+        }
+        close(fd);
+    }
+
+    void WritePacket(int fd, Message *message, const Command &command, const string &value) {
+        message->set_commandbytes(command.SerializeAsString());
+        if (!message->has_authtype()) {
+            message->set_authtype(Message_AuthType_HMACAUTH);
+            message->mutable_hmacauth()->set_identity(3);
+            message->mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(*message, "key"));
+        }
+        string serialized = message->SerializeAsString();
+        uint32_t message_length = htonl(serialized.size());
+        uint32_t value_length = htonl(value.size());
+        string packet = "F" + string(reinterpret_cast<char *>(&message_length), 4) +
+            string(reinterpret_cast<char *>(&value_length), 4) + serialized + value;
+        const char *data = packet.data();
+        size_t length = packet.size();
+        while (length > 0) {
+            ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            data += n;
+            length -= n;
+        }
+    }
+
+    bool ReadFully(int fd, char *buf, size_t length) {
+        while (length > 0) {
+            ssize_t n = read(fd, buf, length);
+            if (n <= 0) {
+                return false;
+            }
+            buf += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    const size_t value_size_;
+    const bool answer_;
+    const string unix_path_;
+    std::atomic<size_t> largest_value_;
+    std::atomic<bool> silent_;
+    int listen_fd_;
+    int port_;
+    vector<thread> threads_;
+    HmacProvider hmac_provider_;
+};
+
+} // namespace kinetic
+
+#endif  // KINETIC_CPP_CLIENT_STAND_IN_DRIVE_H_
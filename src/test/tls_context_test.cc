@@ -0,0 +1,297 @@
+/**
+ * Copyright 2013-2015 Seagate Technology LLC.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla
+ * Public License, v. 2.0. If a copy of the MPL was not
+ * distributed with this file, You can obtain one at
+ * https://mozilla.org/MP:/2.0/.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without 
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or 
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public 
+ * License for more details.
+ *
+ * See www.openkinetic.org for more project information
+ */
+
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <thread>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gmock/gmock.h"
+
+#include "kinetic/kinetic.h"
+#include "mock_callbacks.h"
+
+namespace kinetic {
+
+using com::seagate::kinetic::client::proto::Command_Status_StatusCode_SUCCESS;
+using com::seagate::kinetic::client::proto::Message_AuthType_HMACAUTH;
+using com::seagate::kinetic::client::proto::Message_AuthType_UNSOLICITEDSTATUS;
+
+using ::testing::StrictMock;
+
+using std::make_shared;
+using std::string;
+using std::thread;
+using std::vector;
+
+// Stands in for a drive that only speaks TLS, with a throwaway self-signed
+// certificate. Each connection gets the drive's handshake, and every request
+// after that is answered with plain success until the client hangs up.
+class TlsStandInDrive {
+    public:
+    TlsStandInDrive() {
+        EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+        CHECK(key_ctx != NULL);
+        CHECK_EQ(1, EVP_PKEY_keygen_init(key_ctx));
+        EVP_PKEY *key = NULL;
+        CHECK_EQ(1, EVP_PKEY_keygen(key_ctx, &key));
+        EVP_PKEY_CTX_free(key_ctx);
+
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_get_notBefore(cert), 0);
+        X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME *name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+            reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        CHECK_NE(0, X509_sign(cert, key, EVP_sha256()));
+
+        ctx_ = SSL_CTX_new(SSLv23_server_method());
+        CHECK(ctx_ != NULL);
+        CHECK_EQ(1, SSL_CTX_use_certificate(ctx_, cert));
+        CHECK_EQ(1, SSL_CTX_use_PrivateKey(ctx_, key));
+        X509_free(cert);
+        EVP_PKEY_free(key);
+
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        CHECK_NE(-1, listen_fd_);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        CHECK_EQ(0, bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+        CHECK_EQ(0, listen(listen_fd_, 16));
+        socklen_t addr_len = sizeof(addr);
+        CHECK_EQ(0, getsockname(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), &addr_len));
+        port_ = ntohs(addr.sin_port);
+    }
+
+    ~TlsStandInDrive() {
+        close(listen_fd_);
+        for (auto it = threads_.begin(); it != threads_.end(); ++it) {
+            it->join();
+        }
+        SSL_CTX_free(ctx_);
+    }
+
+    // Serves the next connection made to the drive, recording in *resumed
+    // whether its TLS session was resumed. If records isn't NULL, *records
+    // counts the encrypted records received after the handshake.
+    void Expect(bool *resumed, int *records = NULL) {
+        threads_.push_back(thread(&TlsStandInDrive::Serve, this, resumed, records));
+    }
+
+    ConnectionOptions options() const {
+        ConnectionOptions options;
+        options.host = "127.0.0.1";
+        options.port = port_;
+        options.use_ssl = true;
+        options.user_id = 3;
+        options.hmac_key = "key";
+        return options;
+    }
+
+    private:
+    void Serve(bool *resumed, int *records) {
+        int fd = accept(listen_fd_, NULL, NULL);
+        CHECK_NE(-1, fd);
+        SSL *ssl = SSL_new(ctx_);
+        SSL_set_fd(ssl, fd);
+        CHECK_EQ(1, SSL_accept(ssl));
+        *resumed = SSL_session_reused(ssl);
+        if (records != NULL) {
+            *records = 0;
+            SSL_set_msg_callback(ssl, CountRecord);
+            SSL_set_msg_callback_arg(ssl, records);
+        }
+
+        Message handshake;
+        Command command;
+        handshake.set_authtype(Message_AuthType_UNSOLICITEDSTATUS);
+        command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+        WritePacket(ssl, &handshake, command);
+
+        while (true) {
+            char header[9];
+            if (!ReadFully(ssl, header, sizeof(header))) {
+                break;
+            }
+            uint32_t message_length, value_length;
+            memcpy(&message_length, header + 1, 4);
+            memcpy(&value_length, header + 5, 4);
+            string request(ntohl(message_length) + ntohl(value_length), '\0');
+            CHECK(ReadFully(ssl, &request[0], request.size()));
+
+            Message message;
+            CHECK(message.ParseFromArray(request.data(), ntohl(message_length)));
+            CHECK(command.ParseFromString(message.commandbytes()));
+            Message response;
+            Command response_command;
+            response_command.mutable_header()->set_acksequence(command.header().sequence());
+            response_command.mutable_status()->set_code(Command_Status_StatusCode_SUCCESS);
+            WritePacket(ssl, &response, response_command);
+        }
+        SSL_free(ssl);
+        close(fd);
+    }
+
+    void WritePacket(SSL *ssl, Message *message, const Command &command) {
+        message->set_commandbytes(command.SerializeAsString());
+        if (!message->has_authtype()) {
+            message->set_authtype(Message_AuthType_HMACAUTH);
+            message->mutable_hmacauth()->set_identity(3);
+            message->mutable_hmacauth()->set_hmac(hmac_provider_.ComputeHmac(*message, "key"));
+        }
+        string serialized = message->SerializeAsString();
+        uint32_t message_length = htonl(serialized.size());
+        uint32_t value_length = 0;
+        string packet = "F" + string(reinterpret_cast<char *>(&message_length), 4) +
+            string(reinterpret_cast<char *>(&value_length), 4) + serialized;
+        CHECK_EQ(static_cast<int>(packet.size()), SSL_write(ssl, packet.data(), packet.size()));
+    }
+
+    static void CountRecord(int write_p, int version, int content_type, const void *buf, size_t len,
+            SSL *ssl, void *arg) {
+        // Every record's header is reported; TLS 1.3 disguises all encrypted
+        // records as application data
+        if (!write_p && content_type == SSL3_RT_HEADER && len > 0 &&
+                static_cast<const unsigned char *>(buf)[0] == SSL3_RT_APPLICATION_DATA) {
+            ++*static_cast<int *>(arg);
+        }
+    }
+
+    bool ReadFully(SSL *ssl, char *buf, size_t length) {
+        while (length > 0) {
+            int n = SSL_read(ssl, buf, length);
+            if (n <= 0) {
+                return false;
+            }
+            buf += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    SSL_CTX *ctx_;
+    int listen_fd_;
+    int port_;
+    vector<thread> threads_;
+    HmacProvider hmac_provider_;
+};
+
+TEST(TlsContextTest, ReconnectsResumeTheLastSession) {
+    bool resumed[3];
+    {
+        TlsStandInDrive drive;
+        KineticConnectionFactory factory = NewKineticConnectionFactory();
+
+        drive.Expect(&resumed[0]);
+        shared_ptr<NonblockingKineticConnection> connection;
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+        connection.reset();
+
+        drive.Expect(&resumed[1]);
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+        connection.reset();
+
+        // A separate factory has nothing to resume
+        drive.Expect(&resumed[2]);
+        KineticConnectionFactory other_factory = NewKineticConnectionFactory();
+        ASSERT_TRUE(other_factory.NewNonblockingConnection(drive.options(), connection).ok());
+        connection.reset();
+    }
+
+    ASSERT_FALSE(resumed[0]);
+    ASSERT_TRUE(resumed[1]);
+    ASSERT_FALSE(resumed[2]);
+}
+
+TEST(TlsContextTest, KernelTlsConnectionsRunRequests) {
+    TlsStandInDrive drive;
+    KineticConnectionFactory factory = NewKineticConnectionFactory();
+    bool resumed;
+    drive.Expect(&resumed);
+    // Whether or not the kernel here can take over, requests have to work
+    ConnectionOptions options = drive.options();
+    options.kernel_tls = true;
+    shared_ptr<NonblockingKineticConnection> connection;
+    ASSERT_TRUE(factory.NewNonblockingConnection(options, connection).ok());
+
+    auto callback = make_shared<StrictMock<MockPutCallback>>();
+    auto record = make_shared<KineticRecord>(string(256 * 1024, 'p'), "version", "tag",
+        com::seagate::kinetic::client::proto::Command_Algorithm_SHA1);
+    connection->Put("key", "", WriteMode::IGNORE_VERSION, record, callback);
+    bool done = false;
+    EXPECT_CALL(*callback, Success()).WillOnce(::testing::Assign(&done, true));
+    for (int i = 0; i < 1000 && !done; i++) {
+        fd_set read_fds, write_fds;
+        int nfds;
+        ASSERT_TRUE(connection->Run(&read_fds, &write_fds, &nfds));
+        struct timeval tv = {0, 10000};
+        select(nfds, &read_fds, &write_fds, NULL, &tv);
+    }
+    ASSERT_TRUE(done);
+}
+
+TEST(TlsContextTest, QueuedPacketsShareRecords) {
+    const int kRequests = 20;
+    int records;
+    {
+        TlsStandInDrive drive;
+        KineticConnectionFactory factory = NewKineticConnectionFactory();
+        bool resumed;
+        drive.Expect(&resumed, &records);
+        shared_ptr<NonblockingKineticConnection> connection;
+        ASSERT_TRUE(factory.NewNonblockingConnection(drive.options(), connection).ok());
+
+        auto callback = make_shared<StrictMock<MockPutCallback>>();
+        auto record = make_shared<KineticRecord>("value", "version", "tag",
+            com::seagate::kinetic::client::proto::Command_Algorithm_SHA1);
+        int done = 0;
+        EXPECT_CALL(*callback, Success()).Times(kRequests).WillRepeatedly(
+            ::testing::Invoke([&done]() { done++; }));
+        for (int i = 0; i < kRequests; i++) {
+            connection->Put("key" + std::to_string(i), "", WriteMode::IGNORE_VERSION, record, callback);
+        }
+        for (int i = 0; i < 1000 && done < kRequests; i++) {
+            fd_set read_fds, write_fds;
+            int nfds;
+            ASSERT_TRUE(connection->Run(&read_fds, &write_fds, &nfds));
+            struct timeval tv = {0, 10000};
+            select(nfds, &read_fds, &write_fds, NULL, &tv);
+        }
+        ASSERT_EQ(kRequests, done);
+    }
+
+    // Sent piece by piece, each packet would take at least two records. All
+    // of them fit in one, which is followed only by the close_notify.
+    ASSERT_LE(records, 2);
+}
+
+} // namespace kinetic